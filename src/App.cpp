@@ -2,7 +2,10 @@
 #include <sys/types.h>
 #include <cstdio>
 #include <vector>
+#include <algorithm>
 #include <math.h>
+#include <chrono>
+#include <functional>
 
 #include <glad/glad.h> 
 #include <glm/glm.hpp>
@@ -20,6 +23,13 @@
 #include "UtilMesh.h"
 #include "Camera.h"
 #include "UserInput.h"
+#include "IBLBake.h"
+#include "IBLCache.h"
+#include "IntegratedBRDFLUT.h"
+#include "JobGraph.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
 
 using glm::vec3;
 using glm::mat4;
@@ -30,10 +40,98 @@ using std::to_string;
 static const int SPHERES_PER_ROW = 7;
 static const int SPHERES_PER_COLUMN = 7;
 static const char *RELOAD_SHADER = "../src/shaders/PBR.frag";
+static const char *SHADER_DIR = "../src/shaders/";
+static const char *IBL_CACHE_DIR = "../cache/";
+// Cooked material textures and orm.ppm, written by the materials target of the build (see CMakeLists.txt)
+static const char *MATERIAL_COOK_DIR = MATERIAL_DIR;
+static const unsigned int SPHERE_SUBDIVISIONS = 64;
+
+// Prefilter the specular environment map with the multithreaded CPU baker (IBLBake) instead of EnvToPrefilteredEnv.frag.
+// VALIDATE_CPU_PREFILTER additionally runs both bakes and checks the CPU result against the shader output.
+#define CPU_PREFILTER 0
+#define VALIDATE_CPU_PREFILTER 0
+// Bakes the first environment with both the compute and the fragment shaders and prints their timings. Run it with
+// LIBGL_ALWAYS_SOFTWARE=1 (Mesa llvmpipe) to compare the two paths on the CPU rasterizer.
+#define BENCHMARK_COMPUTE_IBL 0
+static const unsigned int BENCHMARK_COMPUTE_IBL_RUNS = 3;
+// Bakes the first environment at every IBL quality tier and reports time and error against the production tier
+#define REPORT_IBL_QUALITY_TIERS 0
+// Bakes the irradiance map of the first environment and reports the error of its SH irradiance against it
+#define REPORT_SH_IRRADIANCE_ERROR 0
+// Scene objects with 16 byte vertices (snorm16 positions, octahedral normals and half float texture coordinates, see
+// UtilMesh::Quantize) instead of 32 bytes of floats. The programs that draw them decode the normals with OCTAHEDRAL_NORMALS.
+#define QUANTIZED_VERTICES 1
+// Levels of detail for the spheres (see MeshSimplifier): every object uses the coarsest level whose error covers at
+// most LOD_PIXEL_ERROR pixels on screen. A level coarser than the current one has to stay below LOD_HYSTERESIS times
+// that, so that objects near a switching distance do not alternate between two levels from frame to frame.
+#define LEVELS_OF_DETAIL 1
+static const float LOD_PIXEL_ERROR = 1.0f;
+static const float LOD_HYSTERESIS = 0.75f;
+// Test the meshlets of every object against the camera's frustum and their normal cones on the CPU and draw only the
+// remaining ones, from an index buffer they are compacted into (see ClusterCulling)
+#define CLUSTER_CULLING 1
+// With MATERIAL_TEXTURES, read occlusion, roughness and metalness from one packed texture (see packorm) instead of
+// separate metalness and roughness maps
+#define ORM_TEXTURE 1
+static const double IBL_TIER_TOLERANCE = 0.01;		// RMSE of tone mapped values
+static const double CPU_PREFILTER_TOLERANCE = 0.01;		// RMSE of tone mapped values
+static const unsigned int MIN_SAMPLES_PER_BATCH = 8;		// Smallest prefilter sample batch of a progressive bake
+
+// cubeMapFaces order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
+static const unsigned int NUMBER_OF_CUBE_FACES = 6;
+static const mat4 CUBE_MAP_VIEW_MATRICES[NUMBER_OF_CUBE_FACES] =
+{
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
+	glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f)),
+};
+
+// A mesh viewed in the mapped asset pack or generated by a startup job
+struct PreparedMesh
+{
+	Mesh mesh;
+	bool generated = false;			// Freed once every model that uses it has been uploaded
+};
 
 void BindRenderContext(AppContext *appContext, RenderContext *renderContext, Shader shader);
+GLuint CreateCubemapProgram(AppContext *context, string fragmentShaderFile, const vector<string> &defines = vector<string>());
+void SetCubemapFaceMatrices(GLuint program);
+void LoadEnvironment(AppContext *context, unsigned int environmentIndex);
+bool LoadPackedEnvironment(AppContext *context, unsigned int environmentIndex);
+unsigned int AddEnvironmentJobs(JobGraph *jobs, AppContext *context, unsigned int environmentIndex, unsigned int cacheJob);
+void SetEnvironmentResident(AppContext *context, Environment *environment);
+unsigned int AddMeshJob(JobGraph *jobs, const AssetPack &pack, const char *name, PreparedMesh *prepared, std::function<Mesh()> makeMesh,
+						bool meshlets = false);
+void InitPreparedModel(JobGraph *jobs, unsigned int job, PreparedMesh *prepared, Model *model);
+void FreePreparedMesh(PreparedMesh *prepared);
+bool HasPackedEnvironment(AppContext *context, unsigned int environmentIndex);
+bool LoadPackedTexture(const AssetPack &pack, const char *name, Texture *texture, TextureResidency *residency = nullptr);
+void ReleaseEnvironment(AppContext *context, unsigned int environmentIndex);
+void ActivateEnvironment(AppContext *context, unsigned int environmentIndex);
+void RenderCubemapFaces(AppContext *context, Shader shader, RenderContext *cubeMapRC, GLuint cubemap, unsigned int mip, bool clear);
+void SetPrefilterMipUniforms(AppContext *context, GLuint program, unsigned int mipLevel);
+bool BakeCubemapUnit(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+					 IBLBakeUnit unit);
+void QueueProgressiveBake(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+						  unsigned int mipCount, uint64_t cacheKey, string product, string name);
+Shader ComputeShader(Shader shader);
+void DispatchCubemapBake(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+						 IBLBakeUnit unit, unsigned int batchCount);
+void BenchmarkComputeIBL(AppContext *context);
+void InitIBLPrograms(AppContext *context);
+void SetIBLQualityTier(AppContext *context, IBLQuality::Tier tier);
+void ReportIBLQualityTiers(AppContext *context);
 void CubemapFromTexture(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize);
 void PrefilteredEnvMapFromTexture(AppContext *context, Shader shader, Texture *sampledTexture, Texture *prefilteredEnvMapTexture, unsigned int cubeMapSize);
+void ValidateCPUPrefilter(AppContext *context, Texture *environmentTexture);
+void InitPBRProgram(AppContext *context);
+void LoadIrradianceMap(AppContext *context, unsigned int environmentIndex);
+void ReportIrradianceSHError(AppContext *context);
+SHIrradiance ProjectIrradianceSH(Texture *environmentTexture);
+void InitIrradianceSH(UniformBuffer *buffer, const SHIrradiance &irradiance);
 void UpdateScene(AppContext *context, double dt);
 void RenderScene(AppContext *context);
 void BindRenderContext(AppContext *appContext, RenderContext *renderContext, Shader shader);
@@ -41,15 +139,13 @@ void RenderUI(AppContext *context);
 void RenderDebugObjects(AppContext *context);
 void RenderSkyBox(AppContext *appContext);
 
-void InitSceneObjects(SceneContext *scene)
+void InitSceneObjects(SceneContext *scene, const std::string &sphereKey, const Mesh &sphereMesh)
 {
-	scene->activeEnvironment = 0;
 	//------------------------
 	// Init Scene Objects
 	//------------------------
 	
-	// Spheres
-	int numSubdivisions = 64;
+	// Spheres, sphereMesh has to have this radius (see SPHERE_SUBDIVISIONS)
 	float radius = 1.0f;
 	float distanceBetweenSpheres = 2.0f * radius + 0.2f;
 
@@ -60,7 +156,7 @@ void InitSceneObjects(SceneContext *scene)
 			int index = row * SPHERES_PER_COLUMN + col;
 
 			std::string key = "sphere" + to_string(index);
-			Mesh mesh = UtilMesh::MakeUVSphere(numSubdivisions, radius);
+			Model *model = MeshRegistryControl::Add(&scene->meshes, sphereKey, sphereMesh);
 			unsigned int materialIndex = index;
 
 			vec3 pos;
@@ -69,8 +165,9 @@ void InitSceneObjects(SceneContext *scene)
 			pos.z = 0.0f;
 			mat4 modelMatrix = glm::translate(glm::mat4(), pos);
 
-			scene->objects[key] = SceneObject(mesh, &scene->textures["albedo"], &scene->textures["metalness"], &scene->textures["roughness"],
-											  &scene->textures["normal"], materialIndex, modelMatrix);
+			scene->objects[key] = SceneObject(model, &scene->textures["albedo"], &scene->textures["metalness"], &scene->textures["roughness"],
+											  &scene->textures["normal"], &scene->textures["orm"], materialIndex, modelMatrix);
+			scene->objects[key].boundingRadius = radius;
 
 			// Create PBR material
 			PBRMaterial PBRmaterial;
@@ -123,35 +220,141 @@ void InitSceneObjects(SceneContext *scene)
 	}
 }
 
-void App::Init(AppContext *context, unsigned int screenWidth, unsigned int screenHeight)
+void App::Init(AppContext *context, unsigned int screenWidth, unsigned int screenHeight, const char *assetPackFile)
 {	
+	// Printed by App::Update once the GPU times are available, see also startupbench
+	StartupProfile *profile = &context->startupProfile;
+	StartupProfileControl::Start(profile);
+	unsigned int initPhase = StartupProfileControl::BeginPhase(profile, "App::Init");
+
 	//------------------------
 	// Init OpenGL State
 	//------------------------
 	Graphics::InitOpenGLState();
 
+	//------------------------
+	// Start Startup Jobs
+	//------------------------
+	// The CPU side of the startup runs on a job graph: generating the meshes that are not in the asset pack, reading
+	// the shader files and hashing (and on an IBL cache miss decoding) the first HDR environment. This thread only
+	// waits for the results it needs next and uploads them. The material textures are decoded by the TextureLoader.
+	// The build writes the pack (see the assetpack target in CMakeLists.txt), see InitSceneObjects, App::Init and
+	// LoadPackedEnvironment for the asset names. It is optional, everything missing from it is generated or loaded from
+	// the source files.
+	context->assetPackFile = assetPackFile;
+	if (IOUtil::FileExists(assetPackFile))
+		AssetPackControl::Open(&context->assetPack, assetPackFile);
+	SceneContext *scene = &context->scene;
+	string shaderDir = SHADER_DIR;
+	context->iblSettings = IBLBake::SettingsForTier(context->iblQualityTier);
+	{
+		const char *hdrTexturePaths[] =
+		{
+			"../resources/hdr/newport_loft.hdr",
+			"../resources/hdr/Ditch-River_2k.hdr"
+		};
+
+		scene->environments.clear();
+		for (unsigned int i = 0; i < ARRAYSIZE(hdrTexturePaths); ++i)
+		{
+			Environment environment;
+			environment.hdrPath = hdrTexturePaths[i];
+			scene->environments.push_back(environment);
+		}
+		scene->activeEnvironment = 0;
+	}
+
+	JobGraph startupJobs;
+	PreparedMesh sphereMesh, screenQuadMesh, skyBoxMesh;
+#if QUANTIZED_VERTICES
+	string sphereName = "uvSphere" + to_string(SPHERE_SUBDIVISIONS) + "Quantized";
+	VertexFormat::Type sphereFormat = VertexFormat::Quantized;
+#else
+	string sphereName = "uvSphere" + to_string(SPHERE_SUBDIVISIONS);
+	VertexFormat::Type sphereFormat = VertexFormat::Float;
+#endif
+	unsigned int sphereJob = AddMeshJob(&startupJobs, context->assetPack, sphereName.c_str(), &sphereMesh, [=]()
+	{
+		Mesh sphere = UtilMesh::MakeUVSphere(SPHERE_SUBDIVISIONS, 1.0f, sphereFormat);
+#if LEVELS_OF_DETAIL
+		Mesh levels = MeshSimplifier::BuildLevels(sphere);
+		UtilMesh::Free(sphere);
+		return levels;
+#else
+		return sphere;
+#endif
+	}, CLUSTER_CULLING);
+	unsigned int screenQuadJob = AddMeshJob(&startupJobs, context->assetPack, "screenQuad", &screenQuadMesh, UtilMesh::MakeScreenQuad);
+	unsigned int skyBoxJob = AddMeshJob(&startupJobs, context->assetPack, "skyBox", &skyBoxMesh, UtilMesh::MakeSkyBox);
+
+	// Every shader compiled below, later compiles (e.g. hot reloads) read the files again
+	const char *shaderFiles[] =
+	{
+		"SkyBox.vert", "SkyBox.frag", "CubeMap.vert", "CubeMapLayered.vert", "CubeMapLayered.geom",
+		"EquirectToCubeMap.frag", "EnvToIrradiance.frag", "EnvToPrefilteredEnv.frag",
+		"EquirectToCubeMap.comp", "EnvToIrradiance.comp", "EnvToPrefilteredEnv.comp",
+		"Debug.vert", "Debug.frag", "Shadow.vert", "Shadow.frag", "Phong.vert", "Phong.frag", "PBR.frag",
+		"TextureDisplay.vert", "TextureDisplay.frag"
+	};
+	vector<string> shaderSources(ARRAYSIZE(shaderFiles));
+	unsigned int shaderJob = JobGraphControl::Add(&startupJobs, "shader sources", [&]()
+	{
+		for (unsigned int i = 0; i < ARRAYSIZE(shaderFiles); ++i)
+			Graphics::ReadShaderSource(shaderDir + shaderFiles[i], &shaderSources[i]);
+	});
+	if (context->computeIBLBake && !GLAD_GL_VERSION_4_3)
+	{
+		std::cerr << "Compute shaders are not supported, baking IBL cubemaps with fragment shaders\n";
+		context->computeIBLBake = false;
+	}
+#if CPU_PREFILTER
+	string iblBakePath = context->computeIBLBake ? "compute, CPU prefilter" : "fragment, CPU prefilter";
+#else
+	string iblBakePath = context->computeIBLBake ? "compute" : "fragment";
+#endif
+	unsigned int cacheJob = JobGraphControl::Add(&startupJobs, "IBL cache", [&]()
+	{
+		IBLCacheControl::Init(&context->iblCache, IBL_CACHE_DIR, iblBakePath,
+							  { shaderDir + "CubeMap.vert", shaderDir + "CubeMapLayered.vert", shaderDir + "CubeMapLayered.geom",
+								shaderDir + "EquirectToCubeMap.frag", shaderDir + "EnvToIrradiance.frag", shaderDir + "EnvToPrefilteredEnv.frag",
+								shaderDir + "EquirectToCubeMap.comp", shaderDir + "EnvToIrradiance.comp", shaderDir + "EnvToPrefilteredEnv.comp" });
+	});
+	unsigned int environmentJob = AddEnvironmentJobs(&startupJobs, context, scene->activeEnvironment, cacheJob);
+	JobGraphControl::Start(&startupJobs);
+
 	//------------------------
 	// Init Models
 	//------------------------
-	SceneContext *scene = &context->scene;								
-	InitSceneObjects(scene);
-	Graphics::InitModel(&context->screenQuadModel, UtilMesh::MakeScreenQuad());
-	Graphics::InitModel(&context->skyBoxModel, UtilMesh::MakeSkyBox());
+	unsigned int phase = StartupProfileControl::BeginPhase(profile, "InitSceneObjects");
+	JobGraphControl::Wait(&startupJobs, sphereJob);
+	InitSceneObjects(scene, sphereName, sphereMesh.mesh);
+	FreePreparedMesh(&sphereMesh);
+	InitPreparedModel(&startupJobs, screenQuadJob, &screenQuadMesh, &context->screenQuadModel);
+	InitPreparedModel(&startupJobs, skyBoxJob, &skyBoxMesh, &context->skyBoxModel);
+	ClusterCullingControl::Init(&context->clusterCuller);
+	StartupProfileControl::EndPhase(profile, phase);
 
 	//------------------------
 	// Init Shaders
 	//------------------------
-	string shaderDir = "../src/shaders/";
+	phase = StartupProfileControl::BeginPhase(profile, "program creation");
+	JobGraphControl::Wait(&startupJobs, shaderJob);
+	for (unsigned int i = 0; i < ARRAYSIZE(shaderFiles); ++i)
+	{
+		if (!shaderSources[i].empty())
+			Graphics::PreloadShaderSource(shaderDir + shaderFiles[i], shaderSources[i]);
+	}
 	context->shaders[Shader::SkyBox] = Graphics::CreateProgram(shaderDir + "SkyBox.vert", shaderDir + "SkyBox.frag");
-	context->shaders[Shader::EquirectToCubemap] = Graphics::CreateProgram(shaderDir + "CubeMap.vert", shaderDir + "EquirectToCubeMap.frag");
-	context->shaders[Shader::EnvToIrradiance] = Graphics::CreateProgram(shaderDir + "CubeMap.vert", shaderDir + "EnvToIrradiance.frag");
-	context->shaders[Shader::EnvToPrefilteredEnv] = Graphics::CreateProgram(shaderDir + "CubeMap.vert", shaderDir + "EnvToPrefilteredEnv.frag");
-	context->shaders[Shader::EnvToIntegratedBRDF] = Graphics::CreateProgram(shaderDir + "TextureDisplay.vert", shaderDir + "EnvToIntegratedBRDF.frag");
+	InitIBLPrograms(context);
 	context->shaders[Shader::Debug] = Graphics::CreateProgram(shaderDir + "Debug.vert", shaderDir + "Debug.frag");;
 	context->shaders[Shader::ShadowMap] = Graphics::CreateProgram(shaderDir + "Shadow.vert", shaderDir + "Shadow.frag");;
 
 	{
-		GLuint phongProgram = Graphics::CreateProgram(shaderDir + "Phong.vert", shaderDir + "Phong.frag");
+		vector<string> defines;
+#if QUANTIZED_VERTICES
+		defines.push_back("OCTAHEDRAL_NORMALS");
+#endif
+		GLuint phongProgram = Graphics::CreateProgram(shaderDir + "Phong.vert", shaderDir + "Phong.frag", defines);
 		context->shaders[Shader::Phong] = phongProgram;
 
 		Graphics::SetUniform3f(phongProgram, scene->directionalLight.direction, "uDirectionalLight.direction");
@@ -169,37 +372,20 @@ void App::Init(AppContext *context, unsigned int screenWidth, unsigned int scree
 		}
 	}
 
-	{
-		GLuint pbrProgram = Graphics::CreateProgram(shaderDir + "Phong.vert", shaderDir + "PBR.frag");
-		context->shaders[Shader::PBR] = pbrProgram;
-
-		for (unsigned int i = 0; i < scene->pointLights.size(); ++i)
-		{
-			Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].position, "uPointLights[" + to_string(i) + "].position");
-			Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].ambient, "uPointLights[" + to_string(i) + "].ambient");
-			Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].diffuse, "uPointLights[" + to_string(i) + "].diffuse");
-			Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].specular, "uPointLights[" + to_string(i) + "].specular");
-		}
-#ifdef MATERIAL_TEXTURES
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::Albedo2D, "uTexAlbedo");
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::Metalness2D, "uTexMetalness");
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::Roughness2D, "uTexRoughness");
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::Normal2D, "uTexNormal");
-#endif
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::IntegratedBRDF2D, "uTexIntegratedBRDF");
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::IrradianceMapCube, "uCubeIrradiance");
-		Graphics::SetUniform1i(pbrProgram, PBRSamplers::PrefilteredEnvMapCube, "uCubePrefilteredEnvMap");
-	}
+	context->shaders[Shader::PBR] = 0;
+	InitPBRProgram(context);
 
 	{
 		GLuint textureDisplayProgram = Graphics::CreateProgram(shaderDir + "TextureDisplay.vert", shaderDir + "TextureDisplay.frag");
 		context->shaders[Shader::TextureDisplay] = textureDisplayProgram;
 		Graphics::SetUniform1i(textureDisplayProgram, 0, "uTexSampler0");
 	}
+	StartupProfileControl::EndPhase(profile, phase);
 
 	//------------------------
 	// Init Render Contexts
 	//------------------------
+	phase = StartupProfileControl::BeginPhase(profile, "render contexts");
 
 	// Scene 
 	{
@@ -248,71 +434,127 @@ void App::Init(AppContext *context, unsigned int screenWidth, unsigned int scree
 										  viewportWidth, viewportHeight);
 	}
 
+	StartupProfileControl::EndPhase(profile, phase);
+
 	//------------------------
 	// Init Textures 
 	//------------------------
+	phase = StartupProfileControl::BeginPhase(profile, "texture loads");
+	TextureLoaderControl::Init(&context->textureLoader);
 	
 	// Object textures
 #ifdef MATERIAL_TEXTURES
 	{
-		Texture tex;
-		Graphics::InitTexture2D(&tex, "../resources/rusted_iron/albedo.png");
-		scene->textures["albedo"] = tex;
-		Graphics::InitTexture2D(&tex, "../resources/rusted_iron/metallic.png");
-		scene->textures["metalness"] = tex;
-		Graphics::InitTexture2D(&tex, "../resources/rusted_iron/roughness.png");
-		scene->textures["roughness"] = tex;
-		Graphics::InitTexture2D(&tex, "../resources/rusted_iron/normal.png");
-		scene->textures["normal"] = tex;
+		// Decoded on the loader's worker threads, the scene renders with 1x1 placeholders until the uploads complete.
+		// The mip chains are cooked into MATERIAL_COOK_DIR on the first start if the build has not cooked them there.
+		// There is no albedo map, the spheres keep the albedo of their materials. Block compressed versions are used
+		// where cooktex has cooked them (cooktex -bc4 -out <dir> metallic.png etc.). Textures found in the asset pack are uploaded from it right away instead
+		// (packassets -texture orm orm.ppm.kaiser_linear_repeat.bc7.tex ...).
+		// Either way their finer mips are streamed from the cooked file or the pack by the TextureResidency.
+		TextureLoader *loader = &context->textureLoader;
+		TextureResidency *residency = &context->textureResidency;
+		auto load = [&](const char *name, const char *file, const TextureLoadOptions &loadOptions)
+		{
+			if (!LoadPackedTexture(context->assetPack, name, &scene->textures[name], residency))
+			{
+				TextureLoaderControl::Load(loader, &scene->textures[name], name, file, loadOptions,
+										   [=](Texture *texture, const std::string &cookedFile)
+										   {
+											   if (!cookedFile.empty())
+												   TextureResidencyControl::AddStreamed(residency, texture, cookedFile.c_str());
+										   });
+			}
+		};
+		TextureLoadOptions options;
+		options.cookDirectory = MATERIAL_COOK_DIR;
+#if ORM_TEXTURE
+		// packorm -ao ao.png -roughness roughness.png -metalness metallic.png orm.ppm (the AO map is optional), then
+		// cooktex -bc7 orm.ppm. BC7 because the three channels are unrelated, BC1 would blur them into one color line.
+		options.compression = BlockFormat::BC7;
+		load("orm", (string(MATERIAL_COOK_DIR) + "orm.ppm").c_str(), options);
+#else
+		options.compression = BlockFormat::BC4;
+		load("metalness", "../resources/rusted_iron/metallic.png", options);
+		load("roughness", "../resources/rusted_iron/roughness.png", options);
+#endif
 	}
 #endif
+#ifdef _DEBUG
+	// Shown in the texture display viewport (see RenderDebugObjects), its mips are streamed for the viewport's size
+	TextureLoadOptions displayOptions;
+	displayOptions.cookDirectory = MATERIAL_COOK_DIR;
+	TextureResidency *displayResidency = &context->textureResidency;
+	TextureLoaderControl::Load(&context->textureLoader, &scene->textures["display"], "display", "../resources/rusted_iron/roughness.png",
+							   displayOptions, [=](Texture *texture, const std::string &cookedFile)
+							   {
+								   if (!cookedFile.empty())
+									   TextureResidencyControl::AddStreamed(displayResidency, texture, cookedFile.c_str());
+							   });
+#endif
+	StartupProfileControl::EndPhase(profile, phase);
 
-	// HDR Environment Textures
+	// HDR Environment Textures, decoded and baked when they are activated for the first time. The first one has been
+	// hashed and decoded by the startup jobs.
 	{
-		const char *hdrTexturePaths[] =
-		{
-			"../resources/hdr/newport_loft.hdr",
-			"../resources/hdr/Ditch-River_2k.hdr"
-		};
-
-		for (unsigned int i = 0; i < ARRAYSIZE(hdrTexturePaths); ++i)
-		{
-			Texture hdrTexture;
-			Texture *environmentTexture = &scene->textures["skybox" + to_string(i)];
-			Graphics::InitHDRTexture(&hdrTexture, hdrTexturePaths[i]);
-			// Convert 2D HDR equirectangular environment map to environment cubemap
-			CubemapFromTexture(context, Shader::EquirectToCubemap, &hdrTexture, environmentTexture, 512);
-			Graphics::Release(&hdrTexture);
-			// Convert environment cubemap to irradiance cubemap
-			CubemapFromTexture(context, Shader::EnvToIrradiance, environmentTexture, &scene->textures["irradianceMap" + to_string(i)], 32);
-			// Convert environment cubemap to prefiltered environment cubemap
-			PrefilteredEnvMapFromTexture(context, Shader::EnvToPrefilteredEnv, environmentTexture, &scene->textures["prefilteredEnvMap" + to_string(i)], 128);
-		}
+		// Progressive bakes render into their cubemaps through this framebuffer, the attachment changes with every unit
+		glGenFramebuffers(1, &context->iblBakeRC.framebuffer.fbo);
+
+		ProfileScope scope(profile, "environment");
+		JobGraphControl::Wait(&startupJobs, environmentJob);
+		ActivateEnvironment(context, scene->activeEnvironment);
+#if BENCHMARK_COMPUTE_IBL
+		BenchmarkComputeIBL(context);
+#endif
+#if REPORT_IBL_QUALITY_TIERS
+		ReportIBLQualityTiers(context);
+#endif
+#if REPORT_SH_IRRADIANCE_ERROR
+		ReportIrradianceSHError(context);
+#endif
 	}
 
-	// Integrated BRDF 2D LUT
+	// Integrated BRDF 2D LUT, generated at build time
 	{
-		RenderContext screenQuadRC = {};
-		unsigned int BRDFMapSize = 512;
-		Graphics::InitDrawFramebuffer(&screenQuadRC.framebuffer, BRDFMapSize, BRDFMapSize, GL_RG16F, GL_RG);
-		screenQuadRC.viewport = Viewport(0, 0, BRDFMapSize, BRDFMapSize);
-		Graphics::BindRenderContext(&screenQuadRC, context->shaders[Shader::EnvToIntegratedBRDF]);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		Graphics::RenderModel(&context->screenQuadModel, context->shaders[Shader::EnvToIntegratedBRDF]);
-
-		scene->textures["integratedBRDF"].id = screenQuadRC.framebuffer.colorAttachment.id;
-		scene->textures["integratedBRDF"].target = TextureTarget::Texture2D;
-		screenQuadRC.framebuffer.colorAttachment.id = 0;
-		Graphics::Release(&screenQuadRC);
+		ProfileScope scope(profile, "BRDF LUT");
+		TextureData lutData;
+		lutData.target = TextureTarget::Texture2D;
+		lutData.internalFormat = GL_RG16F;
+		lutData.format = GL_RG;
+		lutData.type = GL_HALF_FLOAT;
+		lutData.width = lutData.height = INTEGRATED_BRDF_LUT_SIZE;
+		lutData.mipCount = 1;
+		TextureLevelView lutLevel;
+		lutLevel.data = (const uint8_t *)INTEGRATED_BRDF_LUT;
+		lutLevel.size = INTEGRATED_BRDF_LUT_SIZE * INTEGRATED_BRDF_LUT_SIZE * 2 * sizeof(uint16_t);
+		Graphics::InitTexture(&scene->textures["integratedBRDF"], lutData, { lutLevel });
 	}
+
+	JobGraphControl::Release(&startupJobs);
+	Graphics::ClearPreloadedShaderSources();
+	StartupProfileControl::EndPhase(profile, initPhase);
+	StartupProfileControl::Stop(profile);
+	std::cout << "IBL cache: " << context->iblCache.hits << " hits, " << context->iblCache.misses << " misses\n";
 }
 
 void App::Update(AppContext *context, double dt)
 {
 	context->globalTime += dt;
+	StartupProfile *startupProfile = &context->startupProfile;
+	if (!startupProfile->resolved && StartupProfileControl::Resolve(startupProfile, false))
+		StartupProfileControl::Print(*startupProfile);
+	IBLBakeSchedulerControl::Update(&context->iblBakeScheduler);
+	TextureLoaderControl::Update(&context->textureLoader);
 	UpdateScene(context, dt);
 
+	// Uses the requests of the previous frame's RenderScene
+	size_t textureBytes = 0;
+	for (auto &it : context->scene.textures)
+		textureBytes += it.second.memoryBytes;
+	TextureResidencyControl::Update(&context->textureResidency, textureBytes);
+
 	// Clear render contexts
+	context->renderStats = RenderStats();
+	ClusterCullingControl::ResetStats(&context->clusterCuller);
 	Graphics::ClearRenderContext(&context->sceneRC, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	Graphics::ClearRenderContext(&context->shadowRC, GL_DEPTH_BUFFER_BIT);
 
@@ -344,91 +586,787 @@ void App::Update(AppContext *context, double dt)
 	RenderUI(context);
 }
 
+// (Re)creates the PBR program variant matching the current context options
+void InitPBRProgram(AppContext *context)
+{
+	SceneContext *scene = &context->scene;
+	string shaderDir = SHADER_DIR;
+
+	vector<string> defines;
+	if (context->shIrradiance)
+		defines.push_back("SH_IRRADIANCE");
+	if (context->analyticEnvironmentBRDF)
+		defines.push_back("ANALYTIC_ENVIRONMENT_BRDF");
+	defines.push_back("PREFILTERED_MIP_LEVELS " + to_string(context->iblSettings.prefilteredMipLevels));
+#if QUANTIZED_VERTICES
+	defines.push_back("OCTAHEDRAL_NORMALS");
+#endif
+#ifdef MATERIAL_TEXTURES
+	defines.push_back("MATERIAL_TEXTURES");
+#if ORM_TEXTURE
+	defines.push_back("ORM_TEXTURE");
+#endif
+#endif
+
+	if (context->shaders[Shader::PBR] != 0)
+		Graphics::Release(context->shaders[Shader::PBR]);
+	GLuint pbrProgram = Graphics::CreateProgram(shaderDir + "Phong.vert", shaderDir + "PBR.frag", defines);
+	context->shaders[Shader::PBR] = pbrProgram;
+
+	for (unsigned int i = 0; i < scene->pointLights.size(); ++i)
+	{
+		Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].position, "uPointLights[" + to_string(i) + "].position");
+		Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].ambient, "uPointLights[" + to_string(i) + "].ambient");
+		Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].diffuse, "uPointLights[" + to_string(i) + "].diffuse");
+		Graphics::SetUniform3f(pbrProgram, scene->pointLights[i].specular, "uPointLights[" + to_string(i) + "].specular");
+	}
+#ifdef MATERIAL_TEXTURES
+#if ORM_TEXTURE
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::ORM2D, "uTexORM");
+#else
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::Metalness2D, "uTexMetalness");
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::Roughness2D, "uTexRoughness");
+#endif
+#endif
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::IntegratedBRDF2D, "uTexIntegratedBRDF");
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::IrradianceMapCube, "uCubeIrradiance");
+	Graphics::SetUniform1i(pbrProgram, PBRSamplers::PrefilteredEnvMapCube, "uCubePrefilteredEnvMap");
+	Graphics::SetUniformBlockBinding(pbrProgram, PBRUniformBlocks::SHIrradiance, "SHIrradiance");
+}
+
+// (Re)creates the programs that bake the IBL cubemaps, their defines depend on the IBL settings
+void InitIBLPrograms(AppContext *context)
+{
+	Shader iblShaders[] = { Shader::EquirectToCubemap, Shader::EnvToIrradiance, Shader::EnvToPrefilteredEnv,
+							Shader::EquirectToCubemapCompute, Shader::EnvToIrradianceCompute, Shader::EnvToPrefilteredEnvCompute };
+	for (unsigned int i = 0; i < ARRAYSIZE(iblShaders); ++i)
+	{
+		if (context->shaders[iblShaders[i]] != 0)
+			Graphics::Release(context->shaders[iblShaders[i]]);
+		context->shaders[iblShaders[i]] = 0;
+	}
+
+	string shaderDir = SHADER_DIR;
+	vector<string> irradianceDefines;
+	irradianceDefines.push_back("RIEMANN_SUM_STEP " + to_string(context->iblSettings.irradianceSampleStep));
+	vector<string> prefilterDefines;
+	if (context->iblSettings.filteredImportanceSampling)
+		prefilterDefines.push_back("FILTERED_IMPORTANCE_SAMPLING");
+
+	context->shaders[Shader::EquirectToCubemap] = CreateCubemapProgram(context, "EquirectToCubeMap.frag");
+	context->shaders[Shader::EnvToIrradiance] = CreateCubemapProgram(context, "EnvToIrradiance.frag", irradianceDefines);
+	context->shaders[Shader::EnvToPrefilteredEnv] = CreateCubemapProgram(context, "EnvToPrefilteredEnv.frag", prefilterDefines);
+	if (GLAD_GL_VERSION_4_3)
+	{
+		context->shaders[Shader::EquirectToCubemapCompute] = Graphics::CreateComputeProgram(shaderDir + "EquirectToCubeMap.comp");
+		context->shaders[Shader::EnvToIrradianceCompute] = Graphics::CreateComputeProgram(shaderDir + "EnvToIrradiance.comp", irradianceDefines);
+		context->shaders[Shader::EnvToPrefilteredEnvCompute] = Graphics::CreateComputeProgram(shaderDir + "EnvToPrefilteredEnv.comp", prefilterDefines);
+	}
+}
+
+// Switches every environment to the settings of the tier. Resident environments are released and the active one is
+// loaded again, from the cache if this tier has been baked before.
+void SetIBLQualityTier(AppContext *context, IBLQuality::Tier tier)
+{
+	SceneContext *scene = &context->scene;
+	for (unsigned int i = 0; i < scene->environments.size(); ++i)
+	{
+		if (scene->environments[i].resident)
+			ReleaseEnvironment(context, i);
+	}
+
+	context->iblQualityTier = tier;
+	context->iblSettings = IBLBake::SettingsForTier(tier);
+	InitIBLPrograms(context);
+	InitPBRProgram(context);
+	ActivateEnvironment(context, scene->activeEnvironment);
+}
+
+// Bakes the first environment synchronously (ignoring the cache) at every tier and reports the bake time and the error
+// of the irradiance and prefiltered maps against the production tier
+void ReportIBLQualityTiers(AppContext *context)
+{
+	IBLBakeSettings settings = context->iblSettings;
+	CubemapImage referenceIrradiance, referencePrefiltered;
+	IBLQuality::Tier cheapestTier = IBLQuality::Production;
+	for (int tierIndex = IBLQuality::TierCount - 1; tierIndex >= 0; --tierIndex)
+	{
+		IBLQuality::Tier tier = IBLQuality::Tier(tierIndex);
+		context->iblSettings = IBLBake::SettingsForTier(tier);
+		InitIBLPrograms(context);
+		IBLBakeSettings *tierSettings = &context->iblSettings;
+
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		Texture hdrTexture, environmentTexture, irradianceMap, prefilteredEnvMap;
+		Graphics::InitHDRTexture(&hdrTexture, context->scene.environments[0].hdrPath.c_str());
+		CubemapFromTexture(context, Shader::EquirectToCubemap, &hdrTexture, &environmentTexture, tierSettings->environmentSize);
+		if (tierSettings->filteredImportanceSampling)
+			Graphics::GenerateMipmaps(&environmentTexture);
+		CubemapFromTexture(context, Shader::EnvToIrradiance, &environmentTexture, &irradianceMap, tierSettings->irradianceSize);
+		PrefilteredEnvMapFromTexture(context, Shader::EnvToPrefilteredEnv, &environmentTexture, &prefilteredEnvMap, tierSettings->prefilteredSize);
+		glFinish();
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		CubemapImage irradianceImage, prefilteredImage;
+		Graphics::ReadCubemapTexture(&irradianceMap, 1, &irradianceImage);
+		Graphics::ReadCubemapTexture(&prefilteredEnvMap, tierSettings->prefilteredMipLevels, &prefilteredImage);
+		Graphics::Release(&hdrTexture);
+		Graphics::Release(&environmentTexture);
+		Graphics::Release(&irradianceMap);
+		Graphics::Release(&prefilteredEnvMap);
+
+		if (tier == IBLQuality::Production)
+		{
+			referenceIrradiance = irradianceImage;
+			referencePrefiltered = prefilteredImage;
+		}
+		ImageError irradianceError = IBLBake::CompareResampled(irradianceImage, referenceIrradiance);
+		ImageError prefilteredError = IBLBake::CompareResampled(prefilteredImage, referencePrefiltered);
+		bool withinTolerance = irradianceError.rmse <= IBL_TIER_TOLERANCE && prefilteredError.rmse <= IBL_TIER_TOLERANCE;
+		if (withinTolerance)
+			cheapestTier = tier;
+		std::cout << IBLBake::TierName(tier) << " tier: " << milliseconds << " ms, irradiance RMSE " << irradianceError.rmse
+				  << ", prefiltered RMSE " << prefilteredError.rmse << (withinTolerance ? "" : " (over tolerance)") << "\n";
+	}
+	std::cout << "Cheapest IBL tier within RMSE " << IBL_TIER_TOLERANCE << ": " << IBLBake::TierName(cheapestTier) << "\n";
+
+	context->iblSettings = settings;
+	InitIBLPrograms(context);
+}
+
+// Projects the environment onto 9 SH coefficients (see InitIrradianceSH for their uniform block).
+// Reads the environment back from the GPU, prefer the coefficients stored in the IBL cache or the asset pack
+SHIrradiance ProjectIrradianceSH(Texture *environmentTexture)
+{
+	CubemapImage environmentImage;
+	Graphics::ReadCubemapTexture(environmentTexture, 1, &environmentImage);
+	SHIrradiance irradiance;
+	IBLBake::ProjectIrradianceSH(environmentImage, &irradiance);
+	return irradiance;
+}
+
+// Bakes the irradiance map of the first environment synchronously and reports the error of the SH approximation
+// against the Riemann sum of EnvToIrradiance.frag
+void ReportIrradianceSHError(AppContext *context)
+{
+	Texture *environmentTexture = &context->scene.textures["skybox0"];
+	SHIrradiance irradiance = ProjectIrradianceSH(environmentTexture);
+	Texture irradianceMap;
+	CubemapImage irradianceImage;
+	CubemapFromTexture(context, Shader::EnvToIrradiance, environmentTexture, &irradianceMap, context->iblSettings.irradianceSize);
+	Graphics::ReadCubemapTexture(&irradianceMap, 1, &irradianceImage);
+	Graphics::Release(&irradianceMap);
+	ImageError error = IBLBake::CompareIrradianceSH(irradiance, irradianceImage);
+	std::cout << "SH irradiance vs irradiance map: RMSE " << error.rmse << ", max " << error.maxError << "\n";
+}
+
+// Converts the environment cubemap of a loaded environment to its irradiance cubemap, or loads that from the IBL cache
+void LoadIrradianceMap(AppContext *context, unsigned int environmentIndex)
+{
+	SceneContext *scene = &context->scene;
+	Environment *environment = &scene->environments[environmentIndex];
+	IBLBakeSettings *settings = &context->iblSettings;
+	IBLCache *cache = &context->iblCache;
+	string index = to_string(environmentIndex);
+
+	Texture *environmentTexture = &scene->textures["skybox" + index];
+	Texture *irradianceMap = &scene->textures["irradianceMap" + index];
+	if (IBLCacheControl::Load(cache, environment->cacheKey, "irradianceMap", irradianceMap))
+		return;
+	if (context->progressiveIBLBake)
+	{
+		QueueProgressiveBake(context, Shader::EnvToIrradiance, environmentTexture, irradianceMap, settings->irradianceSize, 1,
+							 environment->cacheKey, "irradianceMap", "irradianceMap" + index);
+	}
+	else
+	{
+		CubemapFromTexture(context, Shader::EnvToIrradiance, environmentTexture, irradianceMap, settings->irradianceSize);
+		IBLCacheControl::Store(cache, environment->cacheKey, "irradianceMap", irradianceMap);
+	}
+}
+
+void InitIrradianceSH(UniformBuffer *buffer, const SHIrradiance &irradiance)
+{
+	float blockData[9 * 4] = {};
+	for (unsigned int i = 0; i < 9; ++i)
+	{
+		blockData[4 * i + 0] = irradiance.coefficients[i].r;
+		blockData[4 * i + 1] = irradiance.coefficients[i].g;
+		blockData[4 * i + 2] = irradiance.coefficients[i].b;
+	}
+	Graphics::InitUniformBuffer(buffer, blockData, sizeof(blockData));
+}
+
+// The layered variant renders all six faces with one instanced draw, CubeMapLayered.geom routes each instance to its face
+GLuint CreateCubemapProgram(AppContext *context, string fragmentShaderFile, const vector<string> &defines)
+{
+	string shaderDir = SHADER_DIR;
+	if (context->layeredCubemapRendering)
+		return Graphics::CreateProgram(shaderDir + "CubeMapLayered.vert", shaderDir + "CubeMapLayered.geom", shaderDir + fragmentShaderFile, defines);
+	return Graphics::CreateProgram(shaderDir + "CubeMap.vert", shaderDir + fragmentShaderFile, defines);
+}
+
+void SetCubemapFaceMatrices(GLuint program)
+{
+	mat4 projectionMatrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+	for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+		Graphics::SetMatrixUniform(program, projectionMatrix * CUBE_MAP_VIEW_MATRICES[face], "uFaceMatrices[" + to_string(face) + "]");
+}
+
+// Loads the environment's textures from the IBL cache or bakes them (progressively if enabled)
+void LoadEnvironment(AppContext *context, unsigned int environmentIndex)
+{
+	SceneContext *scene = &context->scene;
+	Environment *environment = &scene->environments[environmentIndex];
+	IBLBakeSettings *settings = &context->iblSettings;
+	IBLCache *cache = &context->iblCache;
+	string index = to_string(environmentIndex);
+
+	if (LoadPackedEnvironment(context, environmentIndex))
+	{
+		// Packs without the coefficients (irradianceSH0 etc.) project them from the skybox
+		SHIrradiance irradiance;
+		TextureData description;
+		vector<TextureLevelView> levels;
+		if (!AssetPackControl::GetTexture(context->assetPack, ("irradianceSH" + index).c_str(), &description, &levels) ||
+			!IBLCacheControl::IrradianceSHFromTexture(description, levels, &irradiance))
+			irradiance = ProjectIrradianceSH(&scene->textures["skybox" + index]);
+		InitIrradianceSH(&scene->uniformBuffers["irradianceSH" + index], irradiance);
+		SetEnvironmentResident(context, environment);
+		return;
+	}
+
+	PreparedEnvironment prepared;
+	std::swap(prepared, environment->prepared);
+	uint64_t cacheKey = prepared.valid ? prepared.cacheKey : IBLCacheControl::EnvironmentKey(cache, environment->hdrPath.c_str(), *settings);
+
+	// Convert 2D HDR equirectangular environment map to environment cubemap
+	Texture *environmentTexture = &scene->textures["skybox" + index];
+	if (!IBLCacheControl::Load(cache, cacheKey, "skybox", environmentTexture))
+	{
+		Texture hdrTexture;
+		unsigned int phase = StartupProfileControl::BeginPhase(&context->startupProfile, "InitHDRTexture");
+		if (!prepared.hdrImage.levels.empty())
+			Graphics::InitTexture(&hdrTexture, prepared.hdrImage);
+		else
+			Graphics::InitHDRTexture(&hdrTexture, environment->hdrPath.c_str());
+		StartupProfileControl::EndPhase(&context->startupProfile, phase);
+		CubemapFromTexture(context, Shader::EquirectToCubemap, &hdrTexture, environmentTexture, settings->environmentSize);
+		Graphics::Release(&hdrTexture);
+		if (settings->filteredImportanceSampling)
+			Graphics::GenerateMipmaps(environmentTexture);
+		IBLCacheControl::Store(cache, cacheKey, "skybox", environmentTexture);
+	}
+
+	// The irradiance cubemap is only needed without the SH irradiance, see ActivateEnvironment
+	environment->cacheKey = cacheKey;
+	if (!context->shIrradiance)
+		LoadIrradianceMap(context, environmentIndex);
+
+	// Project environment cubemap to SH irradiance coefficients
+	SHIrradiance irradiance;
+	if (!IBLCacheControl::LoadIrradianceSH(cache, cacheKey, &irradiance))
+	{
+		irradiance = ProjectIrradianceSH(environmentTexture);
+		IBLCacheControl::StoreIrradianceSH(cache, cacheKey, irradiance);
+	}
+	InitIrradianceSH(&scene->uniformBuffers["irradianceSH" + index], irradiance);
+
+	// Convert environment cubemap to prefiltered environment cubemap
+	Texture *prefilteredEnvMap = &scene->textures["prefilteredEnvMap" + index];
+	if (!IBLCacheControl::Load(cache, cacheKey, "prefilteredEnvMap", prefilteredEnvMap))
+	{
+#if CPU_PREFILTER
+		CubemapImage environmentImage, prefilteredImage;
+		Graphics::ReadCubemapTexture(environmentTexture, 1, &environmentImage);
+		if (settings->filteredImportanceSampling)
+			IBLBake::GenerateMips(&environmentImage);
+		IBLBake::PrefilteredEnvMapFromCubemap(environmentImage, &prefilteredImage, *settings);
+		Graphics::InitCubemapTexture(prefilteredEnvMap, prefilteredImage);
+		IBLCacheControl::Store(cache, cacheKey, "prefilteredEnvMap", prefilteredEnvMap);
+#else
+		if (context->progressiveIBLBake)
+		{
+			QueueProgressiveBake(context, Shader::EnvToPrefilteredEnv, environmentTexture, prefilteredEnvMap, settings->prefilteredSize,
+								 settings->prefilteredMipLevels, cacheKey, "prefilteredEnvMap", "prefilteredEnvMap" + index);
+		}
+		else
+		{
+			PrefilteredEnvMapFromTexture(context, Shader::EnvToPrefilteredEnv, environmentTexture, prefilteredEnvMap, settings->prefilteredSize);
+			IBLCacheControl::Store(cache, cacheKey, "prefilteredEnvMap", prefilteredEnvMap);
+		}
+#endif
+	}
+#if VALIDATE_CPU_PREFILTER
+	ValidateCPUPrefilter(context, environmentTexture);
+#endif
+	SetEnvironmentResident(context, environment);
+}
+
+// Environments in the asset pack (skybox0, irradianceMap0 and prefilteredEnvMap0 for the first one, packed from the IBL
+// cache entries) are used instead of the cache or a bake if all three match the sizes of the current IBL settings
+bool LoadPackedEnvironment(AppContext *context, unsigned int environmentIndex)
+{
+	if (!HasPackedEnvironment(context, environmentIndex))
+		return false;
+
+	SceneContext *scene = &context->scene;
+	string index = to_string(environmentIndex);
+	const char *textureNames[] = { "skybox", "irradianceMap", "prefilteredEnvMap" };
+	for (unsigned int i = 0; i < ARRAYSIZE(textureNames); ++i)
+		LoadPackedTexture(context->assetPack, (textureNames[i] + index).c_str(), &scene->textures[textureNames[i] + index]);
+	return true;
+}
+
+bool HasPackedEnvironment(AppContext *context, unsigned int environmentIndex)
+{
+	IBLBakeSettings *settings = &context->iblSettings;
+	string index = to_string(environmentIndex);
+	const char *textureNames[] = { "skybox", "irradianceMap", "prefilteredEnvMap" };
+	unsigned int sizes[] = { settings->environmentSize, settings->irradianceSize, settings->prefilteredSize };
+	unsigned int mipCounts[] = { 0, 1, settings->prefilteredMipLevels };		// 0: whatever the skybox was baked with
+	for (unsigned int i = 0; i < ARRAYSIZE(textureNames); ++i)
+	{
+		const AssetPackEntry *entry = AssetPackControl::Find(context->assetPack, (textureNames[i] + index).c_str(), AssetType::Texture);
+		if (!entry || entry->target != TextureTarget::Cubemap || entry->width != sizes[i] || (mipCounts[i] != 0 && entry->mipCount != mipCounts[i]))
+			return false;
+	}
+	return true;
+}
+
+// Hashes the environment's HDR file on the job graph and decodes it if the IBL cache has no skybox for it. The
+// results are left in Environment::prepared for LoadEnvironment. Returns the job to wait for before loading it.
+unsigned int AddEnvironmentJobs(JobGraph *jobs, AppContext *context, unsigned int environmentIndex, unsigned int cacheJob)
+{
+	if (HasPackedEnvironment(context, environmentIndex))
+		return cacheJob;
+
+	Environment *environment = &context->scene.environments[environmentIndex];
+	IBLCache *cache = &context->iblCache;
+	IBLBakeSettings settings = context->iblSettings;
+	unsigned int keyJob = JobGraphControl::Add(jobs, "hash " + environment->hdrPath, [=]()
+	{
+		environment->prepared.cacheKey = IBLCacheControl::EnvironmentKey(cache, environment->hdrPath.c_str(), settings);
+		environment->prepared.valid = true;
+	}, { cacheJob });
+	return JobGraphControl::Add(jobs, "decode " + environment->hdrPath, [=]()
+	{
+		if (!IBLCacheControl::Contains(cache, environment->prepared.cacheKey, "skybox"))
+			Graphics::ReadHDRImage(environment->hdrPath.c_str(), &environment->prepared.hdrImage);
+	}, { keyJob });
+}
+
+void SetEnvironmentResident(AppContext *context, Environment *environment)
+{
+	// The textures of a progressive bake are allocated when it is queued, so this is the final size
+	SceneContext *scene = &context->scene;
+	string index = to_string(environment - scene->environments.data());
+	const char *textureNames[] = { "skybox", "irradianceMap", "prefilteredEnvMap" };
+	environment->memoryBytes = 0;
+	for (unsigned int i = 0; i < ARRAYSIZE(textureNames); ++i)
+		environment->memoryBytes += scene->textures[textureNames[i] + index].memoryBytes;
+	environment->resident = true;
+}
+
+// Views the mesh in the mapped asset pack if it has one with this name, otherwise generates it and orders it for the
+// GPU (see MeshOptimizer), which packassets has done for the packed meshes already. Meshes drawn through the
+// ClusterCuller need meshlets, the others go without so that their models keep no copy of the indices.
+unsigned int AddMeshJob(JobGraph *jobs, const AssetPack &pack, const char *name, PreparedMesh *prepared, std::function<Mesh()> makeMesh,
+						bool meshlets)
+{
+	string meshName = name;
+	return JobGraphControl::Add(jobs, meshName, [=, &pack]()
+	{
+		prepared->generated = !AssetPackControl::GetMesh(pack, meshName.c_str(), &prepared->mesh);
+		if (prepared->generated)
+		{
+			prepared->mesh = makeMesh();
+			MeshOptimizer::Optimize(&prepared->mesh);
+			if (meshlets)
+				MeshletBuilder::Build(&prepared->mesh);
+		}
+		else if (!meshlets)
+			prepared->mesh.meshlets.clear();
+	});
+}
+
+void InitPreparedModel(JobGraph *jobs, unsigned int job, PreparedMesh *prepared, Model *model)
+{
+	JobGraphControl::Wait(jobs, job);
+	Graphics::InitModel(model, prepared->mesh, false);
+	FreePreparedMesh(prepared);
+}
+
+void FreePreparedMesh(PreparedMesh *prepared)
+{
+	if (prepared->generated)
+		UtilMesh::Free(prepared->mesh);
+	*prepared = PreparedMesh();
+}
+
+// With a residency the finer mips of the texture are streamed from the pack, only for 2D textures
+bool LoadPackedTexture(const AssetPack &pack, const char *name, Texture *texture, TextureResidency *residency)
+{
+	TextureData description;
+	vector<TextureLevelView> levels;
+	if (!AssetPackControl::GetTexture(pack, name, &description, &levels))
+		return false;
+	Graphics::InitTexture(texture, description, levels);
+	if (residency)
+		TextureResidencyControl::AddStreamed(residency, texture, description, levels);
+	return true;
+}
+
+void ReleaseEnvironment(AppContext *context, unsigned int environmentIndex)
+{
+	SceneContext *scene = &context->scene;
+	string index = to_string(environmentIndex);
+	const char *textureNames[] = { "skybox", "irradianceMap", "prefilteredEnvMap" };
+	for (unsigned int i = 0; i < ARRAYSIZE(textureNames); ++i)
+	{
+		IBLBakeSchedulerControl::Cancel(&context->iblBakeScheduler, textureNames[i] + index);
+		Graphics::Release(&scene->textures[textureNames[i] + index]);
+		scene->textures.erase(textureNames[i] + index);
+	}
+	Graphics::Release(&scene->uniformBuffers["irradianceSH" + index]);
+	scene->uniformBuffers.erase("irradianceSH" + index);
+
+	scene->environments[environmentIndex].resident = false;
+	scene->environments[environmentIndex].memoryBytes = 0;
+}
+
+// Makes the environment resident and releases the least recently used other environments while the resident ones
+// exceed the memory budget. Released environments are reloaded from the IBL cache (or re-baked) on their next activation.
+void ActivateEnvironment(AppContext *context, unsigned int environmentIndex)
+{
+	SceneContext *scene = &context->scene;
+	Environment *environment = &scene->environments[environmentIndex];
+	if (!environment->resident)
+		LoadEnvironment(context, environmentIndex);
+	else if (!context->shIrradiance && scene->textures["irradianceMap" + to_string(environmentIndex)].id == 0)
+	{
+		// Loaded while the SH irradiance was used
+		LoadIrradianceMap(context, environmentIndex);
+		SetEnvironmentResident(context, environment);
+	}
+	environment->lastUse = ++scene->environmentUseCounter;
+
+	for (;;)
+	{
+		size_t residentBytes = 0;
+		int leastRecentlyUsed = -1;
+		for (unsigned int i = 0; i < scene->environments.size(); ++i)
+		{
+			Environment *candidate = &scene->environments[i];
+			if (!candidate->resident)
+				continue;
+			residentBytes += candidate->memoryBytes;
+			if (i != environmentIndex && (leastRecentlyUsed < 0 || candidate->lastUse < scene->environments[leastRecentlyUsed].lastUse))
+				leastRecentlyUsed = int(i);
+		}
+		if (residentBytes <= context->environmentMemoryBudget || leastRecentlyUsed < 0)
+			break;
+		ReleaseEnvironment(context, (unsigned int)leastRecentlyUsed);
+	}
+}
+
+// Draws the skybox model into every face of the given mip of the cubemap, the render context has to be bound
+void RenderCubemapFaces(AppContext *context, Shader shader, RenderContext *cubeMapRC, GLuint cubemap, unsigned int mip, bool clear)
+{
+	GLuint program = context->shaders[shader];
+	if (context->layeredCubemapRendering)
+	{
+		SetCubemapFaceMatrices(program);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cubemap, mip);
+		if (clear)
+			glClear(GL_COLOR_BUFFER_BIT);
+		Graphics::RenderModelInstanced(&context->skyBoxModel, program, NUMBER_OF_CUBE_FACES);
+		return;
+	}
+
+	cubeMapRC->camera.projectionMatrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+	for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+	{
+		cubeMapRC->camera.viewMatrix = CUBE_MAP_VIEW_MATRICES[face];
+		CameraControl::Use(&cubeMapRC->camera, program);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemap, mip);
+		if (clear)
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Graphics::RenderModel(&context->skyBoxModel, program);
+	}
+}
+
 void CubemapFromTexture(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize)
 {
+	ProfileScope scope(&context->startupProfile, "CubemapFromTexture");
+	if (context->computeIBLBake)
+	{
+		Graphics::InitCubemapTexture(cubemapTexture, cubeMapSize, 1, GL_RGBA16F);
+		DispatchCubemapBake(context, shader, sampledTexture, cubemapTexture, cubeMapSize, IBLBakeUnit(), 1);
+		return;
+	}
+
 	RenderContext cubeMapRC;
-	Graphics::InitCubeMapFramebuffer(&cubeMapRC.framebuffer, cubeMapSize, cubeMapSize, false);
+	Graphics::InitCubeMapFramebuffer(&cubeMapRC.framebuffer, cubeMapSize, cubeMapSize, false, context->layeredCubemapRendering);
 	cubeMapRC.viewport = Viewport(0, 0, cubeMapSize, cubeMapSize);
-	
-	// cubeMapFaces order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
-	const unsigned int numberOfCubeFaces = 6;
-	mat4 cubeMapViewMatrices[numberOfCubeFaces] =
-	{
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f)),
-	};
 
 	BindRenderContext(context, &cubeMapRC, shader);
-	for (unsigned int i = 0; i < numberOfCubeFaces; ++i)
-	{
-		cubeMapRC.camera.projectionMatrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-		cubeMapRC.camera.viewMatrix = cubeMapViewMatrices[i];
-		CameraControl::Use(&cubeMapRC.camera, context->shaders[shader]);
-
-		Graphics::BindTexture(sampledTexture, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubeMapRC.framebuffer.colorAttachment.id, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		Graphics::RenderModel(&context->skyBoxModel, context->shaders[shader]);
-	}
+	Graphics::SetUniform1i(context->shaders[shader], 0, "uSampleBatch");
+	Graphics::SetUniform1i(context->shaders[shader], 1, "uSampleBatchCount");
+	Graphics::BindTexture(sampledTexture, 0);
+	RenderCubemapFaces(context, shader, &cubeMapRC, cubeMapRC.framebuffer.colorAttachment.id, 0, true);
 
 	cubemapTexture->id = cubeMapRC.framebuffer.colorAttachment.id;
 	cubemapTexture->target = TextureTarget::Cubemap;
+	cubemapTexture->memoryBytes = Graphics::TextureMemoryBytes(cubemapTexture);
 	cubeMapRC.framebuffer.colorAttachment.id = 0;
 	Graphics::Release(&cubeMapRC);
 }
 
+void SetPrefilterMipUniforms(AppContext *context, GLuint program, unsigned int mipLevel)
+{
+	IBLBakeSettings *settings = &context->iblSettings;
+	float roughness = settings->prefilteredMipLevels > 1 ? float(mipLevel) / float(settings->prefilteredMipLevels - 1) : 0.0f;
+	Graphics::SetUniform1f(program, roughness, "uRoughness");
+	Graphics::SetUniform1i(program, IBLBake::PrefilteredSampleCount(*settings, mipLevel), "uNumSamples");
+	Graphics::SetUniform1f(program, float(settings->environmentSize), "uEnvironmentSize");
+}
+
 void PrefilteredEnvMapFromTexture(AppContext *context, Shader shader, Texture *sampledTexture, Texture *prefilteredEnvMapTexture, unsigned int cubeMapSize)
 {
+	ProfileScope scope(&context->startupProfile, "PrefilteredEnvMapFromTexture");
+	unsigned int maxMipLevels = context->iblSettings.prefilteredMipLevels;
+	if (context->computeIBLBake)
+	{
+		Graphics::InitCubemapTexture(prefilteredEnvMapTexture, cubeMapSize, maxMipLevels, GL_RGBA16F);
+		for (IBLBakeUnit unit; unit.mip < maxMipLevels; ++unit.mip)
+			DispatchCubemapBake(context, shader, sampledTexture, prefilteredEnvMapTexture, cubeMapSize, unit, 1);
+		return;
+	}
+
 	RenderContext cubeMapRC;
-	Graphics::InitCubeMapFramebuffer(&cubeMapRC.framebuffer, cubeMapSize, cubeMapSize, true);
+	bool layered = context->layeredCubemapRendering;
+	Graphics::InitCubeMapFramebuffer(&cubeMapRC.framebuffer, cubeMapSize, cubeMapSize, true, layered);
 	cubeMapRC.viewport = Viewport(0, 0, cubeMapSize, cubeMapSize);
 	BindRenderContext(context, &cubeMapRC, shader);
+	Graphics::SetUniform1i(context->shaders[shader], 0, "uSampleBatch");
+	Graphics::SetUniform1i(context->shaders[shader], 1, "uSampleBatchCount");
 	Graphics::BindTexture(sampledTexture, 0);
 
-	// cubeMapFaces order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
-	const unsigned int numberOfCubeFaces = 6;
-	mat4 cubeMapViewMatrices[numberOfCubeFaces] =
-	{
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f)),
-	};
-
-	unsigned int maxMipLevels = 5;
 	for (unsigned int mipLevel = 0; mipLevel < maxMipLevels; ++mipLevel)
 	{
 		unsigned int mipSize = (unsigned int)(cubeMapSize * pow(0.5f, mipLevel));
 		cubeMapRC.viewport = Viewport(0, 0, mipSize, mipSize);
-		float roughness = float(mipLevel) / float(maxMipLevels - 1);
-		Graphics::SetUniform1f(context->shaders[shader], roughness, "uRoughness");
-		glBindRenderbuffer(GL_RENDERBUFFER, cubeMapRC.framebuffer.depthAttachment.id);
-		glRenderbufferStorage(GL_RENDERBUFFER, cubeMapRC.framebuffer.depthAttachment.internalFormat, mipSize, mipSize);
-
-		for (unsigned int face = 0; face < numberOfCubeFaces; ++face)
+		Graphics::BindRenderContext(&cubeMapRC, context->shaders[shader]);
+		SetPrefilterMipUniforms(context, context->shaders[shader], mipLevel);
+		if (!layered)
 		{
-			//cubeMapRC.camera.projectionMatrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-			cubeMapRC.camera.viewMatrix = cubeMapViewMatrices[face];
-			Graphics::BindRenderContext(&cubeMapRC, context->shaders[shader]);
-
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeMapRC.framebuffer.colorAttachment.id, mipLevel);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			Graphics::RenderModel(&context->skyBoxModel, context->shaders[shader]);
+			glBindRenderbuffer(GL_RENDERBUFFER, cubeMapRC.framebuffer.depthAttachment.id);
+			glRenderbufferStorage(GL_RENDERBUFFER, cubeMapRC.framebuffer.depthAttachment.internalFormat, mipSize, mipSize);
 		}
+		RenderCubemapFaces(context, shader, &cubeMapRC, cubeMapRC.framebuffer.colorAttachment.id, mipLevel, true);
 	}
 
 	prefilteredEnvMapTexture->id = cubeMapRC.framebuffer.colorAttachment.id;
 	prefilteredEnvMapTexture->target = TextureTarget::Cubemap;
+	prefilteredEnvMapTexture->memoryBytes = Graphics::TextureMemoryBytes(prefilteredEnvMapTexture);
 	cubeMapRC.framebuffer.colorAttachment.id = 0;
 	Graphics::Release(&cubeMapRC);
 }
 
+// Renders one sample batch of one mip and blends it into the running average of the previous batches
+// (alpha = 1 / (batch + 1)), so the texture holds a usable estimate after every unit.
+bool BakeCubemapUnit(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+					 IBLBakeUnit unit)
+{
+	GLuint program = context->shaders[shader];
+	unsigned int batchCount = context->iblBakeScheduler.sampleBatches;
+	if (shader == Shader::EnvToPrefilteredEnv)
+	{
+		// Low sample count mips are split into fewer batches so that no unit is (nearly) empty
+		unsigned int numSamples = IBLBake::PrefilteredSampleCount(context->iblSettings, unit.mip);
+		batchCount = std::max(1u, std::min(batchCount, numSamples / MIN_SAMPLES_PER_BATCH));
+		if (unit.batch >= batchCount)
+			return false;
+	}
+	if (context->computeIBLBake)
+	{
+		DispatchCubemapBake(context, shader, sampledTexture, cubemapTexture, cubeMapSize, unit, batchCount);
+		return true;
+	}
+
+	unsigned int mipSize = std::max(cubeMapSize >> unit.mip, 1u);
+	context->iblBakeRC.viewport = Viewport(0, 0, mipSize, mipSize);
+	BindRenderContext(context, &context->iblBakeRC, shader);
+	if (shader == Shader::EnvToPrefilteredEnv)
+		SetPrefilterMipUniforms(context, program, unit.mip);
+	Graphics::SetUniform1i(program, unit.batch, "uSampleBatch");
+	Graphics::SetUniform1i(program, batchCount, "uSampleBatchCount");
+	Graphics::BindTexture(sampledTexture, 0);
+
+	glEnable(GL_BLEND);
+	glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / float(unit.batch + 1));
+	glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+	RenderCubemapFaces(context, shader, &context->iblBakeRC, cubemapTexture->id, unit.mip, false);
+	glDisable(GL_BLEND);
+	return true;
+}
+
+// Allocates the cubemap and queues its bake, the result is stored in the cache once the last unit is done
+void QueueProgressiveBake(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+						  unsigned int mipCount, uint64_t cacheKey, string product, string name)
+{
+	Graphics::InitCubemapTexture(cubemapTexture, cubeMapSize, mipCount, context->computeIBLBake ? GL_RGBA16F : GL_RGB16F);
+
+	IBLBakeJob job;
+	job.name = name;
+	job.mipCount = mipCount;
+	job.batchCount = context->iblBakeScheduler.sampleBatches;
+	job.bakeUnit = [=](IBLBakeUnit unit)
+	{
+		return BakeCubemapUnit(context, shader, sampledTexture, cubemapTexture, cubeMapSize, unit);
+	};
+	job.finish = [=]()
+	{
+		IBLCacheControl::Store(&context->iblCache, cacheKey, product.c_str(), cubemapTexture);
+	};
+	IBLBakeSchedulerControl::Add(&context->iblBakeScheduler, job);
+}
+
+// Compute shader counterpart of a cubemap baking fragment shader
+Shader ComputeShader(Shader shader)
+{
+	switch (shader)
+	{
+		case Shader::EquirectToCubemap:
+			return Shader::EquirectToCubemapCompute;
+		case Shader::EnvToIrradiance:
+			return Shader::EnvToIrradianceCompute;
+		default:
+			return Shader::EnvToPrefilteredEnvCompute;
+	}
+}
+
+// Bakes one sample batch of one mip level of all six faces with a single dispatch. The batch is blended into the
+// cubemap (which has to be RGBA16F for image stores) the same way BakeCubemapUnit blends its draws.
+void DispatchCubemapBake(AppContext *context, Shader shader, Texture *sampledTexture, Texture *cubemapTexture, unsigned int cubeMapSize,
+						 IBLBakeUnit unit, unsigned int batchCount)
+{
+	const unsigned int workgroupSize = 8;
+	GLuint program = context->shaders[ComputeShader(shader)];
+	unsigned int mipSize = std::max(cubeMapSize >> unit.mip, 1u);
+
+	Graphics::UseProgram(program);
+	if (shader == Shader::EnvToPrefilteredEnv)
+		SetPrefilterMipUniforms(context, program, unit.mip);
+	// The fragment shaders sample the environment through their derivatives, which select about this mip level
+	float sourceLod = std::max(float(log2(double(context->iblSettings.environmentSize) / double(mipSize))), 0.0f);
+	Graphics::SetUniform1f(program, sourceLod, "uSourceLod");
+	Graphics::SetUniform1i(program, mipSize, "uCubemapSize");
+	Graphics::SetUniform1i(program, unit.batch, "uSampleBatch");
+	Graphics::SetUniform1i(program, batchCount, "uSampleBatchCount");
+	Graphics::SetUniform1f(program, 1.0f / float(unit.batch + 1), "uBlendAlpha");
+	Graphics::BindTexture(sampledTexture, 0);
+
+	glBindImageTexture(0, cubemapTexture->id, unit.mip, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
+	unsigned int groupCount = (mipSize + workgroupSize - 1) / workgroupSize;
+	glDispatchCompute(groupCount, groupCount, NUMBER_OF_CUBE_FACES);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+}
+
+// Bakes every IBL cubemap of the first environment with the compute and the fragment path (synchronously, ignoring the
+// cache) and prints the average time of each and how far the compute results are from the fragment results
+void BenchmarkComputeIBL(AppContext *context)
+{
+	if (!GLAD_GL_VERSION_4_3)
+	{
+		std::cerr << "Compute IBL benchmark needs GL 4.3\n";
+		return;
+	}
+
+	IBLBakeSettings *settings = &context->iblSettings;
+	Texture hdrTexture;
+	Graphics::InitHDRTexture(&hdrTexture, context->scene.environments[0].hdrPath.c_str());
+
+	const char *names[] = { "Environment cubemap", "Irradiance map", "Prefiltered environment map" };
+	Shader shaders[] = { Shader::EquirectToCubemap, Shader::EnvToIrradiance, Shader::EnvToPrefilteredEnv };
+	unsigned int sizes[] = { settings->environmentSize, settings->irradianceSize, settings->prefilteredSize };
+	unsigned int mipCounts[] = { 1, 1, settings->prefilteredMipLevels };
+
+	bool computeIBLBake = context->computeIBLBake;
+	Texture environmentTexture;
+	for (unsigned int i = 0; i < ARRAYSIZE(shaders); ++i)
+	{
+		Texture *sampledTexture = i == 0 ? &hdrTexture : &environmentTexture;
+		CubemapImage images[2];
+		double milliseconds[2];
+		for (unsigned int path = 0; path < 2; ++path)
+		{
+			context->computeIBLBake = path == 0;
+			Texture result;
+			glFinish();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int run = 0; run < BENCHMARK_COMPUTE_IBL_RUNS; ++run)
+			{
+				Graphics::Release(&result);
+				if (shaders[i] == Shader::EnvToPrefilteredEnv)
+					PrefilteredEnvMapFromTexture(context, shaders[i], sampledTexture, &result, sizes[i]);
+				else
+					CubemapFromTexture(context, shaders[i], sampledTexture, &result, sizes[i]);
+			}
+			glFinish();
+			milliseconds[path] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() /
+								 BENCHMARK_COMPUTE_IBL_RUNS;
+			Graphics::ReadCubemapTexture(&result, mipCounts[i], &images[path]);
+
+			// The fragment shader environment (with its mips) is the input of the other two bakes
+			if (i == 0 && path == 1)
+			{
+				environmentTexture = result;
+				if (settings->filteredImportanceSampling)
+					Graphics::GenerateMipmaps(&environmentTexture);
+			}
+			else
+				Graphics::Release(&result);
+		}
+
+		ImageError error = IBLBake::Compare(images[0], images[1]);
+		std::cout << names[i] << ": compute " << milliseconds[0] << " ms, fragment " << milliseconds[1] << " ms ("
+				  << milliseconds[1] / milliseconds[0] << "x), RMSE " << error.rmse << ", max " << error.maxError << "\n";
+	}
+	context->computeIBLBake = computeIBLBake;
+
+	Graphics::Release(&environmentTexture);
+	Graphics::Release(&hdrTexture);
+}
+
+// Bakes the prefiltered environment map both with the shader and with IBLBake and reports how far apart they are
+void ValidateCPUPrefilter(AppContext *context, Texture *environmentTexture)
+{
+	IBLBakeSettings *settings = &context->iblSettings;
+	Texture gpuTexture;
+	PrefilteredEnvMapFromTexture(context, Shader::EnvToPrefilteredEnv, environmentTexture, &gpuTexture, settings->prefilteredSize);
+	CubemapImage gpuImage;
+	Graphics::ReadCubemapTexture(&gpuTexture, settings->prefilteredMipLevels, &gpuImage);
+	Graphics::Release(&gpuTexture);
+
+	CubemapImage environmentImage, cpuImage;
+	Graphics::ReadCubemapTexture(environmentTexture, 1, &environmentImage);
+	if (settings->filteredImportanceSampling)
+		IBLBake::GenerateMips(&environmentImage);
+	IBLBake::PrefilteredEnvMapFromCubemap(environmentImage, &cpuImage, *settings);
+
+	for (unsigned int mip = 0; mip < settings->prefilteredMipLevels; ++mip)
+	{
+		ImageError error = IBLBake::Compare(gpuImage, cpuImage, mip);
+		const char *result = error.rmse <= CPU_PREFILTER_TOLERANCE ? "OK" : "FAILED";
+		std::cout << "CPU prefilter mip " << mip << ": RMSE " << error.rmse << ", max " << error.maxError << " " << result << "\n";
+	}
+}
+
 void UpdateScene(AppContext *context, double dt)
 {
 	CameraControl::UpdateCamera(&context->sceneRC.camera, dt, &context->userInput);
@@ -438,19 +1376,64 @@ void UpdateScene(AppContext *context, double dt)
 	if (context->userInput.qPressed && context->globalTime - lastEnvironmentChangeTime > 0.05)	
 	{
 		lastEnvironmentChangeTime = context->globalTime;
-		context->scene.activeEnvironment = context->scene.activeEnvironment == 0 ? 1 : 0;
+		context->scene.activeEnvironment = (context->scene.activeEnvironment + 1) % int(context->scene.environments.size());
+		ActivateEnvironment(context, context->scene.activeEnvironment);
 	}
 
 	UserInput cleanUserInput = {};
 	context->userInput = cleanUserInput;
 }
 
+// Pixels across the bounding sphere of an object on screen, at the depth of its nearest point
+static float ProjectedDiameter(const RenderContext &renderContext, const SceneObject &object)
+{
+	const Camera &camera = renderContext.camera;
+	vec3 center = vec3(camera.viewMatrix * object.modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	float depth = std::max(-center.z - object.boundingRadius, 0.01f);
+	return 2.0f * object.boundingRadius * camera.projectionMatrix[1][1] * 0.5f * renderContext.viewport.height / depth;
+}
+
+// Texture width an object needs on screen: its projected diameter, times pi because the UV sphere wraps the
+// texture around its circumference once
+static float RequiredTexels(const RenderContext &renderContext, const SceneObject &object)
+{
+	return glm::pi<float>() * ProjectedDiameter(renderContext, object);
+}
+
+// Coarsest level of detail of the object's model whose error stays below LOD_PIXEL_ERROR on screen, see LEVELS_OF_DETAIL
+static unsigned int SelectLevel(const RenderContext &renderContext, const SceneObject &object)
+{
+	const vector<ModelLevel> &levels = object.model->levels;
+	float pixelsPerUnit = ProjectedDiameter(renderContext, object) / (2.0f * object.boundingRadius);
+	for (unsigned int level = (unsigned int)levels.size(); level-- > 1;)
+	{
+		float maxPixelError = level > object.level ? LOD_PIXEL_ERROR * LOD_HYSTERESIS : LOD_PIXEL_ERROR;
+		if (levels[level].error * pixelsPerUnit <= maxPixelError)
+			return level;
+	}
+	return 0;
+}
+
 void RenderScene(AppContext *context)
 {
 	GLuint program = context->shaders[context->activeShader];
 	int i = 0;
-	for (auto it : context->scene.objects)
+	for (auto &it : context->scene.objects)
 	{
+#if LEVELS_OF_DETAIL
+		if (context->activeRC == &context->sceneRC)
+			it.second.level = SelectLevel(context->sceneRC, it.second);
+#endif
+#ifdef MATERIAL_TEXTURES
+		if (context->activeRC == &context->sceneRC)
+		{
+			TextureResidency *residency = &context->textureResidency;
+			float texels = RequiredTexels(context->sceneRC, it.second);
+			Texture *textures[] = { it.second.metalnessTexture, it.second.roughnessTexture, it.second.ormTexture };
+			for (unsigned int t = 0; t < ARRAYSIZE(textures); ++t)
+				TextureResidencyControl::Request(residency, textures[t], texels);
+		}
+#endif
 		if (context->activeShader == Shader::Phong)
 		{
 			PhongMaterial PhongMat = context->scene.PhongMaterials[it.second.materialIndex];
@@ -467,17 +1450,30 @@ void RenderScene(AppContext *context)
 			Graphics::SetUniform1f(program, PBRmat.roughness, "uRoughness");
 			Graphics::SetUniform1f(program, PBRmat.AO, "uAO");
 #ifdef MATERIAL_TEXTURES
-			Graphics::BindTexture(it.second.albedoTexture, PBRSamplers::Albedo2D);
+#if ORM_TEXTURE
+			Graphics::BindTexture(it.second.ormTexture, PBRSamplers::ORM2D);
+#else
 			Graphics::BindTexture(it.second.metalnessTexture, PBRSamplers::Metalness2D);
 			Graphics::BindTexture(it.second.roughnessTexture, PBRSamplers::Roughness2D);
-			Graphics::BindTexture(it.second.normalTexture, PBRSamplers::Normal2D);
+#endif
 #endif
 			Graphics::BindTexture(&context->scene.textures["integratedBRDF"], PBRSamplers::IntegratedBRDF2D);
 			Graphics::BindTexture(&context->scene.textures["irradianceMap" + to_string(context->scene.activeEnvironment)], PBRSamplers::IrradianceMapCube);
 			Graphics::BindTexture(&context->scene.textures["prefilteredEnvMap" + to_string(context->scene.activeEnvironment)], PBRSamplers::PrefilteredEnvMapCube);
+			Graphics::BindUniformBuffer(&context->scene.uniformBuffers["irradianceSH" + to_string(context->scene.activeEnvironment)], PBRUniformBlocks::SHIrradiance);
 		}
 
-		Graphics::RenderModel(&it.second.model, program, it.second.modelMatrix);	
+#if CLUSTER_CULLING
+		GLuint indexCount = ClusterCullingControl::RenderModel(&context->clusterCuller, it.second.model, program, context->activeRC->camera,
+															   it.second.modelMatrix, it.second.level);
+#else
+		Graphics::RenderModel(it.second.model, program, it.second.modelMatrix, it.second.level);
+		GLuint indexCount = Graphics::IndexCount(*it.second.model, it.second.level);
+#endif
+		RenderStats *stats = &context->renderStats;
+		stats->drawCount += indexCount > 0 ? 1 : 0;
+		stats->triangleCount += indexCount / 3;
+		stats->fullDetailTriangleCount += Graphics::IndexCount(*it.second.model, 0) / 3;
 		++i;
 	}
 }
@@ -509,10 +1505,56 @@ void RenderUI(AppContext *context)
 	
 	ImGui::SetNextWindowSize(ImVec2(10, 10), ImGuiSetCond_Appearing);
 	ImGui::Begin("PBR", NULL, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse);
-	ImGui::SetWindowSize(ImVec2(170, 70), ImGuiSetCond_Always);
+	ImGui::SetWindowSize(ImVec2(170, 280), ImGuiSetCond_Always);
 
 	ImGui::Text("W/S - Shift camera");
 	ImGui::Text("Q - Cycle environment");
+	ImGui::Text("IBL cache: %u/%u hits", context->iblCache.hits, context->iblCache.hits + context->iblCache.misses);
+	size_t residentBytes = 0;
+	for (unsigned int i = 0; i < scene->environments.size(); ++i)
+		residentBytes += scene->environments[i].memoryBytes;
+	ImGui::Text("Env %d/%u, %.0f/%.0f MB", scene->activeEnvironment + 1, (unsigned int)scene->environments.size(),
+				double(residentBytes) / (1024.0 * 1024.0), double(context->environmentMemoryBudget) / (1024.0 * 1024.0));
+	ImGui::Text("%.2f ms/frame", 1000.0f / ImGui::GetIO().Framerate);
+	const RenderStats &stats = context->renderStats;
+	ImGui::Text("%u draws, %.1fk/%.1fk tris", stats.drawCount, double(stats.triangleCount) / 1000.0,
+				double(stats.fullDetailTriangleCount) / 1000.0);
+	const ClusterCullingStats &culling = context->clusterCuller.stats;
+	if (culling.triangleCount > 0)
+	{
+		ImGui::Text("Culled %.0f%% tris (%.0f%% back)", 100.0 * double(culling.frustumCulledTriangleCount + culling.backfaceCulledTriangleCount) / double(culling.triangleCount),
+					100.0 * double(culling.backfaceCulledTriangleCount) / double(culling.triangleCount));
+	}
+	IBLBakeScheduler *bakeScheduler = &context->iblBakeScheduler;
+	if (!IBLBakeSchedulerControl::IsIdle(*bakeScheduler))
+	{
+		ImGui::Text("IBL bake %.0f%%", 100.0f * IBLBakeSchedulerControl::Progress(*bakeScheduler));
+		ImGui::Text("%.2f/%.1f ms GPU", bakeScheduler->lastMeasuredFrameMs, bakeScheduler->frameBudgetMs);
+	}
+	TextureLoader *textureLoader = &context->textureLoader;
+	if (!TextureLoaderControl::IsIdle(*textureLoader))
+	{
+		ImGui::Text("Textures: %u loading, %.1f MB", (unsigned int)textureLoader->uploads.size(),
+					double(textureLoader->lastFrameUploadBytes) / (1024.0 * 1024.0));
+	}
+	TextureResidency *residency = &context->textureResidency;
+	ImGui::Text("Tex %.0f/%.0f MB, %u mips out", double(residency->totalBytes) / (1024.0 * 1024.0),
+				double(residency->budgetBytes) / (1024.0 * 1024.0), residency->droppedLevelCount);
+	if (ImGui::Checkbox("SH irradiance", &context->shIrradiance))
+	{
+		// Loads or bakes the irradiance map if the environment has none yet
+		ActivateEnvironment(context, scene->activeEnvironment);
+		InitPBRProgram(context);
+	}
+	if (ImGui::Checkbox("Analytic env BRDF", &context->analyticEnvironmentBRDF))
+	{
+		InitPBRProgram(context);
+	}
+	int tier = context->iblQualityTier;
+	if (ImGui::Combo("IBL", &tier, "Draft\0Interactive\0Production\0\0"))
+	{
+		SetIBLQualityTier(context, IBLQuality::Tier(tier));
+	}
 
 	ImGui::End();
 #if 0
@@ -537,27 +1579,44 @@ void RenderDebugObjects(AppContext *context)
 	{
 		DEBUG::RenderCube(context, context->scene.pointLights[i].position, 0.3f, vec3(1.0f, 1.0f, 1.0f));
 	}
-	DEBUG::RenderTexturedQuad(context, &context->scene.textures["albedo"]);
+	Texture *display = &context->scene.textures["display"];
+	TextureResidencyControl::Request(&context->textureResidency, display, float(context->texDisplayRC.viewport.width));
+	DEBUG::RenderTexturedQuad(context, display);
 }
 
 void App::Release(AppContext *context)
 {
+	// Bakes still in progress are completed (and so cached), otherwise the next start would have to begin them again
+	IBLBakeSchedulerControl::Flush(&context->iblBakeScheduler);
+	TextureLoaderControl::Release(&context->textureLoader);
+	StartupProfileControl::Release(&context->startupProfile);
+	TextureResidencyControl::Release(&context->textureResidency);
+	IBLBakeSchedulerControl::Release(&context->iblBakeScheduler);
+	Graphics::Release(&context->iblBakeRC.framebuffer);
 	Graphics::Release(&context->sceneRC);
 	Graphics::Release(&context->shadowRC);
 	Graphics::Release(&context->texDisplayRC);
 
 	Graphics::Release(&context->screenQuadModel);
 	Graphics::Release(&context->skyBoxModel);
+	ClusterCullingControl::Release(&context->clusterCuller);
+	AssetPackControl::Close(&context->assetPack);
 
 	for (auto it : context->scene.textures)
 	{
 		Graphics::Release(&it.second);
 	}
 
-	for (auto it : context->scene.objects)
+	for (auto it : context->scene.uniformBuffers)
+	{
+		Graphics::Release(&it.second);
+	}
+
+	for (auto &it : context->scene.objects)
 	{
-		Graphics::Release(&it.second.model);
+		MeshRegistryControl::Release(&context->scene.meshes, it.second.model);
 	}
+	context->scene.objects.clear();
 
 	for (auto it : context->shaders)
 	{
@@ -11,6 +11,15 @@
 #include "Camera.h"
 #include "UtilMesh.h"
 #include "UserInput.h"
+#include "IBLBake.h"
+#include "IBLCache.h"
+#include "IBLBakeScheduler.h"
+#include "TextureLoader.h"
+#include "AssetPack.h"
+#include "TextureResidency.h"
+#include "StartupProfile.h"
+#include "MeshRegistry.h"
+#include "ClusterCulling.h"
 
 struct UserInput;
 
@@ -61,7 +70,9 @@ enum Shader
 	EquirectToCubemap,
 	EnvToIrradiance,
 	EnvToPrefilteredEnv,
-	EnvToIntegratedBRDF
+	EquirectToCubemapCompute,
+	EnvToIrradianceCompute,
+	EnvToPrefilteredEnvCompute
 };
 
 namespace PBRSamplers
@@ -72,12 +83,21 @@ namespace PBRSamplers
 		Metalness2D,
 		Roughness2D,
 		Normal2D,
+		ORM2D,				// Replaces Metalness2D and Roughness2D with ORM_TEXTURE
 		IntegratedBRDF2D,
 		IrradianceMapCube,
 		PrefilteredEnvMapCube
 	};
 }
 
+namespace PBRUniformBlocks
+{
+	enum UniformBlocks
+	{
+		SHIrradiance
+	};
+}
+
 namespace PhongSamplers
 {
 	enum TextureSamplers
@@ -88,14 +108,17 @@ namespace PhongSamplers
 
 struct SceneObject
 {
-	Model model;
+	Model *model = nullptr;				// Shared with the other objects that have the same mesh, see MeshRegistry
 	Texture *albedoTexture;
 	Texture *metalnessTexture;
 	Texture *roughnessTexture;
 	Texture *normalTexture;
+	Texture *ormTexture;
 
 	unsigned int materialIndex;
 	glm::mat4 modelMatrix;
+	float boundingRadius = 1.0f;		// In model space, sizes the object on screen for TextureResidency and the level of detail
+	unsigned int level = 0;				// Level of detail of the model, chosen by the scene pass of the last frame
 
 	SceneObject()
 	{
@@ -103,20 +126,41 @@ struct SceneObject
 		modelMatrix = glm::mat4();
 	}
 
-	SceneObject(Mesh mesh, Texture *albedoTex, Texture *metalnessTex, Texture *roughnessTex, Texture *normalTex,
+	SceneObject(Model *model, Texture *albedoTex, Texture *metalnessTex, Texture *roughnessTex, Texture *normalTex, Texture *ormTex,
 				unsigned int materialIndex, glm::mat4 modelMatrix = glm::mat4())
 	{
-		Graphics::InitModel(&this->model, mesh);
+		this->model = model;
 		this->albedoTexture = albedoTex;
 		this->metalnessTexture = metalnessTex;
 		this->roughnessTexture = roughnessTex;
 		this->normalTexture = normalTex;
+		this->ormTexture = ormTex;
 
 		this->materialIndex = materialIndex;
 		this->modelMatrix = modelMatrix;
 	}
 };
 
+// CPU work of LoadEnvironment done ahead of time by a startup job (see App::Init), used once by the next LoadEnvironment
+struct PreparedEnvironment
+{
+	bool valid = false;
+	uint64_t cacheKey = 0;				// For the IBL settings at the time it was prepared
+	TextureData hdrImage;				// No levels if the skybox did not have to be baked
+};
+
+// An HDR environment and its image based lighting textures. The textures are loaded (or baked) when the environment
+// is activated for the first time and released again when it is the least recently used one over the memory budget.
+struct Environment
+{
+	std::string hdrPath;
+	bool resident = false;
+	size_t memoryBytes = 0;				// GPU memory of the skybox, irradiance and prefiltered cubemaps (their Texture::memoryBytes)
+	unsigned int lastUse = 0;
+	uint64_t cacheKey = 0;				// IBL cache key of the baked textures, set by LoadEnvironment
+	PreparedEnvironment prepared;
+};
+
 struct SceneContext
 {
 	DirectionalLight directionalLight;
@@ -124,11 +168,22 @@ struct SceneContext
 	std::vector<PBRMaterial> PBRMaterials;
 	std::vector<PhongMaterial> PhongMaterials;
 	std::map<std::string, SceneObject> objects;
+	MeshRegistry meshes;				// Models of the objects
 	std::map<std::string, Texture> textures;
-
+	std::map<std::string, UniformBuffer> uniformBuffers;
+	std::vector<Environment> environments;
+	unsigned int environmentUseCounter = 0;
 	int activeEnvironment = 0;
 };
 
+// Geometry RenderScene submitted in the current frame, shadow and scene pass
+struct RenderStats
+{
+	unsigned int drawCount = 0;
+	unsigned int triangleCount = 0;				// After the cluster culling
+	unsigned int fullDetailTriangleCount = 0;	// Had every object been drawn whole at level 0
+};
+
 struct AppContext
 {
 	UserInput userInput;
@@ -150,11 +205,34 @@ struct AppContext
 	GLuint screenQuadProgram = 0;
 
 	Model skyBoxModel;
+
+	IBLQuality::Tier iblQualityTier = IBLQuality::Interactive;
+	IBLBakeSettings iblSettings;			// Settings of iblQualityTier
+	IBLCache iblCache;
+	IBLBakeScheduler iblBakeScheduler;
+	TextureLoader textureLoader;
+	std::string assetPackFile;				// As passed to App::Init
+	AssetPack assetPack;					// Mapped for the whole run, meshes and textures found in it are uploaded from it
+	TextureResidency textureResidency;		// Budget of every texture, streams the mips of the material textures
+	StartupProfile startupProfile;			// Phases of the last App::Init
+	RenderStats renderStats;
+	ClusterCuller clusterCuller;
+	RenderContext iblBakeRC;
+	bool progressiveIBLBake = true;			// Bake irradiance and prefiltered maps in time slices from App::Update instead of in Init
+	bool shIrradiance = true;		// Evaluate diffuse irradiance from SH coefficients instead of the irradiance cubemap
+	bool analyticEnvironmentBRDF = false;	// Fitted approximation of the split sum BRDF instead of the LUT fetch
+	bool layeredCubemapRendering = true;	// Render all cubemap faces with one instanced draw (per mip) instead of six
+	bool computeIBLBake = true;				// Bake IBL cubemaps with compute shaders (GL 4.3), the fragment shaders are the fallback
+	// Resident environments above this are released, least recently used first. Holds both environments of the
+	// interactive tier (about 18 MB each), at the production tier (about 70 MB each) every switch releases the other one
+	// and loads or bakes it again.
+	size_t environmentMemoryBudget = 48 * 1024 * 1024;
 };
 
 namespace App
 {
-	void Init(AppContext *context, unsigned int screenWidth, unsigned int screenHeight);
+	// assetPackFile: written by packassets (the build passes ASSET_PACK_FILE), optional
+	void Init(AppContext *context, unsigned int screenWidth, unsigned int screenHeight, const char *assetPackFile);
 	void Update(AppContext *context, double dt);
 	void Release(AppContext *context);
 }
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "AssetPack.h"
+#include "TextureFile.h"
+
+static const char ASSET_PACK_MAGIC[4] = { 'P', 'B', 'R', 'P' };
+static const uint32_t ASSET_PACK_VERSION = 4;
+
+static uint64_t AlignUp(uint64_t offset)
+{
+	return (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+}
+
+// Blobs of one asset in file order
+struct SourceBlob
+{
+	const void *data;
+	uint64_t size;
+};
+
+static std::vector<AssetPackMeshlet> PackMeshlets(const Mesh &mesh)
+{
+	std::vector<AssetPackMeshlet> packed(mesh.meshlets.size());
+	for (unsigned int i = 0; i < mesh.meshlets.size(); ++i)
+	{
+		const Meshlet &meshlet = mesh.meshlets[i];
+		packed[i].indexOffset = meshlet.indexOffset;
+		packed[i].indexCount = meshlet.indexCount;
+		packed[i].radius = meshlet.radius;
+		packed[i].coneCutoff = meshlet.coneCutoff;
+		for (unsigned int c = 0; c < 3; ++c)
+		{
+			packed[i].center[c] = meshlet.center[c];
+			packed[i].coneApex[c] = meshlet.coneApex[c];
+			packed[i].coneAxis[c] = meshlet.coneAxis[c];
+		}
+	}
+	return packed;
+}
+
+static Meshlet UnpackMeshlet(const AssetPackMeshlet &packed)
+{
+	Meshlet meshlet;
+	meshlet.indexOffset = packed.indexOffset;
+	meshlet.indexCount = packed.indexCount;
+	meshlet.center = glm::vec3(packed.center[0], packed.center[1], packed.center[2]);
+	meshlet.radius = packed.radius;
+	meshlet.coneApex = glm::vec3(packed.coneApex[0], packed.coneApex[1], packed.coneApex[2]);
+	meshlet.coneAxis = glm::vec3(packed.coneAxis[0], packed.coneAxis[1], packed.coneAxis[2]);
+	meshlet.coneCutoff = packed.coneCutoff;
+	return meshlet;
+}
+
+// meshlets: PackMeshlets of the asset's mesh
+static std::vector<SourceBlob> SourceBlobs(const AssetPackSource &asset, const std::vector<AssetPackMeshlet> &meshlets)
+{
+	std::vector<SourceBlob> blobs;
+	if (asset.type == AssetType::Mesh)
+	{
+		blobs.push_back({ asset.mesh.vertices, uint64_t(asset.mesh.vertexCount) * asset.mesh.vertexStride });
+		blobs.push_back({ asset.mesh.indices, uint64_t(asset.mesh.indexCount) * asset.mesh.indexStride });
+		if (!meshlets.empty())
+			blobs.push_back({ meshlets.data(), meshlets.size() * sizeof(AssetPackMeshlet) });
+	}
+	else
+	{
+		for (unsigned int i = 0; i < asset.texture.levels.size(); ++i)
+			blobs.push_back({ asset.texture.levels[i].data(), asset.texture.levels[i].size() });
+	}
+	return blobs;
+}
+
+static void WritePadding(std::ofstream &out, uint64_t *offset)
+{
+	static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+	uint64_t aligned = AlignUp(*offset);
+	out.write(zeros, std::streamsize(aligned - *offset));
+	*offset = aligned;
+}
+
+bool AssetPackControl::Write(const char *file, const std::vector<AssetPackSource> &assets)
+{
+	// Lay out everything first, the entry table comes right after the header
+	std::vector<AssetPackEntry> entries(assets.size());
+	std::vector<std::vector<AssetPackRange>> ranges(assets.size());
+	std::vector<std::vector<AssetPackMeshlet>> meshlets(assets.size());
+	uint64_t offset = AlignUp(sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry));
+	for (unsigned int i = 0; i < assets.size(); ++i)
+	{
+		const AssetPackSource &asset = assets[i];
+		AssetPackEntry *entry = &entries[i];
+		memset(entry, 0, sizeof(*entry));
+		if (asset.name.size() >= ASSET_PACK_MAX_NAME || asset.mesh.vertexAttributes.size() > ASSET_PACK_MAX_ATTRIBUTES ||
+			asset.mesh.levels.size() > ASSET_PACK_MAX_LEVELS)
+		{
+			std::cerr << "ERROR: Asset " << asset.name << " does not fit into a pack entry\n";
+			return false;
+		}
+		memcpy(entry->name, asset.name.c_str(), asset.name.size());
+		entry->type = asset.type;
+		if (asset.type == AssetType::Mesh)
+		{
+			entry->vertexCount = asset.mesh.vertexCount;
+			entry->vertexStride = uint32_t(asset.mesh.vertexStride);
+			entry->indexCount = asset.mesh.indexCount;
+			entry->indexStride = uint32_t(asset.mesh.indexStride);
+			entry->attributeCount = uint32_t(asset.mesh.vertexAttributes.size());
+			for (unsigned int a = 0; a < entry->attributeCount; ++a)
+			{
+				entry->attributeSizes[a] = asset.mesh.vertexAttributes[a].size;
+				entry->attributeTypes[a] = asset.mesh.vertexAttributes[a].type;
+				entry->attributeNormalizedMask |= asset.mesh.vertexAttributes[a].normalized ? 1u << a : 0u;
+			}
+			entry->positionScale = asset.mesh.positionScale;
+			entry->levelCount = uint32_t(asset.mesh.levels.size());
+			for (unsigned int l = 0; l < entry->levelCount; ++l)
+			{
+				entry->levelIndexCounts[l] = asset.mesh.levels[l].indexCount;
+				entry->levelErrors[l] = asset.mesh.levels[l].error;
+				entry->levelMeshletCounts[l] = asset.mesh.levels[l].meshletCount;
+			}
+			meshlets[i] = PackMeshlets(asset.mesh);
+			entry->meshletCount = uint32_t(meshlets[i].size());
+		}
+		else
+		{
+			entry->target = asset.texture.target;
+			entry->internalFormat = asset.texture.internalFormat;
+			entry->format = asset.texture.format;
+			entry->dataType = asset.texture.type;
+			entry->wrap = asset.texture.wrap;
+			entry->width = asset.texture.width;
+			entry->height = asset.texture.height;
+			entry->mipCount = asset.texture.mipCount;
+		}
+
+		std::vector<SourceBlob> blobs = SourceBlobs(asset, meshlets[i]);
+		entry->rangeCount = uint32_t(blobs.size());
+		entry->rangeTableOffset = offset;
+		offset = AlignUp(offset + blobs.size() * sizeof(AssetPackRange));
+		for (unsigned int b = 0; b < blobs.size(); ++b)
+		{
+			ranges[i].push_back({ offset, blobs[b].size });
+			offset = AlignUp(offset + blobs[b].size);
+		}
+	}
+
+	std::ofstream out(file, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR: Unable to open " << file << " for writing\n";
+		return false;
+	}
+
+	AssetPackHeader header;
+	memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = uint32_t(entries.size());
+	header.reserved = 0;
+	header.entryTableOffset = sizeof(AssetPackHeader);
+	out.write((const char *)&header, sizeof(header));
+	out.write((const char *)entries.data(), std::streamsize(entries.size() * sizeof(AssetPackEntry)));
+	offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+
+	for (unsigned int i = 0; i < assets.size(); ++i)
+	{
+		std::vector<SourceBlob> blobs = SourceBlobs(assets[i], meshlets[i]);
+		WritePadding(out, &offset);
+		out.write((const char *)ranges[i].data(), std::streamsize(ranges[i].size() * sizeof(AssetPackRange)));
+		offset += ranges[i].size() * sizeof(AssetPackRange);
+		for (unsigned int b = 0; b < blobs.size(); ++b)
+		{
+			WritePadding(out, &offset);
+			out.write((const char *)blobs[b].data, std::streamsize(blobs[b].size));
+			offset += blobs[b].size;
+		}
+	}
+	return out.good();
+}
+
+static bool InFile(const MappedFile &file, uint64_t offset, uint64_t size)
+{
+	return offset <= file.size && size <= file.size - offset;
+}
+
+static const AssetPackRange *Ranges(const AssetPack &pack, const AssetPackEntry &entry)
+{
+	return (const AssetPackRange *)(pack.file.data + entry.rangeTableOffset);
+}
+
+bool AssetPackControl::Open(AssetPack *pack, const char *file)
+{
+	*pack = AssetPack();
+	if (!IOUtil::MapFile(file, &pack->file))
+		return false;
+
+	const MappedFile &mapped = pack->file;
+	const AssetPackHeader *header = (const AssetPackHeader *)mapped.data;
+	bool valid = InFile(mapped, 0, sizeof(AssetPackHeader)) && memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(header->magic)) == 0 &&
+				 header->version == ASSET_PACK_VERSION &&
+				 InFile(mapped, header->entryTableOffset, uint64_t(header->entryCount) * sizeof(AssetPackEntry));
+	const AssetPackEntry *entries = valid ? (const AssetPackEntry *)(mapped.data + header->entryTableOffset) : nullptr;
+	for (uint32_t i = 0; valid && i < header->entryCount; ++i)
+	{
+		const AssetPackEntry &entry = entries[i];
+		valid = entry.type < AssetType::TypeCount && memchr(entry.name, 0, sizeof(entry.name)) != nullptr &&
+				entry.attributeCount <= ASSET_PACK_MAX_ATTRIBUTES &&
+				InFile(mapped, entry.rangeTableOffset, uint64_t(entry.rangeCount) * sizeof(AssetPackRange));
+		for (uint32_t r = 0; valid && r < entry.rangeCount; ++r)
+			valid = InFile(mapped, Ranges(*pack, entry)[r].offset, Ranges(*pack, entry)[r].size);
+		for (uint32_t a = 0; valid && a < entry.attributeCount; ++a)
+			valid = entry.attributeTypes[a] < VertexAttributeType::TypeCount;
+		uint64_t levelIndexCount = 0, levelMeshletCount = 0;
+		for (uint32_t l = 0; l < entry.levelCount && l < ASSET_PACK_MAX_LEVELS; ++l)
+		{
+			levelIndexCount += entry.levelIndexCounts[l];
+			levelMeshletCount += entry.levelMeshletCounts[l];
+		}
+		valid = valid && entry.levelCount <= ASSET_PACK_MAX_LEVELS && (entry.levelCount == 0 || levelIndexCount == entry.indexCount) &&
+				(entry.levelCount == 0 || entry.meshletCount == 0 || levelMeshletCount == entry.meshletCount);
+	}
+	if (!valid)
+	{
+		std::cerr << "ERROR: " << file << " is not a valid asset pack\n";
+		IOUtil::UnmapFile(&pack->file);
+		*pack = AssetPack();
+		return false;
+	}
+
+	pack->header = header;
+	pack->entries = entries;
+	return true;
+}
+
+bool AssetPackControl::IsOpen(const AssetPack &pack)
+{
+	return pack.header != nullptr;
+}
+
+const AssetPackEntry *AssetPackControl::Find(const AssetPack &pack, const char *name, AssetType::Type type)
+{
+	if (!pack.header)
+		return nullptr;
+	for (uint32_t i = 0; i < pack.header->entryCount; ++i)
+	{
+		if (pack.entries[i].type == uint32_t(type) && strcmp(pack.entries[i].name, name) == 0)
+			return &pack.entries[i];
+	}
+	return nullptr;
+}
+
+bool AssetPackControl::GetMesh(const AssetPack &pack, const char *name, Mesh *mesh)
+{
+	const AssetPackEntry *entry = Find(pack, name, AssetType::Mesh);
+	if (!entry || entry->rangeCount != (entry->meshletCount ? 3u : 2u))
+		return false;
+
+	const AssetPackRange *ranges = Ranges(pack, *entry);
+	if (ranges[0].size != uint64_t(entry->vertexCount) * entry->vertexStride || ranges[1].size != uint64_t(entry->indexCount) * entry->indexStride ||
+		(entry->meshletCount && ranges[2].size != uint64_t(entry->meshletCount) * sizeof(AssetPackMeshlet)))
+		return false;
+
+	*mesh = Mesh();
+	mesh->vertices = (void *)(pack.file.data + ranges[0].offset);
+	mesh->vertexCount = entry->vertexCount;
+	mesh->vertexStride = entry->vertexStride;
+	mesh->indices = (void *)(pack.file.data + ranges[1].offset);
+	mesh->indexCount = entry->indexCount;
+	mesh->indexStride = entry->indexStride;
+	for (uint32_t a = 0; a < entry->attributeCount; ++a)
+	{
+		mesh->vertexAttributes.push_back(VertexAttribute(entry->attributeSizes[a], VertexAttributeType::Type(entry->attributeTypes[a]),
+														 (entry->attributeNormalizedMask & (1u << a)) != 0));
+	}
+	mesh->positionScale = entry->positionScale;
+	unsigned int indexOffset = 0, meshletOffset = 0;
+	for (uint32_t l = 0; l < entry->levelCount; ++l)
+	{
+		MeshLevel level;
+		level.indexOffset = indexOffset;
+		level.indexCount = entry->levelIndexCounts[l];
+		level.error = entry->levelErrors[l];
+		level.meshletOffset = meshletOffset;
+		level.meshletCount = entry->levelMeshletCounts[l];
+		mesh->levels.push_back(level);
+		indexOffset += level.indexCount;
+		meshletOffset += level.meshletCount;
+	}
+	// Unpacked into Mesh::meshlets, the model keeps its own copy for the cluster culling anyway
+	const AssetPackMeshlet *meshlets = (const AssetPackMeshlet *)(pack.file.data + (entry->meshletCount ? ranges[2].offset : 0));
+	for (uint32_t m = 0; m < entry->meshletCount; ++m)
+	{
+		Meshlet meshlet = UnpackMeshlet(meshlets[m]);
+		if (uint64_t(meshlet.indexOffset) + meshlet.indexCount > entry->indexCount)
+		{
+			mesh->meshlets.clear();
+			return false;
+		}
+		mesh->meshlets.push_back(meshlet);
+	}
+	return true;
+}
+
+bool AssetPackControl::GetTexture(const AssetPack &pack, const char *name, TextureData *description, std::vector<TextureLevelView> *levels)
+{
+	const AssetPackEntry *entry = Find(pack, name, AssetType::Texture);
+	// Not Graphics::FaceCount, the tools link this without the GL code
+	unsigned int faceCount = entry && entry->target == TextureTarget::Cubemap ? 6 : 1;
+	if (!entry || entry->target > TextureTarget::Cubemap || entry->width == 0 || entry->height == 0 || entry->mipCount == 0 ||
+		entry->mipCount > 32 || entry->rangeCount != entry->mipCount * faceCount)
+		return false;
+
+	*description = TextureData();
+	description->target = TextureTarget(entry->target);
+	description->internalFormat = entry->internalFormat;
+	description->format = entry->format;
+	description->type = entry->dataType;
+	description->wrap = entry->wrap;
+	description->width = entry->width;
+	description->height = entry->height;
+	description->mipCount = entry->mipCount;
+
+	// Like TextureFile::Read, every level has to have its format's size, so that uploading it never reads past its range
+	const AssetPackRange *ranges = Ranges(pack, *entry);
+	for (uint32_t r = 0; r < entry->rangeCount; ++r)
+	{
+		if (ranges[r].size != TextureFile::ExpectedLevelSize(*description, r / faceCount))
+			return false;
+	}
+
+	levels->clear();
+	for (uint32_t r = 0; r < entry->rangeCount; ++r)
+	{
+		TextureLevelView level;
+		level.data = pack.file.data + ranges[r].offset;
+		level.size = size_t(ranges[r].size);
+		levels->push_back(level);
+	}
+	return true;
+}
+
+void AssetPackControl::Close(AssetPack *pack)
+{
+	if (pack->header)
+		IOUtil::UnmapFile(&pack->file);
+	*pack = AssetPack();
+}
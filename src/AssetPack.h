@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+#include "Graphics.h"
+#include "UtilMesh.h"
+#include "IOUtil.h"
+
+namespace AssetType
+{
+	enum Type
+	{
+		Mesh,			// Vertex and index buffers in Model layout
+		Texture,		// Every level of every face in its final internal format (compressed or not), see TextureData
+		TypeCount
+	};
+}
+
+// On-disk layout: the header, the entry table and then the blobs, each one aligned to ASSET_PACK_ALIGNMENT
+static const uint64_t ASSET_PACK_ALIGNMENT = 64;
+static const unsigned int ASSET_PACK_MAX_NAME = 64;
+static const unsigned int ASSET_PACK_MAX_ATTRIBUTES = 8;
+static const unsigned int ASSET_PACK_MAX_LEVELS = 8;
+
+struct AssetPackHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t entryTableOffset;
+};
+
+// Byte range of one blob, relative to the start of the pack
+struct AssetPackRange
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct AssetPackEntry
+{
+	char name[ASSET_PACK_MAX_NAME];		// Null terminated
+	uint32_t type;
+	// Mesh
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	uint32_t indexStride;
+	uint32_t attributeCount;
+	uint32_t attributeSizes[ASSET_PACK_MAX_ATTRIBUTES];
+	uint32_t attributeTypes[ASSET_PACK_MAX_ATTRIBUTES];		// VertexAttributeType
+	uint32_t attributeNormalizedMask;						// Bit a: attribute a is normalized
+	float positionScale;
+	uint32_t levelCount;									// Levels of detail one after the other in the indices, 0 without
+	uint32_t levelIndexCounts[ASSET_PACK_MAX_LEVELS];
+	float levelErrors[ASSET_PACK_MAX_LEVELS];
+	uint32_t levelMeshletCounts[ASSET_PACK_MAX_LEVELS];		// Meshlets of the levels one after the other
+	uint32_t meshletCount;									// AssetPackMeshlets in the third range, 0 without
+	// Texture, the fields of TextureData
+	uint32_t target;
+	uint32_t internalFormat;
+	uint32_t format;
+	uint32_t dataType;
+	uint32_t wrap;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+	// Table of rangeCount AssetPackRanges: the vertices, the indices and the meshlets (if any) of a mesh, the levels of
+	// a texture
+	uint32_t rangeCount;
+	uint32_t reserved;
+	uint64_t rangeTableOffset;
+};
+
+// A Meshlet field by field
+struct AssetPackMeshlet
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float center[3];
+	float radius;
+	float coneApex[3];
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+// Input of the writer, the pack only references these
+struct AssetPackSource
+{
+	std::string name;
+	AssetType::Type type = AssetType::Mesh;
+	Mesh mesh;
+	TextureData texture;
+};
+
+// A read only memory mapping of a pack. The meshes and textures returned by GetMesh and GetTexture point into the
+// mapped pages, so they can be uploaded without copying them first and stay valid until the pack is closed.
+struct AssetPack
+{
+	MappedFile file;
+	const AssetPackHeader *header = nullptr;
+	const AssetPackEntry *entries = nullptr;
+};
+
+namespace AssetPackControl
+{
+	bool Write(const char *file, const std::vector<AssetPackSource> &assets);
+
+	// Maps the pack and checks that every range lies within the file
+	bool Open(AssetPack *pack, const char *file);
+	bool IsOpen(const AssetPack &pack);
+	const AssetPackEntry *Find(const AssetPack &pack, const char *name, AssetType::Type type);
+	// Upload with Graphics::InitModel(model, mesh, false)
+	bool GetMesh(const AssetPack &pack, const char *name, Mesh *mesh);
+	// Upload with Graphics::InitTexture(texture, description, levels), description has no levels of its own
+	bool GetTexture(const AssetPack &pack, const char *name, TextureData *description, std::vector<TextureLevelView> *levels);
+	void Close(AssetPack *pack);
+}
@@ -0,0 +1,727 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Graphics.h"
+#include "IOUtil.h"
+#include "Parallel.h"
+#include "TextureFile.h"
+#include "BlockCompression.h"
+
+static const unsigned int BLOCK_TEXELS = 16;
+// BC7 interpolation weights of 4 bit indices, out of 64
+static const unsigned int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+// Most least squares fits of the BC4 endpoints to their indices per mode, stops early once a fit does not lower the error
+static const unsigned int BC4_REFINE_ITERATIONS = 4;
+// Block rows of a level below this are encoded on the calling thread only
+static const unsigned int MIN_PARALLEL_BLOCK_ROWS = 16;
+
+// A 4x4 block as RGBA floats, channels missing in the source are 0 (alpha 255) like GL samples them
+struct Block
+{
+	float texels[BLOCK_TEXELS][4];
+};
+
+static unsigned int ChannelCount(GLenum format)
+{
+	switch (format)
+	{
+		case GL_RED: return 1;
+		case GL_RG: return 2;
+		case GL_RGB: return 3;
+		case GL_RGBA: return 4;
+	}
+	return 0;
+}
+
+static GLenum DecodedFormat(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return GL_RGB;
+		case GL_COMPRESSED_RED_RGTC1: return GL_RED;
+		case GL_COMPRESSED_RG_RGTC2: return GL_RG;
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: return GL_RGBA;
+	}
+	return 0;
+}
+
+// Texels past the edge of levels smaller than a block repeat the last row and column
+static void FetchBlock(const uint8_t *level, unsigned int width, unsigned int height, unsigned int channelCount,
+					   unsigned int blockX, unsigned int blockY, Block *block)
+{
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		unsigned int x = std::min(4 * blockX + i % 4, width - 1);
+		unsigned int y = std::min(4 * blockY + i / 4, height - 1);
+		const uint8_t *texel = level + (size_t(y) * width + x) * channelCount;
+		for (unsigned int c = 0; c < 4; ++c)
+			block->texels[i][c] = c < channelCount ? float(texel[c]) : c == 3 ? 255.0f : 0.0f;
+	}
+}
+
+// Writes count bits of value at the bit position, least significant bit first
+static void WriteBits(uint8_t *data, unsigned int *position, uint32_t value, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i, ++*position)
+	{
+		if (value & (1u << i))
+			data[*position / 8] |= uint8_t(1u << (*position % 8));
+	}
+}
+
+static uint32_t ReadBits(const uint8_t *data, unsigned int *position, unsigned int count)
+{
+	uint32_t value = 0;
+	for (unsigned int i = 0; i < count; ++i, ++*position)
+		value |= uint32_t((data[*position / 8] >> (*position % 8)) & 1) << i;
+	return value;
+}
+
+// Principal axis of the block's colors by power iteration on their covariance
+static void PrincipalAxis(const Block &block, unsigned int channelCount, float mean[4], float axis[4])
+{
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		mean[c] = 0.0f;
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			mean[c] += block.texels[i][c] / float(BLOCK_TEXELS);
+	}
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		for (unsigned int a = 0; a < channelCount; ++a)
+		{
+			for (unsigned int b = 0; b < channelCount; ++b)
+				covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+		}
+	}
+	for (unsigned int c = 0; c < 4; ++c)
+		axis[c] = c < channelCount ? 1.0f : 0.0f;
+	for (unsigned int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (unsigned int a = 0; a < channelCount; ++a)
+		{
+			for (unsigned int b = 0; b < channelCount; ++b)
+				next[a] += covariance[a][b] * axis[b];
+			length += next[a] * next[a];
+		}
+		if (length < 1e-12f)
+			break;
+		length = sqrtf(length);
+		for (unsigned int c = 0; c < channelCount; ++c)
+			axis[c] = next[c] / length;
+	}
+}
+
+// Endpoints at the extreme projections of the block onto its principal axis
+static void FitEndpoints(const Block &block, unsigned int channelCount, float endpoint0[4], float endpoint1[4])
+{
+	float mean[4], axis[4];
+	PrincipalAxis(block, channelCount, mean, axis);
+	float minT = 0.0f, maxT = 0.0f;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		float t = 0.0f;
+		for (unsigned int c = 0; c < channelCount; ++c)
+			t += (block.texels[i][c] - mean[c]) * axis[c];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		endpoint0[c] = std::min(std::max(mean[c] + minT * axis[c], 0.0f), 255.0f);
+		endpoint1[c] = std::min(std::max(mean[c] + maxT * axis[c], 0.0f), 255.0f);
+	}
+}
+
+// Least squares endpoints for texels interpolated with the given weights (0 = endpoint0, 1 = endpoint1), returns
+// false if the weights do not determine both endpoints
+static bool RefineEndpoints(const Block &block, unsigned int channelCount, const float weights[BLOCK_TEXELS], float endpoint0[4], float endpoint1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		float a = 1.0f - weights[i], b = weights[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (unsigned int c = 0; c < channelCount; ++c)
+		{
+			ax[c] += a * block.texels[i][c];
+			bx[c] += b * block.texels[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+	for (unsigned int c = 0; c < channelCount; ++c)
+	{
+		endpoint0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+		endpoint1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static float Distance(const float *a, const float *b, unsigned int channelCount)
+{
+	float distance = 0.0f;
+	for (unsigned int c = 0; c < channelCount; ++c)
+		distance += (a[c] - b[c]) * (a[c] - b[c]);
+	return distance;
+}
+
+// Picks the nearest palette entry for every texel, returns the total squared error
+static float ChooseIndices(const Block &block, unsigned int channelCount, const float palette[][4], unsigned int paletteSize,
+						   unsigned int indices[BLOCK_TEXELS])
+{
+	float totalError = 0.0f;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		float bestError = 1e30f;
+		for (unsigned int p = 0; p < paletteSize; ++p)
+		{
+			float error = Distance(block.texels[i], palette[p], channelCount);
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+//------------------------
+// BC4 (and BC5, which is two BC4 blocks)
+//------------------------
+static void BC4Palette(unsigned int red0, unsigned int red1, float palette[8])
+{
+	palette[0] = float(red0);
+	palette[1] = float(red1);
+	if (red0 > red1)
+	{
+		for (unsigned int i = 2; i < 8; ++i)
+			palette[i] = float((8 - i) * red0 + (i - 1) * red1) / 7.0f;
+	}
+	else
+	{
+		for (unsigned int i = 2; i < 6; ++i)
+			palette[i] = float((6 - i) * red0 + (i - 1) * red1) / 5.0f;
+		palette[6] = 0.0f;
+		palette[7] = 255.0f;
+	}
+}
+
+// Returns the squared error of the block for the given endpoints
+static float ChooseBC4Indices(const Block &block, unsigned int channel, unsigned int red0, unsigned int red1, unsigned int indices[BLOCK_TEXELS])
+{
+	float palette[8];
+	BC4Palette(red0, red1, palette);
+	float totalError = 0.0f;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		float bestError = 1e30f;
+		for (unsigned int p = 0; p < 8; ++p)
+		{
+			float error = (block.texels[i][channel] - palette[p]) * (block.texels[i][channel] - palette[p]);
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Least squares endpoints for the palette entries the indices select (see BC4Palette), the texels on the constant 0
+// and 255 entries of the 6 value mode do not depend on them. Returns false if the indices do not determine both.
+static bool RefineBC4Endpoints(const Block &block, unsigned int channel, bool sixValues, const unsigned int indices[BLOCK_TEXELS],
+							   float *red0, float *red1)
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax = 0.0f, bx = 0.0f;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		if (sixValues && indices[i] >= 6)
+			continue;
+		float b = indices[i] == 0 ? 0.0f : indices[i] == 1 ? 1.0f : float(indices[i] - 1) / (sixValues ? 5.0f : 7.0f);
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		ax += a * block.texels[i][channel];
+		bx += b * block.texels[i][channel];
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+	*red0 = std::min(std::max((ax * bb - bx * ab) / determinant, 0.0f), 255.0f);
+	*red1 = std::min(std::max((bx * aa - ax * ab) / determinant, 0.0f), 255.0f);
+	return true;
+}
+
+// Moves the endpoints of one mode to the least squares fit of their indices while that lowers the error. The mode
+// follows from the order of the endpoints, fits that would flip it are not taken.
+static void RefineBC4(const Block &block, unsigned int channel, unsigned int *red0, unsigned int *red1, unsigned int indices[BLOCK_TEXELS],
+					  float *error)
+{
+	bool sixValues = *red0 <= *red1;
+	for (unsigned int iteration = 0; iteration < BC4_REFINE_ITERATIONS; ++iteration)
+	{
+		float fitRed0, fitRed1;
+		if (!RefineBC4Endpoints(block, channel, sixValues, indices, &fitRed0, &fitRed1))
+			return;
+		unsigned int refinedRed0 = unsigned(fitRed0 + 0.5f), refinedRed1 = unsigned(fitRed1 + 0.5f);
+		if ((refinedRed0 <= refinedRed1) != sixValues || (refinedRed0 == *red0 && refinedRed1 == *red1))
+			return;
+		unsigned int refinedIndices[BLOCK_TEXELS];
+		float refinedError = ChooseBC4Indices(block, channel, refinedRed0, refinedRed1, refinedIndices);
+		if (refinedError >= *error)
+			return;
+		*red0 = refinedRed0;
+		*red1 = refinedRed1;
+		std::copy(refinedIndices, refinedIndices + BLOCK_TEXELS, indices);
+		*error = refinedError;
+	}
+}
+
+// Tries the 8 value mode over the whole range and the 6 value mode over the range without the 0 and 255 texels,
+// which that mode has as extra palette entries, refines both and keeps the better one
+static void EncodeBC4(const Block &block, unsigned int channel, uint8_t *output)
+{
+	float minValue = 255.0f, maxValue = 0.0f, innerMin = 255.0f, innerMax = 0.0f;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		float value = block.texels[i][channel];
+		minValue = std::min(minValue, value);
+		maxValue = std::max(maxValue, value);
+		if (value > 0.0f && value < 255.0f)
+		{
+			innerMin = std::min(innerMin, value);
+			innerMax = std::max(innerMax, value);
+		}
+	}
+	// The 8 value mode needs red0 > red1, equal endpoints select every texel with index 0 anyway
+	unsigned int red0 = unsigned(maxValue + 0.5f), red1 = unsigned(minValue + 0.5f);
+	unsigned int indices[BLOCK_TEXELS];
+	float error = ChooseBC4Indices(block, channel, red0, red1, indices);
+	if (red0 > red1)
+		RefineBC4(block, channel, &red0, &red1, indices, &error);
+	if (innerMin <= innerMax && error > 0.0f)
+	{
+		unsigned int innerRed0 = unsigned(innerMin + 0.5f), innerRed1 = unsigned(innerMax + 0.5f);
+		unsigned int innerIndices[BLOCK_TEXELS];
+		float innerError = ChooseBC4Indices(block, channel, innerRed0, innerRed1, innerIndices);
+		RefineBC4(block, channel, &innerRed0, &innerRed1, innerIndices, &innerError);
+		if (innerError < error)
+		{
+			red0 = innerRed0;
+			red1 = innerRed1;
+			std::copy(innerIndices, innerIndices + BLOCK_TEXELS, indices);
+		}
+	}
+
+	memset(output, 0, 8);
+	output[0] = uint8_t(red0);
+	output[1] = uint8_t(red1);
+	unsigned int position = 16;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		WriteBits(output, &position, indices[i], 3);
+}
+
+static void DecodeBC4(const uint8_t *input, uint8_t *texels, unsigned int stride)
+{
+	float palette[8];
+	BC4Palette(input[0], input[1], palette);
+	unsigned int position = 16;
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		texels[i * stride] = uint8_t(palette[ReadBits(input, &position, 3)] + 0.5f);
+}
+
+//------------------------
+// BC1
+//------------------------
+static uint16_t PackRGB565(const float color[4])
+{
+	unsigned int r = unsigned(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = unsigned(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = unsigned(color[2] * 31.0f / 255.0f + 0.5f);
+	return uint16_t(r << 11 | g << 5 | b);
+}
+
+static void UnpackRGB565(uint16_t packed, float color[4])
+{
+	unsigned int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = float(r << 3 | r >> 2);
+	color[1] = float(g << 2 | g >> 4);
+	color[2] = float(b << 3 | b >> 2);
+	color[3] = 255.0f;
+}
+
+static void BC1Palette(uint16_t color0, uint16_t color1, float palette[4][4])
+{
+	UnpackRGB565(color0, palette[0]);
+	UnpackRGB565(color1, palette[1]);
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		else
+		{
+			// Three colors and transparent black
+			palette[2][c] = 0.5f * (palette[0][c] + palette[1][c]);
+			palette[3][c] = 0.0f;
+		}
+	}
+}
+
+// Opaque four color mode only, which needs color0 > color1
+static float EncodeBC1Endpoints(const Block &block, const float endpoint0[4], const float endpoint1[4], uint16_t *color0, uint16_t *color1,
+								unsigned int indices[BLOCK_TEXELS])
+{
+	*color0 = PackRGB565(endpoint1);
+	*color1 = PackRGB565(endpoint0);
+	if (*color0 < *color1)
+		std::swap(*color0, *color1);
+	if (*color0 == *color1)
+	{
+		std::fill(indices, indices + BLOCK_TEXELS, 0u);
+		float palette[4][4];
+		BC1Palette(*color0, *color1, palette);
+		float error = 0.0f;
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			error += Distance(block.texels[i], palette[0], 3);
+		return error;
+	}
+	float palette[4][4];
+	BC1Palette(*color0, *color1, palette);
+	return ChooseIndices(block, 3, palette, 4, indices);
+}
+
+static void EncodeBC1(const Block &block, uint8_t *output)
+{
+	float endpoint0[4], endpoint1[4];
+	FitEndpoints(block, 3, endpoint0, endpoint1);
+	uint16_t color0, color1;
+	unsigned int indices[BLOCK_TEXELS];
+	float error = EncodeBC1Endpoints(block, endpoint0, endpoint1, &color0, &color1, indices);
+
+	// Palette entries 0, 2, 3, 1 lie at 0, 1/3, 2/3, 1 from color0 to color1
+	const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float texelWeights[BLOCK_TEXELS];
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		texelWeights[i] = weights[indices[i]];
+	float palette[4][4];
+	BC1Palette(color0, color1, palette);
+	if (RefineEndpoints(block, 3, texelWeights, palette[0], palette[1]))
+	{
+		uint16_t refinedColor0, refinedColor1;
+		unsigned int refinedIndices[BLOCK_TEXELS];
+		float refinedError = EncodeBC1Endpoints(block, palette[0], palette[1], &refinedColor0, &refinedColor1, refinedIndices);
+		if (refinedError < error)
+		{
+			color0 = refinedColor0;
+			color1 = refinedColor1;
+			std::copy(refinedIndices, refinedIndices + BLOCK_TEXELS, indices);
+		}
+	}
+
+	memset(output, 0, 8);
+	unsigned int position = 0;
+	WriteBits(output, &position, color0, 16);
+	WriteBits(output, &position, color1, 16);
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		WriteBits(output, &position, indices[i], 2);
+}
+
+static void DecodeBC1(const uint8_t *input, uint8_t *texels)
+{
+	unsigned int position = 0;
+	uint16_t color0 = uint16_t(ReadBits(input, &position, 16));
+	uint16_t color1 = uint16_t(ReadBits(input, &position, 16));
+	float palette[4][4];
+	BC1Palette(color0, color1, palette);
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		unsigned int index = ReadBits(input, &position, 2);
+		for (unsigned int c = 0; c < 3; ++c)
+			texels[3 * i + c] = uint8_t(palette[index][c] + 0.5f);
+	}
+}
+
+//------------------------
+// BC7 mode 6
+//------------------------
+struct BC7Endpoints
+{
+	unsigned int values[2][4];		// 7 bits per channel
+	unsigned int pBits[2];
+};
+
+// The shared p-bit is the lowest bit of all four channels, each endpoint takes the one with the smaller error
+static void QuantizeBC7Endpoint(const float endpoint[4], unsigned int values[4], unsigned int *pBit)
+{
+	float bestError = 1e30f;
+	for (unsigned int p = 0; p < 2; ++p)
+	{
+		unsigned int candidate[4];
+		float error = 0.0f;
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			int quantized = int(floorf((endpoint[c] - float(p)) / 2.0f + 0.5f));
+			candidate[c] = unsigned(std::min(std::max(quantized, 0), 127));
+			float value = float(candidate[c] << 1 | p);
+			error += (value - endpoint[c]) * (value - endpoint[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			std::copy(candidate, candidate + 4, values);
+			*pBit = p;
+		}
+	}
+}
+
+static void BC7Palette(const BC7Endpoints &endpoints, float palette[16][4])
+{
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			unsigned int value0 = endpoints.values[0][c] << 1 | endpoints.pBits[0];
+			unsigned int value1 = endpoints.values[1][c] << 1 | endpoints.pBits[1];
+			palette[i][c] = float(((64 - BC7_WEIGHTS[i]) * value0 + BC7_WEIGHTS[i] * value1 + 32) >> 6);
+		}
+	}
+}
+
+static float EncodeBC7Endpoints(const Block &block, const float endpoint0[4], const float endpoint1[4], BC7Endpoints *endpoints,
+								unsigned int indices[BLOCK_TEXELS])
+{
+	QuantizeBC7Endpoint(endpoint0, endpoints->values[0], &endpoints->pBits[0]);
+	QuantizeBC7Endpoint(endpoint1, endpoints->values[1], &endpoints->pBits[1]);
+	float palette[16][4];
+	BC7Palette(*endpoints, palette);
+	return ChooseIndices(block, 4, palette, 16, indices);
+}
+
+static void EncodeBC7(const Block &block, uint8_t *output)
+{
+	float endpoint0[4], endpoint1[4];
+	FitEndpoints(block, 4, endpoint0, endpoint1);
+	BC7Endpoints endpoints;
+	unsigned int indices[BLOCK_TEXELS];
+	float error = EncodeBC7Endpoints(block, endpoint0, endpoint1, &endpoints, indices);
+
+	float texelWeights[BLOCK_TEXELS];
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		texelWeights[i] = float(BC7_WEIGHTS[indices[i]]) / 64.0f;
+	if (RefineEndpoints(block, 4, texelWeights, endpoint0, endpoint1))
+	{
+		BC7Endpoints refinedEndpoints;
+		unsigned int refinedIndices[BLOCK_TEXELS];
+		float refinedError = EncodeBC7Endpoints(block, endpoint0, endpoint1, &refinedEndpoints, refinedIndices);
+		if (refinedError < error)
+		{
+			endpoints = refinedEndpoints;
+			std::copy(refinedIndices, refinedIndices + BLOCK_TEXELS, indices);
+		}
+	}
+
+	// The most significant bit of the first index is implicitly 0
+	if (indices[0] & 8)
+	{
+		std::swap(endpoints.values[0], endpoints.values[1]);
+		std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(output, 0, 16);
+	unsigned int position = 0;
+	WriteBits(output, &position, 1 << 6, 7);
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		WriteBits(output, &position, endpoints.values[0][c], 7);
+		WriteBits(output, &position, endpoints.values[1][c], 7);
+	}
+	WriteBits(output, &position, endpoints.pBits[0], 1);
+	WriteBits(output, &position, endpoints.pBits[1], 1);
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		WriteBits(output, &position, indices[i], i == 0 ? 3 : 4);
+}
+
+// Blocks in other modes (not written by EncodeBC7) decode to magenta
+static void DecodeBC7(const uint8_t *input, uint8_t *texels)
+{
+	if ((input[0] & 0x7f) != 1 << 6)
+	{
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			texels[4 * i + 0] = texels[4 * i + 2] = texels[4 * i + 3] = 255;
+			texels[4 * i + 1] = 0;
+		}
+		return;
+	}
+
+	unsigned int position = 7;
+	BC7Endpoints endpoints;
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		endpoints.values[0][c] = ReadBits(input, &position, 7);
+		endpoints.values[1][c] = ReadBits(input, &position, 7);
+	}
+	endpoints.pBits[0] = ReadBits(input, &position, 1);
+	endpoints.pBits[1] = ReadBits(input, &position, 1);
+	float palette[16][4];
+	BC7Palette(endpoints, palette);
+	for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		unsigned int index = ReadBits(input, &position, i == 0 ? 3 : 4);
+		for (unsigned int c = 0; c < 4; ++c)
+			texels[4 * i + c] = uint8_t(palette[index][c]);
+	}
+}
+
+GLenum BlockCompression::InternalFormat(BlockFormat::Type format)
+{
+	switch (format)
+	{
+		case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default: return 0;
+	}
+}
+
+bool BlockCompression::IsCompressedFormat(GLenum internalFormat)
+{
+	return DecodedFormat(internalFormat) != 0;
+}
+
+unsigned int BlockCompression::BlockBytes(GLenum internalFormat)
+{
+	return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+}
+
+bool BlockCompression::Compress(const TextureData &data, BlockFormat::Type format, TextureData *compressed, unsigned int threadCount)
+{
+	unsigned int channelCount = ChannelCount(data.format);
+	if (data.target != TextureTarget::Texture2D || data.type != GL_UNSIGNED_BYTE || channelCount == 0 || format == BlockFormat::None ||
+		format >= BlockFormat::FormatCount)
+	{
+		std::cerr << "ERROR: Only 8 bit 2D textures can be block compressed\n";
+		return false;
+	}
+
+	*compressed = data;
+	compressed->internalFormat = BlockCompression::InternalFormat(format);
+	compressed->format = DecodedFormat(compressed->internalFormat);
+	unsigned int blockBytes = BlockCompression::BlockBytes(compressed->internalFormat);
+	for (unsigned int mip = 0; mip < data.mipCount; ++mip)
+	{
+		unsigned int width = std::max(data.width >> mip, 1u);
+		unsigned int height = std::max(data.height >> mip, 1u);
+		unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		const uint8_t *level = data.levels[mip].data();
+		std::vector<uint8_t> &output = compressed->levels[mip];
+		output.assign(size_t(blocksX) * blocksY * blockBytes, 0);
+		Parallel::For(blocksY, [&](unsigned int begin, unsigned int end)
+		{
+			Block block;
+			for (unsigned int blockY = begin; blockY < end; ++blockY)
+			{
+				for (unsigned int blockX = 0; blockX < blocksX; ++blockX)
+				{
+					FetchBlock(level, width, height, channelCount, blockX, blockY, &block);
+					uint8_t *blockOutput = output.data() + (size_t(blockY) * blocksX + blockX) * blockBytes;
+					switch (format)
+					{
+						case BlockFormat::BC1: EncodeBC1(block, blockOutput); break;
+						case BlockFormat::BC4: EncodeBC4(block, 0, blockOutput); break;
+						case BlockFormat::BC5: EncodeBC4(block, 0, blockOutput); EncodeBC4(block, 1, blockOutput + 8); break;
+						case BlockFormat::BC7: EncodeBC7(block, blockOutput); break;
+						default: break;
+					}
+				}
+			}
+		}, blocksY >= MIN_PARALLEL_BLOCK_ROWS ? threadCount : 1);
+	}
+	return true;
+}
+
+bool BlockCompression::Decompress(const TextureData &compressed, TextureData *data)
+{
+	GLenum format = DecodedFormat(compressed.internalFormat);
+	if (format == 0)
+		return false;
+
+	unsigned int channelCount = ChannelCount(format);
+	unsigned int blockBytes = BlockCompression::BlockBytes(compressed.internalFormat);
+	*data = compressed;
+	data->internalFormat = data->format = format;
+	data->type = GL_UNSIGNED_BYTE;
+	for (unsigned int mip = 0; mip < compressed.mipCount; ++mip)
+	{
+		unsigned int width = std::max(compressed.width >> mip, 1u);
+		unsigned int height = std::max(compressed.height >> mip, 1u);
+		unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		std::vector<uint8_t> &level = data->levels[mip];
+		level.assign(size_t(width) * height * channelCount, 0);
+		for (unsigned int blockY = 0; blockY < blocksY; ++blockY)
+		{
+			for (unsigned int blockX = 0; blockX < blocksX; ++blockX)
+			{
+				const uint8_t *input = compressed.levels[mip].data() + (size_t(blockY) * blocksX + blockX) * blockBytes;
+				uint8_t texels[BLOCK_TEXELS * 4];
+				switch (compressed.internalFormat)
+				{
+					case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: DecodeBC1(input, texels); break;
+					case GL_COMPRESSED_RED_RGTC1: DecodeBC4(input, texels, 1); break;
+					case GL_COMPRESSED_RG_RGTC2: DecodeBC4(input, texels, 2); DecodeBC4(input + 8, texels + 1, 2); break;
+					case GL_COMPRESSED_RGBA_BPTC_UNORM: DecodeBC7(input, texels); break;
+				}
+				for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					unsigned int x = 4 * blockX + i % 4, y = 4 * blockY + i / 4;
+					if (x < width && y < height)
+						memcpy(level.data() + (size_t(y) * width + x) * channelCount, texels + i * channelCount, channelCount);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+std::string BlockCompression::CookedFile(const char *sourceFile, const MipChainSettings &settings, BlockFormat::Type format)
+{
+	std::string mipChainFile = MipChain::CookedFile(sourceFile, settings);
+	return mipChainFile.substr(0, mipChainFile.size() - strlen(".tex")) + "." + BlockCompression::FormatName(format) + ".tex";
+}
+
+bool BlockCompression::LoadCooked(const char *sourceFile, const MipChainSettings &settings, BlockFormat::Type format, TextureData *data)
+{
+	std::string cookedFile = BlockCompression::CookedFile(sourceFile, settings, format);
+	time_t sourceTime = 0, cookedTime = 0;
+	return IOUtil::FileExists(cookedFile.c_str()) && IOUtil::GetFileModificationTime(cookedFile.c_str(), &cookedTime) &&
+		   IOUtil::GetFileModificationTime(sourceFile, &sourceTime) && cookedTime >= sourceTime &&
+		   TextureFile::Read(cookedFile.c_str(), data) && data->internalFormat == BlockCompression::InternalFormat(format);
+}
+
+const char *BlockCompression::FormatName(BlockFormat::Type format)
+{
+	const char *names[] = { "none", "bc1", "bc4", "bc5", "bc7" };
+	return format < BlockFormat::FormatCount ? names[format] : "unknown";
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include <glad/glad.h>
+
+#include "MipChain.h"
+
+// S3TC is an extension, the glad profile only has the core formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+struct TextureData;
+
+namespace BlockFormat
+{
+	enum Type
+	{
+		None,
+		BC1,		// RGB, 4 bits per texel, for albedo when the size matters more than the quality
+		BC4,		// One channel, 4 bits per texel, for metalness and roughness
+		BC5,		// Two channels, 8 bits per texel, for the XY of normal maps (Z has to be reconstructed)
+		BC7,		// RGBA, 8 bits per texel, for albedo
+		FormatCount
+	};
+}
+
+// CPU encoders (and decoders, for measuring the error) for the block compressed formats of the material textures.
+// Every mip level is compressed from the uncompressed chain built by MipChain, blocks are encoded in parallel. BC1
+// and BC7 fit their endpoints along the principal axis of the block's colors and refine them by least squares,
+// BC7 only uses mode 6 (one subset, 7777.1 endpoints, 4 bit indices).
+namespace BlockCompression
+{
+	GLenum InternalFormat(BlockFormat::Type format);
+	bool IsCompressedFormat(GLenum internalFormat);
+	// Bytes of one 4x4 block
+	unsigned int BlockBytes(GLenum internalFormat);
+
+	// Compresses every level of an 8 bit 2D texture
+	bool Compress(const TextureData &data, BlockFormat::Type format, TextureData *compressed, unsigned int threadCount = 0);
+	// Decodes every level to 8 bits per channel in the format's channels (GL_RGB for BC1, GL_RED, GL_RG, GL_RGBA)
+	bool Decompress(const TextureData &compressed, TextureData *data);
+
+	// e.g. metallic.png.kaiser_linear_repeat.bc4.tex, written by the cooktex tool
+	std::string CookedFile(const char *sourceFile, const MipChainSettings &settings, BlockFormat::Type format);
+	// Reads the cooked file if it exists and is at least as new as the source image
+	bool LoadCooked(const char *sourceFile, const MipChainSettings &settings, BlockFormat::Type format, TextureData *data);
+	const char *FormatName(BlockFormat::Type format);
+}
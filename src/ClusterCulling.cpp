@@ -0,0 +1,113 @@
+#include <cstring>
+#include <algorithm>
+
+#include <glm/gtc/matrix_access.hpp>
+
+#include "ClusterCulling.h"
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+// Both passes of the sphere grid at full detail (2.3 MB each with 16 bit indices) fit without orphaning
+static const size_t INITIAL_CAPACITY = 8 * 1024 * 1024;
+// Start of every draw in the compacted buffer, a multiple of every index size
+static const size_t DRAW_ALIGNMENT = 4;
+
+void ClusterCullingControl::Init(ClusterCuller *culler)
+{
+	glGenBuffers(1, &culler->indexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, culler->indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_CAPACITY, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	culler->capacity = INITIAL_CAPACITY;
+	culler->used = 0;
+}
+
+void ClusterCullingControl::ResetStats(ClusterCuller *culler)
+{
+	culler->stats = ClusterCullingStats();
+}
+
+// Copies the compacted indices into the buffer, returns their byte offset
+static size_t Upload(ClusterCuller *culler)
+{
+	size_t size = culler->compacted.size();
+	size_t offset = (culler->used + DRAW_ALIGNMENT - 1) / DRAW_ALIGNMENT * DRAW_ALIGNMENT;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, culler->indexBuffer);
+	if (offset + size > culler->capacity)
+	{
+		// Orphan the buffer, the draws still reading the old storage keep it
+		culler->capacity = std::max(culler->capacity, size);
+		glBufferData(GL_COPY_WRITE_BUFFER, culler->capacity, nullptr, GL_STREAM_DRAW);
+		offset = 0;
+	}
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, culler->compacted.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	culler->used = offset + size;
+	return offset;
+}
+
+GLuint ClusterCullingControl::RenderModel(ClusterCuller *culler, Model *model, GLuint program, const Camera &camera, mat4 modelMatrix, unsigned int level)
+{
+	if (model->meshlets.empty())
+	{
+		Graphics::RenderModel(model, program, modelMatrix, level);
+		return Graphics::IndexCount(*model, level);
+	}
+	GLuint meshletOffset = level < model->levels.size() ? model->levels[level].meshletOffset : 0;
+	GLuint meshletCount = level < model->levels.size() ? model->levels[level].meshletCount : GLuint(model->meshlets.size());
+
+	// Frustum planes in model space (Gribb and Hartmann), normalized so that the spheres can be tested in model units
+	mat4 clip = camera.projectionMatrix * camera.viewMatrix * modelMatrix;
+	vec4 rows[4] = { glm::row(clip, 0), glm::row(clip, 1), glm::row(clip, 2), glm::row(clip, 3) };
+	vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+	for (unsigned int p = 0; p < 6; ++p)
+		planes[p] /= glm::length(vec3(planes[p]));
+
+	// Camera in model space, an orthographic one (e.g. the shadow map's) looks along one direction from everywhere
+	mat4 viewToModel = glm::inverse(camera.viewMatrix * modelMatrix);
+	vec3 cameraPosition = vec3(viewToModel * vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	vec3 viewDirection = glm::normalize(vec3(viewToModel * vec4(0.0f, 0.0f, -1.0f, 0.0f)));
+	bool orthographic = camera.projectionMatrix[3][3] == 1.0f;
+
+	culler->compacted.clear();
+	ClusterCullingStats *stats = &culler->stats;
+	for (GLuint m = meshletOffset; m < meshletOffset + meshletCount; ++m)
+	{
+		const Meshlet &meshlet = model->meshlets[m];
+		stats->triangleCount += meshlet.indexCount / 3;
+
+		bool outside = false;
+		for (unsigned int p = 0; p < 6 && !outside; ++p)
+			outside = glm::dot(vec3(planes[p]), meshlet.center) + planes[p].w < -meshlet.radius;
+		if (outside)
+		{
+			stats->frustumCulledTriangleCount += meshlet.indexCount / 3;
+			continue;
+		}
+
+		vec3 toApex = orthographic ? viewDirection : glm::normalize(meshlet.coneApex - cameraPosition);
+		if (meshlet.coneCutoff <= 1.0f && glm::dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff)
+		{
+			stats->backfaceCulledTriangleCount += meshlet.indexCount / 3;
+			continue;
+		}
+
+		const uint8_t *indices = &model->indices[size_t(meshlet.indexOffset) * model->indexStride];
+		culler->compacted.insert(culler->compacted.end(), indices, indices + size_t(meshlet.indexCount) * model->indexStride);
+	}
+
+	GLuint indexCount = GLuint(culler->compacted.size() / model->indexStride);
+	if (indexCount == 0)
+		return 0;
+	size_t byteOffset = Upload(culler);
+	Graphics::RenderModelIndices(model, program, modelMatrix, culler->indexBuffer, byteOffset, indexCount);
+	return indexCount;
+}
+
+void ClusterCullingControl::Release(ClusterCuller *culler)
+{
+	glDeleteBuffers(1, &culler->indexBuffer);
+	*culler = ClusterCuller();
+}
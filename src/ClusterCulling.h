@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Graphics.h"
+
+// Triangles of the meshlets tested in the current frame, all passes
+struct ClusterCullingStats
+{
+	unsigned int triangleCount = 0;
+	unsigned int frustumCulledTriangleCount = 0;		// Bounding sphere outside of the camera's frustum
+	unsigned int backfaceCulledTriangleCount = 0;		// Normal cone facing away from the camera
+};
+
+// Tests the meshlets of a model against the camera on the CPU and draws the ones left with a single draw call from an
+// index buffer that their indices are compacted into. The buffer is filled front to back and orphaned once it runs
+// full, so the draws of a frame do not wait for the GPU to finish the previous ones.
+struct ClusterCuller
+{
+	GLuint indexBuffer = 0;
+	size_t capacity = 0;				// Bytes
+	size_t used = 0;					// Bytes written since the buffer was last orphaned
+	std::vector<uint8_t> compacted;		// Indices of the current draw
+	ClusterCullingStats stats;
+};
+
+namespace ClusterCullingControl
+{
+	void Init(ClusterCuller *culler);
+	void ResetStats(ClusterCuller *culler);
+	// Draws the meshlets of the model's level that intersect the camera's frustum and do not face away from it, returns
+	// the number of indices drawn. Models without meshlets are drawn whole. The backface test assumes that modelMatrix
+	// does not scale non-uniformly and that back faces are culled.
+	GLuint RenderModel(ClusterCuller *culler, Model *model, GLuint program, const Camera &camera, glm::mat4 modelMatrix, unsigned int level = 0);
+	void Release(ClusterCuller *culler);
+}
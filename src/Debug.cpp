@@ -72,8 +72,9 @@ void DEBUG::ReloadShadersIfModified(AppContext *context, const char *file)
 		{
 			unsigned int screenWidth = context->sceneRC.framebuffer.width;
 			unsigned int screenHeight = context->sceneRC.framebuffer.height;
+			std::string assetPackFile = context->assetPackFile;
 			App::Release(context);
-			App::Init(context, screenWidth, screenHeight);
+			App::Init(context, screenWidth, screenHeight, assetPackFile.c_str());
 
 			context->previousModificationTime = modificationTime;
 		}
@@ -3,14 +3,22 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <map>
+#include <algorithm>
 
 #include <glad/glad.h> 
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "stb_image.h"
 
 #include "Graphics.h"
 #include "UtilMesh.h"
+#include "IBLBake.h"
+#include "RadianceHDR.h"
+#include "MipChain.h"
+#include "BlockCompression.h"
+#include "TextureFile.h"
 
 GLenum glCheckError_(const char *file, int line)
 {
@@ -34,6 +42,11 @@ GLenum glCheckError_(const char *file, int line)
 }
 
 void Graphics::InitModel(Model *model, Mesh mesh)
+{
+	Graphics::InitModel(model, mesh, true);
+}
+
+void Graphics::InitModel(Model *model, const Mesh &mesh, bool freeMesh)
 {
 	glGenVertexArrays(1, &model->vao);
 	glBindVertexArray(model->vao);
@@ -46,32 +59,70 @@ void Graphics::InitModel(Model *model, Mesh mesh)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount*mesh.indexStride, mesh.indices, GL_STATIC_DRAW);
 	
+	static const GLenum ATTRIBUTE_TYPES[VertexAttributeType::TypeCount] = { GL_FLOAT, GL_HALF_FLOAT, GL_SHORT };
 	size_t offset = 0;
-	for (unsigned int i = 0; i < mesh.vertexAttributeSizes.size(); ++i)
+	for (unsigned int i = 0; i < mesh.vertexAttributes.size(); ++i)
 	{
 		glEnableVertexAttribArray(i);
-		unsigned int attributeSize = mesh.vertexAttributeSizes[i];
-		glVertexAttribPointer(i, attributeSize, GL_FLOAT, GL_FALSE, mesh.vertexStride, (void*)offset);
-		offset += sizeof(float) * attributeSize;
+		const VertexAttribute &attribute = mesh.vertexAttributes[i];
+		glVertexAttribPointer(i, attribute.size, ATTRIBUTE_TYPES[attribute.type], attribute.normalized ? GL_TRUE : GL_FALSE, mesh.vertexStride, (void*)offset);
+		offset += UtilMesh::AttributeBytes(attribute);
 	}
 
-	model->indexCount = mesh.indexCount;
+	model->indexCount = mesh.levels.empty() ? mesh.indexCount : mesh.levels[0].indexCount;
 	model->indexStride = mesh.indexStride;
-
-	UtilMesh::Free(mesh);
+	model->positionScale = mesh.positionScale;
+	model->levels.clear();
+	for (unsigned int i = 0; i < mesh.levels.size(); ++i)
+	{
+		ModelLevel level;
+		level.indexOffset = mesh.levels[i].indexOffset;
+		level.indexCount = mesh.levels[i].indexCount;
+		level.error = mesh.levels[i].error;
+		level.meshletOffset = mesh.levels[i].meshletOffset;
+		level.meshletCount = mesh.levels[i].meshletCount;
+		model->levels.push_back(level);
+	}
+	// The cluster culling compacts the indices of the visible meshlets on the CPU
+	model->meshlets = mesh.meshlets;
+	model->indices.clear();
+	if (!model->meshlets.empty())
+		model->indices.assign((const uint8_t *)mesh.indices, (const uint8_t *)mesh.indices + mesh.indexCount*mesh.indexStride);
+
+	if (freeMesh)
+		UtilMesh::Free(mesh);
 	glBindVertexArray(0);
 	glCheckError(); 	
 }
 
-bool Graphics::CreateShader(GLenum shaderType, GLuint *shader, std::string shaderSourceFile)
+// Inserts a #define line for every entry of defines right after the #version directive
+static std::string InsertDefines(const std::string &source, const std::vector<std::string> &defines)
 {
-	*shader = glCreateShader(shaderType);
-	if (*shader == 0)
+	if (defines.empty())
+		return source;
+
+	size_t insertPosition = 0;
+	size_t versionPosition = source.find("#version");
+	if (versionPosition != std::string::npos)
 	{
-		std::cerr << "glCreateShader failed. \n";
-		return false;
+		size_t lineEnd = source.find('\n', versionPosition);
+		insertPosition = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
 	}
 
+	std::string defineLines;
+	for (unsigned int i = 0; i < defines.size(); ++i)
+		defineLines += "#define " + defines[i] + "\n";
+
+	std::string result = source;
+	result.insert(insertPosition, defineLines);
+	return result;
+}
+
+// Sources read ahead of time by PreloadShaderSource, compiled instead of the files until they are cleared
+static std::map<std::string, std::string> preloadedShaderSources;
+
+bool Graphics::ReadShaderSource(const std::string &shaderSourceFile, std::string *source)
+{
 	std::ifstream f(shaderSourceFile);
 	if (!f.good())
 	{
@@ -90,13 +141,47 @@ bool Graphics::CreateShader(GLenum shaderType, GLuint *shader, std::string shade
 	}
 
 	std::streampos size = shaderFile.tellg();
-	int intSize = int(size);
-	char *data = new char[intSize];
+	source->resize(size_t(size));
 	shaderFile.seekg(0, std::ios::beg);
-	shaderFile.read(data, size);
+	shaderFile.read(&(*source)[0], size);
 	shaderFile.close();
+	return true;
+}
+
+void Graphics::PreloadShaderSource(const std::string &shaderSourceFile, const std::string &source)
+{
+	preloadedShaderSources[shaderSourceFile] = source;
+}
+
+void Graphics::ClearPreloadedShaderSources()
+{
+	preloadedShaderSources.clear();
+}
+
+bool Graphics::CreateShader(GLenum shaderType, GLuint *shader, std::string shaderSourceFile, const std::vector<std::string> &defines)
+{
+	*shader = glCreateShader(shaderType);
+	if (*shader == 0)
+	{
+		std::cerr << "glCreateShader failed. \n";
+		return false;
+	}
 
-	glShaderSource(*shader, 1, (GLchar **)&data, (GLint *)&intSize);
+	std::string fileSource;
+	auto preloaded = preloadedShaderSources.find(shaderSourceFile);
+	if (preloaded != preloadedShaderSources.end())
+	{
+		fileSource = preloaded->second;
+	}
+	else if (!Graphics::ReadShaderSource(shaderSourceFile, &fileSource))
+	{
+		return false;
+	}
+
+	std::string source = InsertDefines(fileSource, defines);
+	const GLchar *sourceData = source.c_str();
+	GLint sourceSize = GLint(source.size());
+	glShaderSource(*shader, 1, &sourceData, &sourceSize);
 	glCompileShader(*shader);
 	GLint status;
 	glGetShaderiv(*shader, GL_COMPILE_STATUS, &status);
@@ -107,17 +192,16 @@ bool Graphics::CreateShader(GLenum shaderType, GLuint *shader, std::string shade
 		std::cerr << "glCompileShader failed.\n";
 		std::cerr << logBuffer;
 	}
-	delete[] data;
 
 	glCheckError();
 	return true;
 }
 
-GLuint Graphics::CreateProgram(std::string vertexShaderFile, std::string fragmentShaderFile)
+GLuint Graphics::CreateProgram(std::string vertexShaderFile, std::string fragmentShaderFile, const std::vector<std::string> &defines)
 {
 	GLuint vertexShader, fragmentShader;
-	CreateShader(GL_VERTEX_SHADER, &vertexShader, vertexShaderFile);
-	CreateShader(GL_FRAGMENT_SHADER, &fragmentShader, fragmentShaderFile);
+	CreateShader(GL_VERTEX_SHADER, &vertexShader, vertexShaderFile, defines);
+	CreateShader(GL_FRAGMENT_SHADER, &fragmentShader, fragmentShaderFile, defines);
 
 	GLuint shaderProgram = glCreateProgram();
 	glAttachShader(shaderProgram, vertexShader);
@@ -138,6 +222,58 @@ GLuint Graphics::CreateProgram(std::string vertexShaderFile, std::string fragmen
 	return shaderProgram;
 }
 
+GLuint Graphics::CreateProgram(std::string vertexShaderFile, std::string geometryShaderFile, std::string fragmentShaderFile,
+							  const std::vector<std::string> &defines)
+{
+	GLuint vertexShader, geometryShader, fragmentShader;
+	CreateShader(GL_VERTEX_SHADER, &vertexShader, vertexShaderFile, defines);
+	CreateShader(GL_GEOMETRY_SHADER, &geometryShader, geometryShaderFile, defines);
+	CreateShader(GL_FRAGMENT_SHADER, &fragmentShader, fragmentShaderFile, defines);
+
+	GLuint shaderProgram = glCreateProgram();
+	glAttachShader(shaderProgram, vertexShader);
+	glAttachShader(shaderProgram, geometryShader);
+	glAttachShader(shaderProgram, fragmentShader);
+	glLinkProgram(shaderProgram);
+	glCheckError();
+
+	GLint status;
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		std::cerr << "ERROR: Program linking failed. VS: " << vertexShaderFile << " GS: " << geometryShaderFile
+				  << " FS: " << fragmentShaderFile << "\n";
+	}
+
+	glDetachShader(shaderProgram, vertexShader);
+	glDetachShader(shaderProgram, geometryShader);
+	glDetachShader(shaderProgram, fragmentShader);
+
+	return shaderProgram;
+}
+
+GLuint Graphics::CreateComputeProgram(std::string computeShaderFile, const std::vector<std::string> &defines)
+{
+	GLuint computeShader;
+	CreateShader(GL_COMPUTE_SHADER, &computeShader, computeShaderFile, defines);
+
+	GLuint shaderProgram = glCreateProgram();
+	glAttachShader(shaderProgram, computeShader);
+	glLinkProgram(shaderProgram);
+	glCheckError();
+
+	GLint status;
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		std::cerr << "ERROR: Program linking failed. CS: " << computeShaderFile << "\n";
+	}
+
+	glDetachShader(shaderProgram, computeShader);
+
+	return shaderProgram;
+}
+
 void Graphics::InitTexture2D(Texture *texture, uint8_t *data, unsigned int width, unsigned int height, GLenum internalFormat, GLenum format)
 {
 	glGenTextures(1, &texture->id);
@@ -150,6 +286,7 @@ void Graphics::InitTexture2D(Texture *texture, uint8_t *data, unsigned int width
 	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 	glGenerateMipmap(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, 0);
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
 }
 
 void Graphics::InitTexture2D(Texture *texture, uint8_t *data, unsigned int width, unsigned int height, unsigned int numChannels)
@@ -184,44 +321,66 @@ void Graphics::InitTexture2D(Texture *texture, uint8_t *data, unsigned int width
 	Graphics::InitTexture2D(texture, data, width, height, internalFormat, format);
 }
 
-void Graphics::InitTexture2D(Texture *texture, const char *sourceFile)
+// The mip chain is built on the CPU (or read from the cooked file next to the source), see MipChain
+void Graphics::InitTexture2D(Texture *texture, const char *sourceFile, const MipChainSettings &settings)
 {
-	int width, height, numChannels;
+	TextureData data;
 	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(sourceFile, &width, &height, &numChannels, 0);
-	if (data)
+	if (MipChain::Load(sourceFile, settings, &data))
 	{
-		Graphics::InitTexture2D(texture, data, width, height, numChannels);
+		Graphics::InitTexture(texture, data);
 	}
 	else
 	{
 		std::cerr << "ERROR: Failed to load texture" << std::endl;
 	}
-	stbi_image_free(data);
 }
 
-void Graphics::InitHDRTexture(Texture *texture, const char *sourceFile)
+// Radiance files are decoded by RadianceHDR straight to half floats, anything else stb_image can read goes through floats
+bool Graphics::ReadHDRImage(const char *sourceFile, TextureData *data)
 {
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, numComponents;
-	float *data = stbi_loadf(sourceFile, &width, &height, &numComponents, 0);
-	if (data)
+	*data = TextureData();
+	data->target = TextureTarget::Texture2D;
+	data->internalFormat = GL_RGB16F;
+	data->format = GL_RGB;
+	data->wrap = GL_CLAMP_TO_EDGE;
+	data->mipCount = 1;
+	data->levels.resize(1);
+
+	HalfImage halfImage;
+	if (RadianceHDR::IsRadianceFile(sourceFile) && RadianceHDR::Read(sourceFile, &halfImage, true))
 	{
-		glGenTextures(1, &texture->id);
-		glBindTexture(GL_TEXTURE_2D, texture->id);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+		data->type = GL_HALF_FLOAT;
+		data->width = halfImage.width;
+		data->height = halfImage.height;
+		const uint8_t *texels = (const uint8_t *)halfImage.texels.data();
+		data->levels[0].assign(texels, texels + halfImage.texels.size() * sizeof(uint16_t));
+		return true;
 	}
-	else
+
+	// The flip flag is set for every loader, see TextureLoaderControl::Init
+	int width, height, numComponents;
+	stbi_set_flip_vertically_on_load(true);
+	float *texels = stbi_loadf(sourceFile, &width, &height, &numComponents, 3);
+	if (!texels)
 	{
 		std::cerr << "Failed to load HDR image." << std::endl;
+		*data = TextureData();
+		return false;
 	}
+	data->type = GL_FLOAT;
+	data->width = width;
+	data->height = height;
+	data->levels[0].assign((const uint8_t *)texels, (const uint8_t *)(texels + size_t(width) * height * 3));
+	stbi_image_free(texels);
+	return true;
+}
+
+void Graphics::InitHDRTexture(Texture *texture, const char *sourceFile)
+{
+	TextureData data;
+	if (Graphics::ReadHDRImage(sourceFile, &data))
+		Graphics::InitTexture(texture, data);
 }
 
 // cubeMapFaces order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
@@ -257,6 +416,8 @@ void Graphics::InitCubemapTexture(Texture *texture, std::vector<unsigned char *>
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	texture->target = TextureTarget::Cubemap;
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
 }
 
 // cubeMapFaces order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
@@ -292,6 +453,271 @@ void Graphics::InitCubemapTexture(Texture *texture, std::vector<std::string> cub
 		stbi_image_free(texData[i]);
 }
 
+// Uploads a CPU baked cubemap (e.g. from IBLBake) as an RGB16F cubemap with the same mip chain
+// image == nullptr only allocates the storage
+static void InitCubemapLevels(Texture *texture, unsigned int size, unsigned int mipCount, const CubemapImage *image,
+							  GLenum internalFormat = GL_RGB16F)
+{
+	const unsigned int numberOfCubeMapFaces = 6;
+	GLint textureMinFilter = mipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+
+	glGenTextures(1, &texture->id);
+	texture->target = TextureTarget::Cubemap;
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture->id);
+		for (unsigned int mip = 0; mip < mipCount; ++mip)
+		{
+			unsigned int mipSize = std::max(size >> mip, 1u);
+			for (unsigned int face = 0; face < numberOfCubeMapFaces; ++face)
+			{
+				const float *data = image ? image->faces[mip * numberOfCubeMapFaces + face].data() : nullptr;
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, internalFormat, mipSize, mipSize, 0, GL_RGB, GL_FLOAT, data);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, textureMinFilter);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
+	glCheckError();
+}
+
+void Graphics::InitCubemapTexture(Texture *texture, const CubemapImage &image)
+{
+	InitCubemapLevels(texture, image.size, image.mipCount, &image);
+}
+
+void Graphics::InitCubemapTexture(Texture *texture, unsigned int size, unsigned int mipCount, GLenum internalFormat)
+{
+	InitCubemapLevels(texture, size, mipCount, nullptr, internalFormat);
+}
+
+// Reads back the first mipCount levels of a cubemap texture, e.g. to compare GPU and CPU bakes
+void Graphics::ReadCubemapTexture(Texture *texture, unsigned int mipCount, CubemapImage *image)
+{
+	const unsigned int numberOfCubeMapFaces = 6;
+	GLint size = 0;
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture->id);
+	glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+	IBLBake::InitCubemapImage(image, (unsigned int)size, mipCount);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+	{
+		for (unsigned int face = 0; face < numberOfCubeMapFaces; ++face)
+		{
+			glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, GL_FLOAT, image->faces[mip * numberOfCubeMapFaces + face].data());
+		}
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glCheckError();
+}
+
+unsigned int Graphics::FaceCount(TextureTarget target)
+{
+	return target == TextureTarget::Cubemap ? 6 : 1;
+}
+
+static GLenum TextureTargetToGL(TextureTarget target)
+{
+	return target == TextureTarget::Cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+}
+
+size_t Graphics::TextureMemoryBytes(const Texture *texture)
+{
+	// Levels that are not defined (e.g. dropped by TextureResidency) have no width
+	GLint maxSize = 0, maxLevelCount = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	while ((maxSize >> maxLevelCount) > 0)
+		++maxLevelCount;
+	GLenum target = TextureTargetToGL(texture->target);
+	GLenum levelTarget = texture->target == TextureTarget::Cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : GL_TEXTURE_2D;
+	const GLenum componentSizes[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+									  GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE };
+
+	size_t bytes = 0;
+	glBindTexture(target, texture->id);
+	for (GLint level = 0; level < maxLevelCount; ++level)
+	{
+		GLint width = 0, height = 0, compressed = GL_FALSE;
+		glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0)
+			continue;
+		glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_COMPRESSED, &compressed);
+		size_t levelBytes = 0;
+		if (compressed)
+		{
+			GLint imageSize = 0;
+			glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+			levelBytes = size_t(imageSize);
+		}
+		else
+		{
+			GLint texelBits = 0;
+			for (unsigned int i = 0; i < ARRAYSIZE(componentSizes); ++i)
+			{
+				GLint componentBits = 0;
+				glGetTexLevelParameteriv(levelTarget, level, componentSizes[i], &componentBits);
+				texelBits += componentBits;
+			}
+			levelBytes = size_t(width) * size_t(height) * size_t(texelBits) / 8;
+		}
+		bytes += levelBytes * Graphics::FaceCount(texture->target);
+	}
+	glBindTexture(target, 0);
+	return bytes;
+}
+
+// Box filtered mip chain of the whole texture, switches the minification to trilinear filtering
+void Graphics::GenerateMipmaps(Texture *texture)
+{
+	GLenum target = TextureTargetToGL(texture->target);
+	glBindTexture(target, texture->id);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 1000);
+	glGenerateMipmap(target);
+	glBindTexture(target, 0);
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
+	glCheckError();
+}
+
+// Pixel transfer format and type that represent the internal format without conversion
+static bool TransferFormat(GLenum internalFormat, GLenum *format, GLenum *type, unsigned int *bytesPerPixel)
+{
+	switch (internalFormat)
+	{
+		case GL_RGBA16F:	*format = GL_RGBA;	*type = GL_HALF_FLOAT;		*bytesPerPixel = 8; return true;
+		case GL_RGB16F:		*format = GL_RGB;	*type = GL_HALF_FLOAT;		*bytesPerPixel = 6; return true;
+		case GL_RG16F:		*format = GL_RG;	*type = GL_HALF_FLOAT;		*bytesPerPixel = 4; return true;
+		case GL_R16F:		*format = GL_RED;	*type = GL_HALF_FLOAT;		*bytesPerPixel = 2; return true;
+		case GL_RGBA8:		*format = GL_RGBA;	*type = GL_UNSIGNED_BYTE;	*bytesPerPixel = 4; return true;
+		case GL_RGB8:		*format = GL_RGB;	*type = GL_UNSIGNED_BYTE;	*bytesPerPixel = 3; return true;
+		case GL_RG8:		*format = GL_RG;	*type = GL_UNSIGNED_BYTE;	*bytesPerPixel = 2; return true;
+		case GL_R8:			*format = GL_RED;	*type = GL_UNSIGNED_BYTE;	*bytesPerPixel = 1; return true;
+		default:
+			return false;
+	}
+}
+
+void Graphics::InitTexture(Texture *texture, const TextureData &data)
+{
+	std::vector<TextureLevelView> levels(data.levels.size());
+	for (unsigned int i = 0; i < data.levels.size(); ++i)
+	{
+		levels[i].data = data.levels[i].data();
+		levels[i].size = data.levels[i].size();
+	}
+	Graphics::InitTexture(texture, data, levels);
+}
+
+void Graphics::InitTexture(Texture *texture, const TextureData &data, const std::vector<TextureLevelView> &levels)
+{
+	GLenum target = TextureTargetToGL(data.target);
+	unsigned int faceCount = Graphics::FaceCount(data.target);
+	GLint textureMinFilter = data.mipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+	bool compressed = BlockCompression::IsCompressedFormat(data.internalFormat);
+
+	glGenTextures(1, &texture->id);
+	texture->target = data.target;
+	glBindTexture(target, texture->id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (unsigned int mip = 0; mip < data.mipCount; ++mip)
+		{
+			unsigned int width = std::max(data.width >> mip, 1u);
+			unsigned int height = std::max(data.height >> mip, 1u);
+			for (unsigned int face = 0; face < faceCount; ++face)
+			{
+				GLenum imageTarget = data.target == TextureTarget::Cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+				const TextureLevelView &level = levels[mip * faceCount + face];
+				if (compressed)
+					glCompressedTexImage2D(imageTarget, mip, data.internalFormat, width, height, 0, GLsizei(level.size), level.data);
+				else
+					glTexImage2D(imageTarget, mip, data.internalFormat, width, height, 0, data.format, data.type, level.data);
+			}
+		}
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, data.mipCount - 1);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, textureMinFilter);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, data.wrap);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, data.wrap);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, data.wrap);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(target, 0);
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
+	glCheckError();
+}
+
+bool Graphics::InitTexture(Texture *texture, const char *textureFile)
+{
+	TextureData data;
+	if (!TextureFile::Read(textureFile, &data))
+	{
+		std::cerr << "ERROR: Failed to load texture " << textureFile << "\n";
+		return false;
+	}
+	Graphics::InitTexture(texture, data);
+	return true;
+}
+
+// Reads back every defined mip level of every face
+void Graphics::ReadTexture(Texture *texture, TextureData *data)
+{
+	GLenum target = TextureTargetToGL(texture->target);
+	GLenum levelTarget = texture->target == TextureTarget::Cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : GL_TEXTURE_2D;
+	unsigned int faceCount = Graphics::FaceCount(texture->target);
+
+	glBindTexture(target, texture->id);
+	GLint internalFormat = 0, width = 0, height = 0;
+	glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_HEIGHT, &height);
+
+	unsigned int bytesPerPixel = 0;
+	*data = TextureData();
+	data->target = texture->target;
+	data->internalFormat = internalFormat;
+	data->width = width;
+	data->height = height;
+	if (!TransferFormat(data->internalFormat, &data->format, &data->type, &bytesPerPixel))
+	{
+		std::cerr << "ERROR: Unsupported internal format for texture read back " << internalFormat << "\n";
+		glBindTexture(target, 0);
+		return;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (unsigned int mip = 0; ; ++mip)
+	{
+		GLint mipWidth = 0, mipHeight = 0;
+		glGetTexLevelParameteriv(levelTarget, mip, GL_TEXTURE_WIDTH, &mipWidth);
+		glGetTexLevelParameteriv(levelTarget, mip, GL_TEXTURE_HEIGHT, &mipHeight);
+		if (mipWidth == 0 || mipHeight == 0)
+			break;
+
+		for (unsigned int face = 0; face < faceCount; ++face)
+		{
+			GLenum imageTarget = texture->target == TextureTarget::Cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+			std::vector<uint8_t> level(size_t(mipWidth) * mipHeight * bytesPerPixel);
+			glGetTexImage(imageTarget, mip, data->format, data->type, level.data());
+			data->levels.push_back(level);
+		}
+		++data->mipCount;
+
+		if (mipWidth == 1 && mipHeight == 1)
+			break;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindTexture(target, 0);
+	glCheckError();
+}
+
 void Graphics::BindTexture(Texture *texture, unsigned int slot)
 {
 	glActiveTexture(GL_TEXTURE0 + slot);
@@ -311,6 +737,33 @@ void Graphics::BindTexture(Texture *texture, unsigned int slot)
 	glCheckError();
 }
 
+void Graphics::InitUniformBuffer(UniformBuffer *buffer, const void *data, size_t size)
+{
+	buffer->size = size;
+	glGenBuffers(1, &buffer->id);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer->id);
+	glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glCheckError();
+}
+
+void Graphics::BindUniformBuffer(UniformBuffer *buffer, unsigned int binding)
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer->id);
+	glCheckError();
+}
+
+void Graphics::SetUniformBlockBinding(GLuint program, unsigned int binding, std::string blockName)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(program, blockName.c_str());
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		return;
+	}
+	glUniformBlockBinding(program, blockIndex, binding);
+	glCheckError();
+}
+
 void Graphics::InitOpenGLState()
 {
 	glEnable(GL_DEPTH_TEST);
@@ -326,26 +779,74 @@ void Graphics::UseProgram(GLuint program)
 	glUseProgram(program);
 }
 
-void Graphics::RenderModel(Model *model, GLuint program, glm::mat4 modelMatrix)
+static bool IndexType(Model *model, GLenum *indexType)
 {
-	Graphics::SetMatrixUniform(program, modelMatrix, MODEL_UNIFORM_NAME);
-	GLenum indexType;
 	switch (model->indexStride)
 	{
 		case 2:
-			indexType = GL_UNSIGNED_SHORT;
-			break;
+			*indexType = GL_UNSIGNED_SHORT;
+			return true;
 		case 4:
-			indexType = GL_UNSIGNED_INT;
-			break;
+			*indexType = GL_UNSIGNED_INT;
+			return true;
 		default:
 			std::cerr << "Index stride not recognized.\n";
-			return;
-			break;
+			return false;
 	}
+}
+
+// Scales quantized positions back to their size
+static glm::mat4 DequantizedModelMatrix(const Model *model, const glm::mat4 &modelMatrix)
+{
+	if (model->positionScale == 1.0f)
+		return modelMatrix;
+	return modelMatrix * glm::scale(glm::mat4(), glm::vec3(model->positionScale));
+}
+
+void Graphics::RenderModel(Model *model, GLuint program, glm::mat4 modelMatrix, unsigned int level)
+{
+	Graphics::SetMatrixUniform(program, DequantizedModelMatrix(model, modelMatrix), MODEL_UNIFORM_NAME);
+	GLenum indexType;
+	if (!IndexType(model, &indexType))
+		return;
 
+	GLuint indexOffset = level < model->levels.size() ? model->levels[level].indexOffset : 0;
 	glBindVertexArray(model->vao);
-		glDrawElements(GL_TRIANGLES, model->indexCount, indexType, 0);
+		glDrawElements(GL_TRIANGLES, IndexCount(*model, level), indexType, (void*)(size_t(indexOffset) * model->indexStride));
+	glBindVertexArray(0);
+	glCheckError();
+}
+
+void Graphics::RenderModelIndices(Model *model, GLuint program, glm::mat4 modelMatrix, GLuint indexBuffer, size_t byteOffset, GLuint indexCount)
+{
+	Graphics::SetMatrixUniform(program, DequantizedModelMatrix(model, modelMatrix), MODEL_UNIFORM_NAME);
+	GLenum indexType;
+	if (!IndexType(model, &indexType))
+		return;
+
+	// The element buffer binding is part of the VAO
+	glBindVertexArray(model->vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)byteOffset);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->ibo);
+	glBindVertexArray(0);
+	glCheckError();
+}
+
+GLuint Graphics::IndexCount(const Model &model, unsigned int level)
+{
+	return level < model.levels.size() ? model.levels[level].indexCount : model.indexCount;
+}
+
+void Graphics::RenderModelInstanced(Model *model, GLuint program, unsigned int instanceCount, glm::mat4 modelMatrix)
+{
+	Graphics::SetMatrixUniform(program, DequantizedModelMatrix(model, modelMatrix), MODEL_UNIFORM_NAME);
+	GLenum indexType;
+	if (!IndexType(model, &indexType))
+		return;
+
+	glBindVertexArray(model->vao);
+		glDrawElementsInstanced(GL_TRIANGLES, model->indexCount, indexType, 0, instanceCount);
 	glBindVertexArray(0);
 	glCheckError();
 }
@@ -421,12 +922,14 @@ void Graphics::InitDrawFramebuffer(Framebuffer *framebuffer, unsigned int width,
 	glCheckError();
 }
 
-void Graphics::InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height, bool useMipMaps)
+// A layered framebuffer has the whole cubemap attached (the face is selected with gl_Layer) and no depth attachment,
+// which would have to be layered as well. Rendering a skybox from its center does not need depth testing.
+void Graphics::InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height, bool useMipMaps, bool layered)
 {
 	framebuffer->width = width;
 	framebuffer->height = height;
 	framebuffer->depthAttachment.type = FramebufferAttachmentType::RenderbufferAttachment;
-	framebuffer->depthAttachment.internalFormat = GL_DEPTH_COMPONENT24;
+	framebuffer->depthAttachment.internalFormat = layered ? 0 : GL_DEPTH_COMPONENT24;
 	framebuffer->depthAttachment.format = 0;
 	framebuffer->colorAttachment.type = FramebufferAttachmentType::TextureAttachment;
 	framebuffer->colorAttachment.internalFormat = GL_RGB16F;
@@ -437,12 +940,15 @@ void Graphics::InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int wid
 		textureMinFilter = GL_LINEAR_MIPMAP_LINEAR;
 
 	glGenFramebuffers(1, &framebuffer->fbo);
-	glGenRenderbuffers(1, &framebuffer->depthAttachment.id);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
-		glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->depthAttachment.id);
-		glRenderbufferStorage(GL_RENDERBUFFER, framebuffer->depthAttachment.internalFormat, width, height);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer->depthAttachment.id);
+		if (!layered)
+		{
+			glGenRenderbuffers(1, &framebuffer->depthAttachment.id);
+			glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->depthAttachment.id);
+			glRenderbufferStorage(GL_RENDERBUFFER, framebuffer->depthAttachment.internalFormat, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer->depthAttachment.id);
+		}
 
 		glGenTextures(1, &framebuffer->colorAttachment.id);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, framebuffer->colorAttachment.id);
@@ -460,6 +966,9 @@ void Graphics::InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int wid
 		if (useMipMaps)
 			glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
+		if (layered)
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, framebuffer->colorAttachment.id, 0);
+
 		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -572,4 +1081,10 @@ void Graphics::Release(Framebuffer *framebuffer)
 void Graphics::Release(Texture *texture)
 {
 	glDeleteTextures(1, &texture->id);
+	texture->memoryBytes = 0;
+}
+
+void Graphics::Release(UniformBuffer *buffer)
+{
+	glDeleteBuffers(1, &buffer->id);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 #include "Camera.h"
 #include "Def.h"
+#include "MipChain.h"
+#include "UtilMesh.h"
 
 #define glCheckError() glCheckError_(__FILE__, __LINE__) 
 
@@ -15,7 +17,17 @@
 #define MODEL_UNIFORM_NAME "uModelMatrix"
 #define PROJECTION_UNIFORM_NAME "uProjectionMatrix"
 
-struct Mesh;
+struct CubemapImage;
+
+// Range of the index buffer drawn for one level of detail, see MeshLevel
+struct ModelLevel
+{
+	GLuint indexOffset = 0;
+	GLuint indexCount = 0;
+	float error = 0.0f;
+	GLuint meshletOffset = 0;
+	GLuint meshletCount = 0;
+};
 
 struct Model
 {
@@ -25,6 +37,10 @@ struct Model
 
 	GLuint indexCount = 0;
 	GLuint indexStride = 0;
+	float positionScale = 1.0f;		// Of the mesh, applied in front of the model matrix
+	std::vector<ModelLevel> levels;	// Levels of detail, empty if the mesh has none (indexCount is the one of level 0)
+	std::vector<Meshlet> meshlets;	// Of every level, empty if the mesh has none (see MeshletBuilder)
+	std::vector<uint8_t> indices;	// Copy of the index buffer for the cluster culling, only with meshlets
 };
 
 enum FramebufferAttachmentType
@@ -60,6 +76,29 @@ struct Texture
 {
 	GLuint id = 0;
 	TextureTarget target = Texture2D;
+	size_t memoryBytes = 0;		// Of the defined levels, set by the functions below that create or change them
+};
+
+// Texture contents in system memory. Every face and mip level is kept in the texture's GL internal format
+// so that it can be written to disk and uploaded again without any conversion.
+struct TextureData
+{
+	TextureTarget target = Texture2D;
+	GLenum internalFormat = 0;
+	GLenum format = 0;
+	GLenum type = 0;
+	GLenum wrap = GL_CLAMP_TO_EDGE;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int mipCount = 0;
+	std::vector<std::vector<uint8_t>> levels;		// Indexed [mip * faceCount + face]
+};
+
+// Bytes of one texture level that are owned by someone else, e.g. the mapped pages of an asset pack
+struct TextureLevelView
+{
+	const uint8_t *data = nullptr;
+	size_t size = 0;
 };
 
 struct Viewport
@@ -82,6 +121,12 @@ struct Viewport
 	}
 };
 
+struct UniformBuffer
+{
+	GLuint id = 0;
+	size_t size = 0;
+};
+
 struct RenderContext
 {
 	Camera camera;
@@ -93,21 +138,58 @@ namespace Graphics
 {
 	void InitOpenGLState();
 	void InitModel(Model *model, Mesh mesh);
+	// freeMesh = false for meshes whose memory the caller owns, e.g. the ones in a mapped asset pack
+	void InitModel(Model *model, const Mesh &mesh, bool freeMesh);
 	void InitTexture2D(Texture *texture, uint8_t *data, unsigned int width, unsigned int height, GLenum internalFormat, GLenum format);
 	void InitTexture2D(Texture *texture, uint8_t *data, unsigned int width, unsigned int height, unsigned int numComponents);
-	void InitTexture2D(Texture *texture, const char *sourceFile);
+	void InitTexture2D(Texture *texture, const char *sourceFile, const MipChainSettings &settings = MipChainSettings());
+	// Decodes to one RGB16F level (half or float data), safe to call from any thread
+	bool ReadHDRImage(const char *sourceFile, TextureData *data);
 	void InitHDRTexture(Texture *texture, const char *sourceFile);
 	void InitCubemapTexture(Texture *texture, std::vector<unsigned char *>, std::vector<unsigned int> widths, std::vector<unsigned int> heights, unsigned int numChannels);
 	void InitCubemapTexture(Texture *texture, std::vector<std::string> cubeMapFaces);
+	void InitCubemapTexture(Texture *texture, const CubemapImage &image);
+	void InitCubemapTexture(Texture *texture, unsigned int size, unsigned int mipCount, GLenum internalFormat = GL_RGB16F);	// Contents undefined
+	// Block compressed data (see BlockCompression) is uploaded with glCompressedTexImage2D
+	void InitTexture(Texture *texture, const TextureData &data);
+	// Uploads levels (indexed like TextureData::levels) straight from the caller's memory, description's levels are ignored
+	void InitTexture(Texture *texture, const TextureData &description, const std::vector<TextureLevelView> &levels);
+	// Loads a TextureFile, e.g. a material texture cooked by cooktex
+	bool InitTexture(Texture *texture, const char *textureFile);
+	void ReadTexture(Texture *texture, TextureData *data);
+	unsigned int FaceCount(TextureTarget target);
+	// Queried from GL, the texel sizes of the internal format (or the compressed sizes) without any driver padding
+	size_t TextureMemoryBytes(const Texture *texture);
+	void GenerateMipmaps(Texture *texture);
+	void ReadCubemapTexture(Texture *texture, unsigned int mipCount, CubemapImage *image);
 	void InitDrawFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height, GLenum colorInternalFormat = GL_RGB, GLenum colorFormat = GL_RGB);
-	void InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height, bool useMipMaps);
+	void InitCubeMapFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height, bool useMipMaps, bool layered = false);
 	void InitDepthFramebuffer(Framebuffer *framebuffer, unsigned int width, unsigned int height);
-	bool CreateShader(GLenum shaderType, GLuint *shader, std::string shaderSourceFile);
-	GLuint CreateProgram(std::string vertexShaderFile, std::string fragmentShaderFile);
+	void InitUniformBuffer(UniformBuffer *buffer, const void *data, size_t size);
+	// Safe to call from any thread, e.g. from a startup job
+	bool ReadShaderSource(const std::string &shaderSourceFile, std::string *source);
+	// CreateShader compiles source instead of reading the file until the preloaded sources are cleared (so that edits
+	// made later, e.g. for shader hot reloading, are picked up again)
+	void PreloadShaderSource(const std::string &shaderSourceFile, const std::string &source);
+	void ClearPreloadedShaderSources();
+	bool CreateShader(GLenum shaderType, GLuint *shader, std::string shaderSourceFile,
+					  const std::vector<std::string> &defines = std::vector<std::string>());
+	GLuint CreateProgram(std::string vertexShaderFile, std::string fragmentShaderFile,
+						 const std::vector<std::string> &defines = std::vector<std::string>());
+	GLuint CreateProgram(std::string vertexShaderFile, std::string geometryShaderFile, std::string fragmentShaderFile,
+						 const std::vector<std::string> &defines = std::vector<std::string>());
+	GLuint CreateComputeProgram(std::string computeShaderFile, const std::vector<std::string> &defines = std::vector<std::string>());
 
 	void BindTexture(Texture *texture, unsigned int slot);
+	void BindUniformBuffer(UniformBuffer *buffer, unsigned int binding);
+	void SetUniformBlockBinding(GLuint program, unsigned int binding, std::string blockName);
 	void UseProgram(GLuint program);
-	void RenderModel(Model *model, GLuint program, glm::mat4 modelMatrix = glm::mat4());
+	void RenderModel(Model *model, GLuint program, glm::mat4 modelMatrix = glm::mat4(), unsigned int level = 0);
+	// Draws indexCount indices of another element buffer (e.g. compacted by ClusterCulling) from byteOffset with the model's vertices
+	void RenderModelIndices(Model *model, GLuint program, glm::mat4 modelMatrix, GLuint indexBuffer, size_t byteOffset, GLuint indexCount);
+	// Indices RenderModel draws at this level of detail
+	GLuint IndexCount(const Model &model, unsigned int level);
+	void RenderModelInstanced(Model *model, GLuint program, unsigned int instanceCount, glm::mat4 modelMatrix = glm::mat4());
 	void SetMatrixUniform(GLuint program, glm::mat4 matrix, std::string uniformName);
 	void SetUniform1i(GLuint program, int value, std::string uniformName);
 	void SetUniform1f(GLuint program, float value, std::string uniformName);
@@ -122,4 +204,5 @@ namespace Graphics
 	void Release(GLuint program);
 	void Release(Framebuffer *framebuffer);
 	void Release(Texture *texture);
+	void Release(UniformBuffer *buffer);
 }
\ No newline at end of file
@@ -0,0 +1,719 @@
+#include <iostream>
+#include <cstdint>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define IBL_USE_SSE2
+#endif
+
+#include <glm/glm.hpp>
+
+#include "IBLBake.h"
+#include "Parallel.h"
+
+using glm::vec3;
+using std::vector;
+
+#define PI 3.14159265358979323846f
+
+static const unsigned int NUMBER_OF_CUBE_FACES = 6;
+
+// Tangent space to-light directions of the importance samples, stored as SoA and padded with zero weight samples
+// to a multiple of 4 so that they can be transformed to world space four at a time.
+struct SampleTable
+{
+	vector<float> x;
+	vector<float> y;
+	vector<float> z;
+	vector<float> weight;
+	vector<float> lod;				// Source mip per sample, empty unless filtered importance sampling is used
+	float totalWeight = 0.0f;
+};
+
+void IBLBake::InitCubemapImage(CubemapImage *image, unsigned int size, unsigned int mipCount)
+{
+	image->size = size;
+	image->mipCount = mipCount;
+	image->faces.resize(mipCount * NUMBER_OF_CUBE_FACES);
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+	{
+		unsigned int mipSize = IBLBake::MipSize(*image, mip);
+		for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+			image->faces[mip * NUMBER_OF_CUBE_FACES + face].assign(mipSize * mipSize * 3, 0.0f);
+	}
+}
+
+unsigned int IBLBake::MipSize(const CubemapImage &image, unsigned int mip)
+{
+	unsigned int mipSize = image.size >> mip;
+	return mipSize > 0 ? mipSize : 1;
+}
+
+// Inverse of the GL cube map face selection (see the "Cube Map Texture Selection" table of the GL specification)
+vec3 IBLBake::FaceDirection(unsigned int face, float u, float v)
+{
+	switch (face)
+	{
+		case 0: return vec3(1.0f, -v, -u);
+		case 1: return vec3(-1.0f, -v, u);
+		case 2: return vec3(u, 1.0f, v);
+		case 3: return vec3(u, -1.0f, -v);
+		case 4: return vec3(u, -v, 1.0f);
+		default: return vec3(-u, -v, -1.0f);
+	}
+}
+
+static void DirectionToFace(vec3 d, unsigned int *face, float *u, float *v)
+{
+	vec3 a = glm::abs(d);
+	if (a.x >= a.y && a.x >= a.z)
+	{
+		*face = d.x > 0.0f ? 0 : 1;
+		*u = (d.x > 0.0f ? -d.z : d.z) / a.x;
+		*v = -d.y / a.x;
+	}
+	else if (a.y >= a.z)
+	{
+		*face = d.y > 0.0f ? 2 : 3;
+		*u = d.x / a.y;
+		*v = (d.y > 0.0f ? d.z : -d.z) / a.y;
+	}
+	else
+	{
+		*face = d.z > 0.0f ? 4 : 5;
+		*u = (d.z > 0.0f ? d.x : -d.x) / a.z;
+		*v = -d.y / a.z;
+	}
+}
+
+// Bilinear fetch with GL_CLAMP_TO_EDGE behaviour, x and y in texel units
+static vec3 SampleBilinear(const float *texels, unsigned int width, unsigned int height, float x, float y)
+{
+	x = glm::clamp(x - 0.5f, 0.0f, float(width - 1));
+	y = glm::clamp(y - 0.5f, 0.0f, float(height - 1));
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < width ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < height ? y0 + 1 : y0;
+	float fx = x - float(x0);
+	float fy = y - float(y0);
+
+	const float *t00 = texels + 3 * (y0 * width + x0);
+	const float *t10 = texels + 3 * (y0 * width + x1);
+	const float *t01 = texels + 3 * (y1 * width + x0);
+	const float *t11 = texels + 3 * (y1 * width + x1);
+
+	vec3 result;
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		float top = t00[c] + (t10[c] - t00[c]) * fx;
+		float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+		result[c] = top + (bottom - top) * fy;
+	}
+	return result;
+}
+
+vec3 IBLBake::SampleCubemap(const CubemapImage &image, vec3 direction, unsigned int mip)
+{
+	unsigned int face;
+	float u, v;
+	DirectionToFace(direction, &face, &u, &v);
+
+	unsigned int mipSize = IBLBake::MipSize(image, mip);
+	const float *texels = image.faces[mip * NUMBER_OF_CUBE_FACES + face].data();
+	return SampleBilinear(texels, mipSize, mipSize, (u * 0.5f + 0.5f) * mipSize, (v * 0.5f + 0.5f) * mipSize);
+}
+
+vec3 IBLBake::SampleCubemapLod(const CubemapImage &image, vec3 direction, float lod)
+{
+	float maxLod = float(image.mipCount - 1);
+	lod = lod < 0.0f ? 0.0f : (lod > maxLod ? maxLod : lod);
+	unsigned int mip0 = (unsigned int)lod;
+	unsigned int mip1 = mip0 + 1 < image.mipCount ? mip0 + 1 : mip0;
+	float fraction = lod - float(mip0);
+
+	vec3 color0 = IBLBake::SampleCubemap(image, direction, mip0);
+	if (fraction == 0.0f || mip1 == mip0)
+		return color0;
+	return glm::mix(color0, IBLBake::SampleCubemap(image, direction, mip1), fraction);
+}
+
+void IBLBake::GenerateMips(CubemapImage *image, unsigned int threadCount)
+{
+	unsigned int mipCount = 1;
+	while ((image->size >> mipCount) > 0)
+		++mipCount;
+
+	image->mipCount = mipCount;
+	image->faces.resize(mipCount * NUMBER_OF_CUBE_FACES);
+	for (unsigned int mip = 1; mip < mipCount; ++mip)
+	{
+		unsigned int mipSize = IBLBake::MipSize(*image, mip);
+		unsigned int parentSize = IBLBake::MipSize(*image, mip - 1);
+		for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+			image->faces[mip * NUMBER_OF_CUBE_FACES + face].assign(mipSize * mipSize * 3, 0.0f);
+
+		Parallel::For(NUMBER_OF_CUBE_FACES * mipSize, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int row = begin; row < end; ++row)
+			{
+				unsigned int face = row / mipSize;
+				unsigned int y = row % mipSize;
+				const float *parent = image->faces[(mip - 1) * NUMBER_OF_CUBE_FACES + face].data();
+				float *texels = image->faces[mip * NUMBER_OF_CUBE_FACES + face].data() + 3 * y * mipSize;
+				for (unsigned int x = 0; x < mipSize; ++x)
+				{
+					const float *t00 = parent + 3 * ((2 * y) * parentSize + 2 * x);
+					const float *t01 = t00 + 3 * parentSize;
+					for (unsigned int c = 0; c < 3; ++c)
+						texels[3 * x + c] = 0.25f * (t00[c] + t00[c + 3] + t01[c] + t01[c + 3]);
+				}
+			}
+		}, threadCount);
+	}
+}
+
+void IBLBake::CubemapFromEquirect(const float *equirect, unsigned int width, unsigned int height, CubemapImage *cubemap,
+								  unsigned int size, unsigned int threadCount)
+{
+	IBLBake::InitCubemapImage(cubemap, size, 1);
+
+	Parallel::For(NUMBER_OF_CUBE_FACES * size, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int row = begin; row < end; ++row)
+		{
+			unsigned int face = row / size;
+			unsigned int y = row % size;
+			float *texels = cubemap->faces[face].data() + 3 * y * size;
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				float u = 2.0f * (float(x) + 0.5f) / float(size) - 1.0f;
+				float v = 2.0f * (float(y) + 0.5f) / float(size) - 1.0f;
+				vec3 d = glm::normalize(IBLBake::FaceDirection(face, u, v));
+
+				// Same mapping as EquirectToCubeMap.frag
+				float theta = atan2f(d.z, d.x);
+				float phi = acosf(glm::clamp(d.y, -1.0f, 1.0f));
+				float texV = 1.0f - (phi / PI);
+				float texU = theta / (2.0f * PI) + 0.5f;
+
+				vec3 color = SampleBilinear(equirect, width, height, texU * width, texV * height);
+				texels[3 * x + 0] = color.r;
+				texels[3 * x + 1] = color.g;
+				texels[3 * x + 2] = color.b;
+			}
+		}
+	}, threadCount);
+}
+
+// Quasi Monte Carlo sequence generation, identical to the one in the Env*.frag shaders
+// Source: http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+static float RadicalInverse_VdC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+// With V = R = N the reflected to-light vector only depends on the tangent space half-vector:
+// L = 2 * dot(N, H) * H - N, so the whole sample set can be generated once per roughness level.
+// environmentSize > 0 additionally stores the source mip of each sample for filtered importance sampling.
+static void BuildSampleTable(SampleTable *table, float roughness, unsigned int numSamples, unsigned int environmentSize = 0)
+{
+	float a = roughness * roughness;
+	float texelSolidAngle = environmentSize > 0 ? 4.0f * PI / (6.0f * float(environmentSize) * float(environmentSize)) : 0.0f;
+	for (unsigned int i = 0; i < numSamples; ++i)
+	{
+		float Xi_x = float(i) / float(numSamples);
+		float Xi_y = RadicalInverse_VdC(i);
+
+		float phi = 2.0f * PI * Xi_x;
+		float cosTheta = sqrtf((1.0f - Xi_y) / (1.0f + (a * a - 1.0f) * Xi_y));
+		float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+		vec3 H = vec3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+
+		float NdotL = 2.0f * H.z * H.z - 1.0f;
+		if (NdotL > 0.0f)
+		{
+			table->x.push_back(2.0f * H.z * H.x);
+			table->y.push_back(2.0f * H.z * H.y);
+			table->z.push_back(NdotL);
+			table->weight.push_back(NdotL);
+			table->totalWeight += NdotL;
+			if (environmentSize > 0)
+			{
+				// pdf(L) = D(NdotH) * NdotH / (4 * VdotH) = D / 4 since V = N, the +1 bias smooths the undersampling
+				// of the lobe tails (Colbert and Krivanek)
+				float lod = 0.0f;
+				if (a > 0.0f)
+				{
+					float a2 = a * a;
+					float denominator = H.z * H.z * (a2 - 1.0f) + 1.0f;
+					float D = a2 / (PI * denominator * denominator);
+					float sampleSolidAngle = 1.0f / (float(numSamples) * D * 0.25f);
+					lod = glm::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f);
+				}
+				table->lod.push_back(lod);
+			}
+		}
+	}
+
+	while (table->weight.size() % 4 != 0)
+	{
+		table->x.push_back(0.0f);
+		table->y.push_back(0.0f);
+		table->z.push_back(1.0f);
+		table->weight.push_back(0.0f);
+		if (environmentSize > 0)
+			table->lod.push_back(0.0f);
+	}
+}
+
+static vec3 PrefilterTexel(const CubemapImage &environment, const SampleTable &table, vec3 N)
+{
+	// Same tangent frame as ImportanceSampleGGX in EnvToPrefilteredEnv.frag
+	vec3 up = fabsf(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+	vec3 tangentX = glm::normalize(glm::cross(up, N));
+	vec3 tangentY = glm::normalize(glm::cross(N, tangentX));
+
+	vec3 prefilteredColor = vec3(0.0f);
+	unsigned int sampleCount = (unsigned int)table.weight.size();
+	for (unsigned int i = 0; i < sampleCount; i += 4)
+	{
+		float Lx[4], Ly[4], Lz[4];
+#ifdef IBL_USE_SSE2
+		__m128 x = _mm_loadu_ps(&table.x[i]);
+		__m128 y = _mm_loadu_ps(&table.y[i]);
+		__m128 z = _mm_loadu_ps(&table.z[i]);
+		_mm_storeu_ps(Lx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(tangentX.x)), _mm_mul_ps(y, _mm_set1_ps(tangentY.x))),
+									 _mm_mul_ps(z, _mm_set1_ps(N.x))));
+		_mm_storeu_ps(Ly, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(tangentX.y)), _mm_mul_ps(y, _mm_set1_ps(tangentY.y))),
+									 _mm_mul_ps(z, _mm_set1_ps(N.y))));
+		_mm_storeu_ps(Lz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(tangentX.z)), _mm_mul_ps(y, _mm_set1_ps(tangentY.z))),
+									 _mm_mul_ps(z, _mm_set1_ps(N.z))));
+#else
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			vec3 L = tangentX * table.x[i + lane] + tangentY * table.y[i + lane] + N * table.z[i + lane];
+			Lx[lane] = L.x;
+			Ly[lane] = L.y;
+			Lz[lane] = L.z;
+		}
+#endif
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			float weight = table.weight[i + lane];
+			if (weight <= 0.0f)
+				continue;
+
+			vec3 L = vec3(Lx[lane], Ly[lane], Lz[lane]);
+			if (table.lod.empty())
+				prefilteredColor += IBLBake::SampleCubemap(environment, L) * weight;
+			else
+				prefilteredColor += IBLBake::SampleCubemapLod(environment, L, table.lod[i + lane]) * weight;
+		}
+	}
+	return prefilteredColor / table.totalWeight;
+}
+
+void IBLBake::PrefilterMip(const CubemapImage &environment, CubemapImage *prefiltered, unsigned int mip, unsigned int numSamples,
+						   bool filteredImportanceSampling, unsigned int threadCount)
+{
+	unsigned int mipCount = prefiltered->mipCount;
+	float roughness = mipCount > 1 ? float(mip) / float(mipCount - 1) : 0.0f;
+	SampleTable table;
+	BuildSampleTable(&table, roughness, numSamples, filteredImportanceSampling ? environment.size : 0);
+
+	unsigned int mipSize = IBLBake::MipSize(*prefiltered, mip);
+	Parallel::For(NUMBER_OF_CUBE_FACES * mipSize, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int row = begin; row < end; ++row)
+		{
+			unsigned int face = row / mipSize;
+			unsigned int y = row % mipSize;
+			float *texels = prefiltered->faces[mip * NUMBER_OF_CUBE_FACES + face].data() + 3 * y * mipSize;
+			for (unsigned int x = 0; x < mipSize; ++x)
+			{
+				float u = 2.0f * (float(x) + 0.5f) / float(mipSize) - 1.0f;
+				float v = 2.0f * (float(y) + 0.5f) / float(mipSize) - 1.0f;
+				vec3 N = glm::normalize(IBLBake::FaceDirection(face, u, v));
+
+				vec3 color = PrefilterTexel(environment, table, N);
+				texels[3 * x + 0] = color.r;
+				texels[3 * x + 1] = color.g;
+				texels[3 * x + 2] = color.b;
+			}
+		}
+	}, threadCount);
+}
+
+void IBLBake::PrefilteredEnvMapFromCubemap(const CubemapImage &environment, CubemapImage *prefiltered, unsigned int size,
+										   unsigned int mipCount, unsigned int numSamples, unsigned int threadCount)
+{
+	IBLBake::InitCubemapImage(prefiltered, size, mipCount);
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+		IBLBake::PrefilterMip(environment, prefiltered, mip, numSamples, false, threadCount);
+}
+
+void IBLBake::PrefilteredEnvMapFromCubemap(const CubemapImage &environment, CubemapImage *prefiltered, const IBLBakeSettings &settings,
+										   unsigned int threadCount)
+{
+	IBLBake::InitCubemapImage(prefiltered, settings.prefilteredSize, settings.prefilteredMipLevels);
+	for (unsigned int mip = 0; mip < settings.prefilteredMipLevels; ++mip)
+	{
+		IBLBake::PrefilterMip(environment, prefiltered, mip, IBLBake::PrefilteredSampleCount(settings, mip),
+							  settings.filteredImportanceSampling, threadCount);
+	}
+}
+
+unsigned int IBLBake::PrefilteredSampleCount(const IBLBakeSettings &settings, unsigned int mip)
+{
+	if (!settings.filteredImportanceSampling || settings.prefilteredSampleCounts.empty())
+		return settings.prefilteredSamples;
+
+	size_t last = settings.prefilteredSampleCounts.size() - 1;
+	return settings.prefilteredSampleCounts[mip < last ? mip : last];
+}
+
+// Smith's method using Schlick-GGX with the IBL remapping k = a / 2
+static float G_Smith(float NdotV, float NdotL, float roughness)
+{
+	float k = roughness * roughness / 2.0f;
+	float GV = NdotV / (NdotV * (1.0f - k) + k);
+	float GL = NdotL / (NdotL * (1.0f - k) + k);
+	return GV * GL;
+}
+
+glm::vec2 IBLBake::IntegrateBRDF(float NdotV, float roughness, unsigned int numSamples)
+{
+	vec3 V = vec3(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV);
+	float a = roughness * roughness;
+
+	float F0_scale = 0.0f;
+	float F0_bias = 0.0f;
+	for (unsigned int i = 0; i < numSamples; ++i)
+	{
+		float Xi_x = float(i) / float(numSamples);
+		float Xi_y = RadicalInverse_VdC(i);
+
+		float phi = 2.0f * PI * Xi_x;
+		float cosTheta = sqrtf((1.0f - Xi_y) / (1.0f + (a * a - 1.0f) * Xi_y));
+		float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+		vec3 H = vec3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+		vec3 L = glm::normalize(2.0f * glm::dot(V, H) * H - V);
+
+		float NdotL = glm::clamp(L.z, 0.0f, 1.0f);
+		float NdotH = glm::clamp(H.z, 0.0f, 1.0f);
+		float VdotH = glm::clamp(glm::dot(V, H), 0.0f, 1.0f);
+		if (NdotL > 0.0f)
+		{
+			float G = G_Smith(NdotV, NdotL, roughness);
+			float G_Vis = G * VdotH / (NdotH * NdotV);
+			float Fc = powf(1.0f - VdotH, 5.0f);
+
+			F0_scale += G_Vis * (1.0f - Fc);
+			F0_bias += G_Vis * Fc;
+		}
+	}
+	return glm::vec2(F0_scale, F0_bias) / float(numSamples);
+}
+
+void IBLBake::IntegratedBRDFLUT(vector<glm::vec2> *lut, unsigned int size, unsigned int numSamples, unsigned int threadCount)
+{
+	lut->assign(size * size, glm::vec2(0.0f));
+	Parallel::For(size, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int y = begin; y < end; ++y)
+		{
+			float roughness = (float(y) + 0.5f) / float(size);
+			for (unsigned int x = 0; x < size; ++x)
+				(*lut)[y * size + x] = IBLBake::IntegrateBRDF((float(x) + 0.5f) / float(size), roughness, numSamples);
+		}
+	}, threadCount);
+}
+
+static const unsigned int SH_COEFFICIENT_COUNT = 9;
+
+// Real spherical harmonics basis up to l = 2
+static void SHBasis(vec3 d, float *basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * d.y;
+	basis[2] = 0.488603f * d.z;
+	basis[3] = 0.488603f * d.x;
+	basis[4] = 1.092548f * d.x * d.y;
+	basis[5] = 1.092548f * d.y * d.z;
+	basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+	basis[7] = 1.092548f * d.x * d.z;
+	basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+void IBLBake::IrradianceMapFromCubemap(const CubemapImage &environment, CubemapImage *irradiance, unsigned int size, float sampleStep,
+									 unsigned int threadCount)
+{
+	IBLBake::InitCubemapImage(irradiance, size, 1);
+
+	// Same Riemann sum as EnvToIrradiance.frag, the tangent space directions and their cos * sin weights are the
+	// same for every texel
+	int polarSteps = int(ceilf(0.5f * PI / sampleStep));
+	int azimuthSteps = int(ceilf(2.0f * PI / sampleStep));
+	vector<vec3> tangentDirs(polarSteps * azimuthSteps);
+	vector<float> weights(polarSteps * azimuthSteps);
+	for (int i = 0; i < polarSteps * azimuthSteps; ++i)
+	{
+		float polar = float(i / azimuthSteps) * sampleStep;
+		float azimuth = float(i % azimuthSteps) * sampleStep;
+		tangentDirs[i] = vec3(sinf(polar) * cosf(azimuth), sinf(polar) * sinf(azimuth), cosf(polar));
+		weights[i] = cosf(polar) * sinf(polar);
+	}
+
+	// Like the implicit level of detail of the shader's texture fetches, the samples read the environment mip whose
+	// texels are about as far apart as they are (a face spans PI / 2), which keeps that mip in the caches
+	unsigned int mip = 0;
+	while (mip + 1 < environment.mipCount && 0.5f * PI / float(IBLBake::MipSize(environment, mip + 1)) <= sampleStep)
+		++mip;
+
+	Parallel::For(NUMBER_OF_CUBE_FACES * size, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int row = begin; row < end; ++row)
+		{
+			unsigned int face = row / size;
+			unsigned int y = row % size;
+			float *texels = irradiance->faces[face].data() + 3 * y * size;
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				float u = 2.0f * (float(x) + 0.5f) / float(size) - 1.0f;
+				float v = 2.0f * (float(y) + 0.5f) / float(size) - 1.0f;
+				vec3 N = glm::normalize(IBLBake::FaceDirection(face, u, v));
+				vec3 left = glm::normalize(glm::cross(vec3(0.0f, 1.0f, 0.0f), N));
+				vec3 up = glm::normalize(glm::cross(N, left));
+
+				vec3 color(0.0f);
+				for (unsigned int i = 0; i < tangentDirs.size(); ++i)
+				{
+					vec3 sampleDir = tangentDirs[i].x * left + tangentDirs[i].y * up + tangentDirs[i].z * N;
+					color += IBLBake::SampleCubemap(environment, sampleDir, mip) * weights[i];
+				}
+				color *= PI / float(tangentDirs.size());
+				texels[3 * x + 0] = color.r;
+				texels[3 * x + 1] = color.g;
+				texels[3 * x + 2] = color.b;
+			}
+		}
+	}, threadCount);
+}
+
+// Projects the radiance of the environment onto the SH basis (one partial sum per texel row, reduced afterwards)
+// and convolves it with the clamped cosine lobe, see Ramamoorthi and Hanrahan, "An Efficient Representation for
+// Irradiance Environment Maps".
+void IBLBake::ProjectIrradianceSH(const CubemapImage &environment, SHIrradiance *irradiance, unsigned int threadCount)
+{
+	unsigned int size = environment.size;
+	unsigned int rowCount = NUMBER_OF_CUBE_FACES * size;
+	vector<vec3> rowSums(rowCount * SH_COEFFICIENT_COUNT, vec3(0.0f));
+	vector<float> rowSolidAngles(rowCount, 0.0f);
+
+	Parallel::For(rowCount, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int row = begin; row < end; ++row)
+		{
+			unsigned int face = row / size;
+			unsigned int y = row % size;
+			const float *texels = environment.faces[face].data() + 3 * y * size;
+			vec3 *sums = &rowSums[row * SH_COEFFICIENT_COUNT];
+			for (unsigned int x = 0; x < size; ++x)
+			{
+				float u = 2.0f * (float(x) + 0.5f) / float(size) - 1.0f;
+				float v = 2.0f * (float(y) + 0.5f) / float(size) - 1.0f;
+				float distanceSquared = 1.0f + u * u + v * v;
+				float solidAngle = 4.0f / (float(size * size) * distanceSquared * sqrtf(distanceSquared));
+				vec3 d = glm::normalize(IBLBake::FaceDirection(face, u, v));
+
+				float basis[SH_COEFFICIENT_COUNT];
+				SHBasis(d, basis);
+				vec3 radiance = vec3(texels[3 * x + 0], texels[3 * x + 1], texels[3 * x + 2]) * solidAngle;
+				for (unsigned int i = 0; i < SH_COEFFICIENT_COUNT; ++i)
+					sums[i] += radiance * basis[i];
+				rowSolidAngles[row] += solidAngle;
+			}
+		}
+	}, threadCount);
+
+	vec3 radianceSH[SH_COEFFICIENT_COUNT];
+	float totalSolidAngle = 0.0f;
+	for (unsigned int i = 0; i < SH_COEFFICIENT_COUNT; ++i)
+		radianceSH[i] = vec3(0.0f);
+	for (unsigned int row = 0; row < rowCount; ++row)
+	{
+		for (unsigned int i = 0; i < SH_COEFFICIENT_COUNT; ++i)
+			radianceSH[i] += rowSums[row * SH_COEFFICIENT_COUNT + i];
+		totalSolidAngle += rowSolidAngles[row];
+	}
+
+	// Cosine lobe convolution (A0 = PI, A1 = 2PI/3, A2 = PI/4) divided by PI like EnvToIrradiance.frag's output,
+	// the texel solid angles are renormalized so that they sum up to exactly 4PI
+	const float bandScale[SH_COEFFICIENT_COUNT] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	const float basisConstant[SH_COEFFICIENT_COUNT] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+	float normalization = 4.0f * PI / totalSolidAngle;
+	for (unsigned int i = 0; i < SH_COEFFICIENT_COUNT; ++i)
+		irradiance->coefficients[i] = radianceSH[i] * normalization * bandScale[i] * basisConstant[i];
+}
+
+// Same polynomial as EvaluateSHIrradiance in PBR.frag
+vec3 IBLBake::EvaluateIrradianceSH(const SHIrradiance &irradiance, vec3 n)
+{
+	const vec3 *c = irradiance.coefficients;
+	vec3 result = c[0] + c[1] * n.y + c[2] * n.z + c[3] * n.x + c[4] * (n.x * n.y) + c[5] * (n.y * n.z) +
+				  c[6] * (3.0f * n.z * n.z - 1.0f) + c[7] * (n.x * n.z) + c[8] * (n.x * n.x - n.y * n.y);
+	return glm::max(result, vec3(0.0f));
+}
+
+ImageError IBLBake::CompareIrradianceSH(const SHIrradiance &irradiance, const CubemapImage &irradianceMap)
+{
+	CubemapImage evaluated;
+	IBLBake::InitCubemapImage(&evaluated, irradianceMap.size, 1);
+	for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+	{
+		float *texels = evaluated.faces[face].data();
+		for (unsigned int y = 0; y < evaluated.size; ++y)
+		{
+			for (unsigned int x = 0; x < evaluated.size; ++x)
+			{
+				float u = 2.0f * (float(x) + 0.5f) / float(evaluated.size) - 1.0f;
+				float v = 2.0f * (float(y) + 0.5f) / float(evaluated.size) - 1.0f;
+				vec3 color = IBLBake::EvaluateIrradianceSH(irradiance, glm::normalize(IBLBake::FaceDirection(face, u, v)));
+				unsigned int index = 3 * (y * evaluated.size + x);
+				texels[index + 0] = color.r;
+				texels[index + 1] = color.g;
+				texels[index + 2] = color.b;
+			}
+		}
+	}
+	return IBLBake::Compare(evaluated, irradianceMap, 0);
+}
+
+ImageError IBLBake::Compare(const CubemapImage &a, const CubemapImage &b, unsigned int mip)
+{
+	ImageError error = {};
+	if (a.size != b.size || mip >= a.mipCount || mip >= b.mipCount)
+	{
+		std::cerr << "ERROR: Compared cubemaps have a different layout.\n";
+		error.rmse = error.maxError = 1.0;
+		return error;
+	}
+
+	double squaredSum = 0.0;
+	size_t count = 0;
+	for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+	{
+		const vector<float> &texelsA = a.faces[mip * NUMBER_OF_CUBE_FACES + face];
+		const vector<float> &texelsB = b.faces[mip * NUMBER_OF_CUBE_FACES + face];
+		for (size_t i = 0; i < texelsA.size(); ++i)
+		{
+			double mappedA = texelsA[i] / (1.0 + texelsA[i]);
+			double mappedB = texelsB[i] / (1.0 + texelsB[i]);
+			double difference = fabs(mappedA - mappedB);
+			squaredSum += difference * difference;
+			error.maxError = difference > error.maxError ? difference : error.maxError;
+		}
+		count += texelsA.size();
+	}
+	error.rmse = count > 0 ? sqrt(squaredSum / double(count)) : 0.0;
+	return error;
+}
+
+ImageError IBLBake::Compare(const CubemapImage &a, const CubemapImage &b)
+{
+	ImageError total = {};
+	unsigned int mipCount = a.mipCount < b.mipCount ? a.mipCount : b.mipCount;
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+	{
+		ImageError error = IBLBake::Compare(a, b, mip);
+		total.rmse = error.rmse > total.rmse ? error.rmse : total.rmse;
+		total.maxError = error.maxError > total.maxError ? error.maxError : total.maxError;
+	}
+	return total;
+}
+
+ImageError IBLBake::CompareResampled(const CubemapImage &image, const CubemapImage &reference)
+{
+	ImageError total = {};
+	unsigned int mipCount = image.mipCount < reference.mipCount ? image.mipCount : reference.mipCount;
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+	{
+		unsigned int mipSize = IBLBake::MipSize(image, mip);
+		double squaredSum = 0.0;
+		size_t count = 0;
+		for (unsigned int face = 0; face < NUMBER_OF_CUBE_FACES; ++face)
+		{
+			const vector<float> &texels = image.faces[mip * NUMBER_OF_CUBE_FACES + face];
+			for (unsigned int y = 0; y < mipSize; ++y)
+			{
+				for (unsigned int x = 0; x < mipSize; ++x)
+				{
+					float u = 2.0f * (float(x) + 0.5f) / float(mipSize) - 1.0f;
+					float v = 2.0f * (float(y) + 0.5f) / float(mipSize) - 1.0f;
+					vec3 referenceColor = IBLBake::SampleCubemap(reference, glm::normalize(IBLBake::FaceDirection(face, u, v)), mip);
+					for (unsigned int c = 0; c < 3; ++c)
+					{
+						double value = texels[3 * (y * mipSize + x) + c];
+						double mapped = value / (1.0 + value);
+						double mappedReference = referenceColor[c] / (1.0 + referenceColor[c]);
+						double difference = fabs(mapped - mappedReference);
+						squaredSum += difference * difference;
+						total.maxError = difference > total.maxError ? difference : total.maxError;
+					}
+					count += 3;
+				}
+			}
+		}
+		double rmse = count > 0 ? sqrt(squaredSum / double(count)) : 0.0;
+		total.rmse = rmse > total.rmse ? rmse : total.rmse;
+	}
+	return total;
+}
+
+IBLBakeSettings IBLBake::SettingsForTier(IBLQuality::Tier tier)
+{
+	IBLBakeSettings settings;
+	switch (tier)
+	{
+		case IBLQuality::Draft:
+			settings.environmentSize = 256;
+			settings.irradianceSize = 16;
+			settings.irradianceSampleStep = 0.05f;
+			settings.prefilteredSize = 64;
+			settings.prefilteredSamples = 256;
+			settings.prefilteredSampleCounts = { 1, 16, 32, 64, 128 };
+			break;
+		case IBLQuality::Production:
+			settings.environmentSize = 1024;
+			settings.irradianceSize = 32;
+			// Smaller steps need more than 65535 loop iterations per texel, which Mesa's llvmpipe silently cuts off
+			settings.irradianceSampleStep = 0.0125f;
+			settings.prefilteredSize = 256;
+			settings.prefilteredSamples = 4096;
+			settings.prefilteredSampleCounts = { 1, 256, 512, 1024, 2048 };
+			break;
+		default:
+			break;
+	}
+	return settings;
+}
+
+const char *IBLBake::TierName(IBLQuality::Tier tier)
+{
+	switch (tier)
+	{
+		case IBLQuality::Draft:
+			return "Draft";
+		case IBLQuality::Production:
+			return "Production";
+		default:
+			return "Interactive";
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// RGB float cubemap kept in system memory so that it can be baked without a GL context.
+// Faces follow the GL order +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
+// and rows are stored the way glTexImage2D expects them (first row is t = 0).
+struct CubemapImage
+{
+	unsigned int size = 0;						// Edge length of mip 0
+	unsigned int mipCount = 0;
+	std::vector<std::vector<float>> faces;		// Indexed [mip * 6 + face]
+};
+
+// Parameters of the image based lighting precomputation. The shaders receive them as uniforms, the Riemann sum step
+// of EnvToIrradiance as the RIEMANN_SUM_STEP define. The defaults are the interactive quality tier.
+struct IBLBakeSettings
+{
+	unsigned int environmentSize = 512;
+	unsigned int irradianceSize = 32;
+	float irradianceSampleStep = 0.015f;
+	unsigned int prefilteredSize = 128;
+	unsigned int prefilteredMipLevels = 5;
+	unsigned int prefilteredSamples = 1024;
+	// Filtered importance sampling reads every sample from the environment mip whose texel footprint matches the
+	// solid angle of the sample (GPU Gems 3, chapter 20). That removes the fireflies of low sample counts, so each
+	// roughness level only takes as many samples as its lobe needs. The last entry is used for any further mips.
+	bool filteredImportanceSampling = true;
+	std::vector<unsigned int> prefilteredSampleCounts = { 1, 64, 128, 256, 512 };
+};
+
+// Named presets of IBLBakeSettings. All tiers keep the same number of prefiltered mips, so a mip has the same
+// roughness in every tier and the tiers can be compared against each other mip by mip.
+namespace IBLQuality
+{
+	enum Tier
+	{
+		Draft,
+		Interactive,
+		Production,
+		TierCount
+	};
+}
+
+// Order 2 (9 coefficient) spherical harmonics irradiance. The coefficients already include the cosine lobe
+// convolution and the basis function constants, so evaluating the polynomial in the normal gives the same value
+// as a texel of the irradiance cubemap (irradiance / PI).
+struct SHIrradiance
+{
+	glm::vec3 coefficients[9];
+};
+
+// Differences are measured on Reinhard tone mapped values (like PBR.frag and SkyBox.frag display them)
+// so that bright texels of an HDR map do not dominate the error.
+struct ImageError
+{
+	double rmse = 0.0;
+	double maxError = 0.0;
+};
+
+namespace IBLBake
+{
+	void InitCubemapImage(CubemapImage *image, unsigned int size, unsigned int mipCount);
+	unsigned int MipSize(const CubemapImage &image, unsigned int mip);
+
+	// u, v in [-1, 1] across the face
+	glm::vec3 FaceDirection(unsigned int face, float u, float v);
+	glm::vec3 SampleCubemap(const CubemapImage &image, glm::vec3 direction, unsigned int mip = 0);
+	// Trilinear, the level of detail is clamped to the available mips
+	glm::vec3 SampleCubemapLod(const CubemapImage &image, glm::vec3 direction, float lod);
+	// Box filtered mip chain down to 1x1 (like glGenerateMipmap), replaces any existing mips
+	void GenerateMips(CubemapImage *image, unsigned int threadCount = 0);
+
+	// CPU versions of EquirectToCubeMap.frag, EnvToIrradiance.frag and EnvToPrefilteredEnv.frag. The equirectangular data is expected
+	// to be RGB and flipped vertically (stbi_set_flip_vertically_on_load(true)) like InitHDRTexture loads it.
+	void CubemapFromEquirect(const float *equirect, unsigned int width, unsigned int height, CubemapImage *cubemap,
+							 unsigned int size, unsigned int threadCount = 0);
+	// sampleStep is the Riemann sum step of IBLBakeSettings::irradianceSampleStep, an environment with mips is sampled at
+	// a lower resolution (see GenerateMips)
+	void IrradianceMapFromCubemap(const CubemapImage &environment, CubemapImage *irradiance, unsigned int size, float sampleStep,
+								  unsigned int threadCount = 0);
+	void PrefilteredEnvMapFromCubemap(const CubemapImage &environment, CubemapImage *prefiltered, unsigned int size,
+									  unsigned int mipCount, unsigned int numSamples, unsigned int threadCount = 0);
+	// Uses the per mip sample counts and the sampling mode of the settings. Filtered importance sampling needs the
+	// environment with its mip chain (see GenerateMips).
+	void PrefilteredEnvMapFromCubemap(const CubemapImage &environment, CubemapImage *prefiltered, const IBLBakeSettings &settings,
+									  unsigned int threadCount = 0);
+	// Bakes a single roughness level into an already initialized prefiltered image
+	void PrefilterMip(const CubemapImage &environment, CubemapImage *prefiltered, unsigned int mip, unsigned int numSamples,
+					  bool filteredImportanceSampling, unsigned int threadCount = 0);
+	unsigned int PrefilteredSampleCount(const IBLBakeSettings &settings, unsigned int mip);
+
+	void ProjectIrradianceSH(const CubemapImage &environment, SHIrradiance *irradiance, unsigned int threadCount = 0);
+	glm::vec3 EvaluateIrradianceSH(const SHIrradiance &irradiance, glm::vec3 normal);
+	ImageError CompareIrradianceSH(const SHIrradiance &irradiance, const CubemapImage &irradianceMap);
+
+	// Importance sampled split sum BRDF integral (Karis, "Real Shading in Unreal Engine 4"), returns the (scale, bias)
+	// applied to F0.
+	// The LUT is size x size RG, rows go from roughness 0 to 1 and columns from NdotV 0 to 1 (texel centers).
+	glm::vec2 IntegrateBRDF(float NdotV, float roughness, unsigned int numSamples);
+	void IntegratedBRDFLUT(std::vector<glm::vec2> *lut, unsigned int size, unsigned int numSamples, unsigned int threadCount = 0);
+
+	ImageError Compare(const CubemapImage &a, const CubemapImage &b, unsigned int mip);
+	ImageError Compare(const CubemapImage &a, const CubemapImage &b);
+	// Samples the reference (bilinearly, same mip) in the texel directions of the image, so that bakes of different
+	// resolutions can be compared. Like Compare, returns the worst mip.
+	ImageError CompareResampled(const CubemapImage &image, const CubemapImage &reference);
+
+	IBLBakeSettings SettingsForTier(IBLQuality::Tier tier);
+	const char *TierName(IBLQuality::Tier tier);
+}
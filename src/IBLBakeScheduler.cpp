@@ -0,0 +1,207 @@
+#include "IBLBakeScheduler.h"
+
+// Weight of a new measurement in the running unit cost estimate
+static const float COST_SMOOTHING = 0.5f;
+
+static IBLBakeJob *FindJob(IBLBakeScheduler *scheduler, unsigned int id)
+{
+	for (unsigned int i = 0; i < scheduler->jobs.size(); ++i)
+	{
+		if (scheduler->jobs[i].id == id)
+			return &scheduler->jobs[i];
+	}
+	return nullptr;
+}
+
+static IBLBakeUnit UnitAt(const IBLBakeJob &job, unsigned int index)
+{
+	IBLBakeUnit unit;
+	unit.mip = index % job.mipCount;
+	unit.batch = index / job.mipCount;
+	return unit;
+}
+
+static void ReadBackQueries(IBLBakeScheduler *scheduler)
+{
+	unsigned int measuredFrame = 0;
+	float measuredFrameMs = 0.0f;
+	while (!scheduler->pendingQueries.empty())
+	{
+		IBLBakeTimerQuery pending = scheduler->pendingQueries.front();
+		GLint available = 0;
+		glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsed);
+		float elapsedMs = float(double(elapsed) / 1.0e6);
+		scheduler->pendingQueries.pop_front();
+		scheduler->freeQueries.push_back(pending.query);
+
+		IBLBakeJob *job = FindJob(scheduler, pending.jobId);
+		if (job)
+		{
+			float &cost = job->unitCostMs[pending.mip];
+			cost = cost < 0.0f ? elapsedMs : cost + (elapsedMs - cost) * COST_SMOOTHING;
+		}
+
+		if (pending.frame != measuredFrame)
+		{
+			measuredFrame = pending.frame;
+			measuredFrameMs = 0.0f;
+		}
+		measuredFrameMs += elapsedMs;
+	}
+	if (measuredFrame != 0)
+		scheduler->lastMeasuredFrameMs = measuredFrameMs;
+}
+
+// Issues the next unit of the front job, returns false when the job has no units left
+static bool RunUnit(IBLBakeScheduler *scheduler, IBLBakeJob *job, bool timed)
+{
+	if (job->nextUnit >= job->mipCount * job->batchCount)
+		return false;
+
+	IBLBakeUnit unit = UnitAt(*job, job->nextUnit);
+	GLuint query = 0;
+	if (timed)
+	{
+		if (scheduler->freeQueries.empty())
+			glGenQueries(1, &query);
+		else
+		{
+			query = scheduler->freeQueries.back();
+			scheduler->freeQueries.pop_back();
+		}
+		glBeginQuery(GL_TIME_ELAPSED, query);
+	}
+
+	bool issuedWork = job->bakeUnit(unit);
+
+	if (timed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		if (issuedWork)
+		{
+			IBLBakeTimerQuery pending;
+			pending.query = query;
+			pending.jobId = job->id;
+			pending.mip = unit.mip;
+			pending.frame = scheduler->frame;
+			scheduler->pendingQueries.push_back(pending);
+		}
+		else
+		{
+			scheduler->freeQueries.push_back(query);
+		}
+	}
+
+	++job->nextUnit;
+	++scheduler->completedUnits;
+	return true;
+}
+
+static void FinishFrontJob(IBLBakeScheduler *scheduler)
+{
+	IBLBakeJob job = scheduler->jobs.front();
+	scheduler->jobs.pop_front();
+	if (job.finish)
+		job.finish();
+}
+
+void IBLBakeSchedulerControl::Add(IBLBakeScheduler *scheduler, IBLBakeJob job)
+{
+	job.id = scheduler->nextJobId++;
+	job.nextUnit = 0;
+	job.unitCostMs.assign(job.mipCount, -1.0f);
+	scheduler->totalUnits += job.mipCount * job.batchCount;
+	scheduler->jobs.push_back(job);
+}
+
+// Always issues at least one unit per frame. A unit of unknown cost is only issued first in a frame, so that its
+// measurement cannot push an already filled frame over the budget.
+void IBLBakeSchedulerControl::Update(IBLBakeScheduler *scheduler)
+{
+	++scheduler->frame;
+	ReadBackQueries(scheduler);
+
+	float spentMs = 0.0f;
+	unsigned int issuedUnits = 0;
+	while (!scheduler->jobs.empty())
+	{
+		IBLBakeJob *job = &scheduler->jobs.front();
+		if (job->nextUnit >= job->mipCount * job->batchCount)
+		{
+			FinishFrontJob(scheduler);
+			continue;
+		}
+
+		float cost = job->unitCostMs[UnitAt(*job, job->nextUnit).mip];
+		if (issuedUnits > 0 && (cost < 0.0f || spentMs + cost > scheduler->frameBudgetMs))
+			break;
+
+		RunUnit(scheduler, job, true);
+		spentMs += cost < 0.0f ? 0.0f : cost;
+		++issuedUnits;
+	}
+
+	if (scheduler->jobs.empty())
+		scheduler->completedUnits = scheduler->totalUnits = 0;
+	scheduler->lastFrameUnits = issuedUnits;
+	scheduler->lastFrameEstimateMs = spentMs;
+}
+
+void IBLBakeSchedulerControl::Flush(IBLBakeScheduler *scheduler)
+{
+	while (!scheduler->jobs.empty())
+	{
+		while (RunUnit(scheduler, &scheduler->jobs.front(), false))
+			;
+		FinishFrontJob(scheduler);
+	}
+	scheduler->completedUnits = scheduler->totalUnits = 0;
+}
+
+// Pending timer queries of a cancelled job are still read back, their job lookup just fails
+void IBLBakeSchedulerControl::Cancel(IBLBakeScheduler *scheduler, const std::string &name)
+{
+	for (unsigned int i = 0; i < scheduler->jobs.size();)
+	{
+		IBLBakeJob *job = &scheduler->jobs[i];
+		if (job->name != name)
+		{
+			++i;
+			continue;
+		}
+		unsigned int remainingUnits = job->mipCount * job->batchCount - job->nextUnit;
+		scheduler->totalUnits -= remainingUnits + job->nextUnit;
+		scheduler->completedUnits -= job->nextUnit;
+		scheduler->jobs.erase(scheduler->jobs.begin() + i);
+	}
+	if (scheduler->jobs.empty())
+		scheduler->completedUnits = scheduler->totalUnits = 0;
+}
+
+bool IBLBakeSchedulerControl::IsIdle(const IBLBakeScheduler &scheduler)
+{
+	return scheduler.jobs.empty();
+}
+
+float IBLBakeSchedulerControl::Progress(const IBLBakeScheduler &scheduler)
+{
+	return scheduler.totalUnits > 0 ? float(scheduler.completedUnits) / float(scheduler.totalUnits) : 1.0f;
+}
+
+void IBLBakeSchedulerControl::Release(IBLBakeScheduler *scheduler)
+{
+	for (unsigned int i = 0; i < scheduler->pendingQueries.size(); ++i)
+		glDeleteQueries(1, &scheduler->pendingQueries[i].query);
+	if (!scheduler->freeQueries.empty())
+		glDeleteQueries((GLsizei)scheduler->freeQueries.size(), scheduler->freeQueries.data());
+
+	scheduler->jobs.clear();
+	scheduler->pendingQueries.clear();
+	scheduler->freeQueries.clear();
+	scheduler->completedUnits = scheduler->totalUnits = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <glad/glad.h>
+
+// One slice of a progressive bake: a single sample batch of a single mip level
+struct IBLBakeUnit
+{
+	unsigned int mip = 0;
+	unsigned int batch = 0;
+};
+
+// A progressive bake of one texture. Units are issued batch by batch over all mips, so every mip receives a coarse
+// result after the first mipCount units and then converges. bakeUnit returns false if the unit had no GPU work.
+struct IBLBakeJob
+{
+	std::string name;
+	unsigned int mipCount = 1;
+	unsigned int batchCount = 1;
+	std::function<bool(IBLBakeUnit)> bakeUnit;
+	std::function<void()> finish;
+
+	unsigned int id = 0;
+	unsigned int nextUnit = 0;
+	std::vector<float> unitCostMs;		// Measured GPU cost per mip, negative until known
+};
+
+struct IBLBakeTimerQuery
+{
+	GLuint query = 0;
+	unsigned int jobId = 0;
+	unsigned int mip = 0;
+	unsigned int frame = 0;
+};
+
+// Runs queued bake jobs in slices that fit into a per frame GPU time budget. The cost of every unit is measured
+// with GL_TIME_ELAPSED queries that are read back a few frames later without stalling.
+struct IBLBakeScheduler
+{
+	float frameBudgetMs = 2.0f;
+	unsigned int sampleBatches = 16;		// Number of interleaved sample batches a bake is split into
+
+	std::deque<IBLBakeJob> jobs;
+	std::deque<IBLBakeTimerQuery> pendingQueries;
+	std::vector<GLuint> freeQueries;
+	unsigned int nextJobId = 1;
+	unsigned int frame = 0;
+
+	// Stats
+	unsigned int completedUnits = 0;
+	unsigned int totalUnits = 0;
+	unsigned int lastFrameUnits = 0;
+	float lastFrameEstimateMs = 0.0f;		// Estimated GPU cost of the units issued in the last frame
+	float lastMeasuredFrameMs = 0.0f;		// Measured GPU cost of the most recent frame whose queries are available
+};
+
+namespace IBLBakeSchedulerControl
+{
+	void Add(IBLBakeScheduler *scheduler, IBLBakeJob job);
+	void Update(IBLBakeScheduler *scheduler);
+	// Runs all queued work without a budget, e.g. when the results are needed right away or before shutting down
+	void Flush(IBLBakeScheduler *scheduler);
+	// Drops the queued job with the given name without calling its finish callback
+	void Cancel(IBLBakeScheduler *scheduler, const std::string &name);
+	bool IsIdle(const IBLBakeScheduler &scheduler);
+	float Progress(const IBLBakeScheduler &scheduler);
+	void Release(IBLBakeScheduler *scheduler);
+}
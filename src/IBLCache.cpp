@@ -0,0 +1,162 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include "IBLCache.h"
+#include "IBLBake.h"
+#include "Graphics.h"
+#include "TextureFile.h"
+#include "IOUtil.h"
+
+// FNV-1a
+static const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t HASH_PRIME = 1099511628211ull;
+
+static uint64_t Hash(const void *data, size_t size, uint64_t hash)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= HASH_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t HashSettings(const IBLBakeSettings &settings, uint64_t hash)
+{
+	// Field by field so that struct padding never ends up in the key
+	hash = Hash(&settings.environmentSize, sizeof(settings.environmentSize), hash);
+	hash = Hash(&settings.irradianceSize, sizeof(settings.irradianceSize), hash);
+	hash = Hash(&settings.irradianceSampleStep, sizeof(settings.irradianceSampleStep), hash);
+	hash = Hash(&settings.prefilteredSize, sizeof(settings.prefilteredSize), hash);
+	hash = Hash(&settings.prefilteredMipLevels, sizeof(settings.prefilteredMipLevels), hash);
+	hash = Hash(&settings.prefilteredSamples, sizeof(settings.prefilteredSamples), hash);
+	hash = Hash(&settings.filteredImportanceSampling, sizeof(settings.filteredImportanceSampling), hash);
+	hash = Hash(settings.prefilteredSampleCounts.data(), settings.prefilteredSampleCounts.size() * sizeof(unsigned int), hash);
+	return hash;
+}
+
+static std::string EntryPath(IBLCache *cache, uint64_t key, const char *product)
+{
+	std::ostringstream path;
+	path << cache->directory << std::hex << std::setw(16) << std::setfill('0') << key << "_" << product << ".tex";
+	return path.str();
+}
+
+void IBLCacheControl::Init(IBLCache *cache, const std::string &directory, const std::string &bakePath, const std::vector<std::string> &shaderFiles)
+{
+	cache->directory = directory;
+	cache->hits = 0;
+	cache->misses = 0;
+	if (cache->enabled)
+		cache->enabled = IOUtil::MakeDirectory(directory.c_str());
+
+	cache->shaderHash = Hash(bakePath.data(), bakePath.size(), HASH_OFFSET_BASIS);
+	for (unsigned int i = 0; i < shaderFiles.size(); ++i)
+	{
+		std::vector<uint8_t> source;
+		if (IOUtil::ReadBinaryFile(shaderFiles[i].c_str(), &source))
+			cache->shaderHash = Hash(source.data(), source.size(), cache->shaderHash);
+	}
+}
+
+// Returns 0 if the HDR file cannot be read, such a key never hits
+uint64_t IBLCacheControl::EnvironmentKey(IBLCache *cache, const char *hdrFile, const IBLBakeSettings &settings)
+{
+	std::vector<uint8_t> fileData;
+	if (!cache->enabled || !IOUtil::ReadBinaryFile(hdrFile, &fileData))
+		return 0;
+
+	uint64_t hash = Hash(fileData.data(), fileData.size(), cache->shaderHash);
+	return HashSettings(settings, hash);
+}
+
+bool IBLCacheControl::Contains(IBLCache *cache, uint64_t key, const char *product)
+{
+	return key != 0 && IOUtil::FileExists(EntryPath(cache, key, product).c_str());
+}
+
+bool IBLCacheControl::Load(IBLCache *cache, uint64_t key, const char *product, Texture *texture)
+{
+	TextureData data;
+	if (key == 0 || !TextureFile::Read(EntryPath(cache, key, product).c_str(), &data))
+	{
+		++cache->misses;
+		return false;
+	}
+
+	Graphics::InitTexture(texture, data);
+	++cache->hits;
+	return true;
+}
+
+void IBLCacheControl::Store(IBLCache *cache, uint64_t key, const char *product, Texture *texture)
+{
+	if (key == 0)
+		return;
+
+	TextureData data;
+	Graphics::ReadTexture(texture, &data);
+	if (data.mipCount > 0)
+		TextureFile::Write(EntryPath(cache, key, product).c_str(), data);
+}
+
+bool IBLCacheControl::LoadIrradianceSH(IBLCache *cache, uint64_t key, SHIrradiance *irradiance)
+{
+	TextureData data;
+	if (key == 0 || !TextureFile::Read(EntryPath(cache, key, "irradianceSH").c_str(), &data))
+	{
+		++cache->misses;
+		return false;
+	}
+
+	std::vector<TextureLevelView> levels(data.levels.size());
+	for (unsigned int i = 0; i < data.levels.size(); ++i)
+	{
+		levels[i].data = data.levels[i].data();
+		levels[i].size = data.levels[i].size();
+	}
+	if (!IrradianceSHFromTexture(data, levels, irradiance))
+	{
+		++cache->misses;
+		return false;
+	}
+	++cache->hits;
+	return true;
+}
+
+void IBLCacheControl::StoreIrradianceSH(IBLCache *cache, uint64_t key, const SHIrradiance &irradiance)
+{
+	if (key == 0)
+		return;
+
+	TextureData data;
+	IrradianceSHToTexture(irradiance, &data);
+	TextureFile::Write(EntryPath(cache, key, "irradianceSH").c_str(), data);
+}
+
+void IBLCacheControl::IrradianceSHToTexture(const SHIrradiance &irradiance, TextureData *data)
+{
+	*data = TextureData();
+	data->target = TextureTarget::Texture2D;
+	data->internalFormat = GL_RGB32F;
+	data->format = GL_RGB;
+	data->type = GL_FLOAT;
+	data->width = ARRAYSIZE(irradiance.coefficients);
+	data->height = 1;
+	data->mipCount = 1;
+	data->levels.resize(1);
+	data->levels[0].resize(sizeof(irradiance.coefficients));
+	memcpy(data->levels[0].data(), irradiance.coefficients, sizeof(irradiance.coefficients));
+}
+
+bool IBLCacheControl::IrradianceSHFromTexture(const TextureData &description, const std::vector<TextureLevelView> &levels, SHIrradiance *irradiance)
+{
+	if (description.internalFormat != GL_RGB32F || description.width != ARRAYSIZE(irradiance->coefficients) || description.height != 1 ||
+		levels.size() != 1 || levels[0].size != sizeof(irradiance->coefficients))
+		return false;
+	memcpy(irradiance->coefficients, levels[0].data, sizeof(irradiance->coefficients));
+	return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+struct Texture;
+struct TextureData;
+struct TextureLevelView;
+struct IBLBakeSettings;
+struct SHIrradiance;
+
+// On-disk cache of the baked image based lighting textures (environment cubemap, irradiance map and prefiltered
+// environment map). Entries are keyed by a hash of the HDR file bytes, the bake
+// settings, the bake path and the sources of the bake shaders, so changing any of them results in a miss.
+struct IBLCache
+{
+	std::string directory;
+	bool enabled = true;
+	uint64_t shaderHash = 0;		// Of the bake path and the shader sources
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+};
+
+namespace IBLCacheControl
+{
+	// bakePath names the code that bakes the textures (e.g. "compute"). The paths only agree within a tolerance, so
+	// none of them reuses the entries of another.
+	void Init(IBLCache *cache, const std::string &directory, const std::string &bakePath, const std::vector<std::string> &shaderFiles);
+	uint64_t EnvironmentKey(IBLCache *cache, const char *hdrFile, const IBLBakeSettings &settings);
+	// Whether Load would hit, without reading the entry
+	bool Contains(IBLCache *cache, uint64_t key, const char *product);
+	bool Load(IBLCache *cache, uint64_t key, const char *product, Texture *texture);
+	void Store(IBLCache *cache, uint64_t key, const char *product, Texture *texture);
+	bool LoadIrradianceSH(IBLCache *cache, uint64_t key, SHIrradiance *irradiance);
+	void StoreIrradianceSH(IBLCache *cache, uint64_t key, const SHIrradiance &irradiance);
+
+	// The SH coefficients are stored as a 9x1 RGB float texture (product "irradianceSH"), which packassets can pack
+	// like the cubemaps
+	void IrradianceSHToTexture(const SHIrradiance &irradiance, TextureData *data);
+	bool IrradianceSHFromTexture(const TextureData &description, const std::vector<TextureLevelView> &levels, SHIrradiance *irradiance);
+}
@@ -1,4 +1,13 @@
 #include <iostream>
+#include <fstream>
+#include <cerrno>
+#ifdef WIN32
+	#include <direct.h>
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+#endif
 
 #include "IOUtil.h"
 
@@ -13,4 +22,105 @@ bool IOUtil::GetFileModificationTime(const char *filename, time_t *modificationT
 
 	*modificationTime = result.st_mtime;
 	return true;
-}
\ No newline at end of file
+}
+
+bool IOUtil::FileExists(const char *filename)
+{
+	struct stat result;
+	return stat(filename, &result) == 0;
+}
+
+// Succeeds if the directory already exists
+bool IOUtil::MakeDirectory(const char *path)
+{
+#ifdef WIN32
+	int status = _mkdir(path);
+#else
+	int status = mkdir(path, 0755);
+#endif
+	if (status != 0 && errno != EEXIST)
+	{
+		std::cerr << "Error creating directory " << path << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool IOUtil::ReadBinaryFile(const char *filename, std::vector<uint8_t> *data)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::in | std::ios::ate);
+	if (!file.is_open())
+	{
+		std::cerr << "Unable to open file " << filename << "\n";
+		return false;
+	}
+
+	std::streampos size = file.tellg();
+	data->resize(size_t(size));
+	file.seekg(0, std::ios::beg);
+	file.read((char *)data->data(), size);
+	return file.good();
+}
+
+bool IOUtil::MapFile(const char *filename, MappedFile *file)
+{
+	*file = MappedFile();
+#ifdef WIN32
+	HANDLE fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Unable to open file " << filename << "\n";
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(fileHandle, &size);
+	HANDLE mappingHandle = size.QuadPart > 0 ? CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	const void *data = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data)
+	{
+		std::cerr << "Unable to map file " << filename << "\n";
+		if (mappingHandle)
+			CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+	file->fileHandle = fileHandle;
+	file->mappingHandle = mappingHandle;
+	file->size = size_t(size.QuadPart);
+#else
+	int fileDescriptor = open(filename, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		std::cerr << "Unable to open file " << filename << "\n";
+		return false;
+	}
+	struct stat result;
+	void *data = fstat(fileDescriptor, &result) == 0 && result.st_size > 0 ?
+				 mmap(nullptr, size_t(result.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : MAP_FAILED;
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Unable to map file " << filename << "\n";
+		close(fileDescriptor);
+		return false;
+	}
+	file->fileDescriptor = fileDescriptor;
+	file->size = size_t(result.st_size);
+#endif
+	file->data = (const uint8_t *)data;
+	return true;
+}
+
+void IOUtil::UnmapFile(MappedFile *file)
+{
+	if (!file->data)
+		return;
+#ifdef WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mappingHandle);
+	CloseHandle(file->fileHandle);
+#else
+	munmap((void *)file->data, file->size);
+	close(file->fileDescriptor);
+#endif
+	*file = MappedFile();
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+#include <cinttypes>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #ifndef WIN32
@@ -10,7 +13,25 @@
 	#define stat _stat
 #endif
 
+// Read only memory mapping of a whole file
+struct MappedFile
+{
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+#ifdef WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
+
 namespace IOUtil
 {
 	bool GetFileModificationTime(const char *filename, time_t *modificationTime);
-}
\ No newline at end of file
+	bool FileExists(const char *filename);
+	bool MakeDirectory(const char *path);
+	bool ReadBinaryFile(const char *filename, std::vector<uint8_t> *data);
+	bool MapFile(const char *filename, MappedFile *file);
+	void UnmapFile(MappedFile *file);
+}
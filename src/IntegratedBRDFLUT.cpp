@@ -0,0 +1,3 @@
+#include "IntegratedBRDFLUT.h"
+
+#include "IntegratedBRDFLUT.inl"		// Generated into the build directory
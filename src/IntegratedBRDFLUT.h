@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Split sum BRDF LUT (scale and bias of F0) stored as RG half floats, generated at build time by tools/GenerateBRDFLUT.cpp.
+// Rows go from roughness 0 to 1 and columns from NdotV 0 to 1, the first row is t = 0 like glTexImage2D expects.
+extern const unsigned int INTEGRATED_BRDF_LUT_SIZE;
+extern const uint16_t INTEGRATED_BRDF_LUT[];
@@ -0,0 +1,126 @@
+#include <algorithm>
+
+#include "JobGraph.h"
+#include "Parallel.h"
+
+// Called with the mutex held, runs the job without it
+static void RunJob(JobGraph *graph, unsigned int id, std::unique_lock<std::mutex> *lock)
+{
+	lock->unlock();
+	if (graph->jobs[id].run)
+		graph->jobs[id].run();
+	lock->lock();
+
+	Job *job = &graph->jobs[id];
+	job->done = true;
+	++graph->doneCount;
+	for (unsigned int i = 0; i < job->dependents.size(); ++i)
+	{
+		Job *dependent = &graph->jobs[job->dependents[i]];
+		if (--dependent->pendingDependencies == 0)
+			graph->ready.push_back(job->dependents[i]);
+	}
+	graph->changed.notify_all();
+}
+
+static void RunWorker(JobGraph *graph)
+{
+	std::unique_lock<std::mutex> lock(graph->mutex);
+	for (;;)
+	{
+		graph->changed.wait(lock, [graph]() { return graph->stop || !graph->ready.empty(); });
+		if (graph->ready.empty())
+			return;
+		unsigned int id = graph->ready.front();
+		graph->ready.pop_front();
+		RunJob(graph, id, &lock);
+	}
+}
+
+// Whether job has to finish before target can
+static bool IsNeededBy(const JobGraph &graph, unsigned int job, unsigned int target)
+{
+	if (job == target)
+		return true;
+	const std::vector<unsigned int> &dependencies = graph.jobs[target].dependencies;
+	for (unsigned int i = 0; i < dependencies.size(); ++i)
+	{
+		if (!graph.jobs[dependencies[i]].done && IsNeededBy(graph, job, dependencies[i]))
+			return true;
+	}
+	return false;
+}
+
+unsigned int JobGraphControl::Add(JobGraph *graph, const std::string &name, std::function<void()> run,
+								  const std::vector<unsigned int> &dependencies)
+{
+	unsigned int id = (unsigned int)graph->jobs.size();
+	Job job;
+	job.name = name;
+	job.run = run;
+	job.dependencies = dependencies;
+	job.pendingDependencies = (unsigned int)dependencies.size();
+	graph->jobs.push_back(job);
+	for (unsigned int i = 0; i < dependencies.size(); ++i)
+		graph->jobs[dependencies[i]].dependents.push_back(id);
+	return id;
+}
+
+void JobGraphControl::Start(JobGraph *graph, unsigned int workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::max(Parallel::ThreadCount(), 2u) - 1;
+
+	std::unique_lock<std::mutex> lock(graph->mutex);
+	graph->stop = false;
+	for (unsigned int i = 0; i < graph->jobs.size(); ++i)
+	{
+		if (graph->jobs[i].pendingDependencies == 0)
+			graph->ready.push_back(i);
+	}
+	lock.unlock();
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+		graph->workers.push_back(std::thread(RunWorker, graph));
+}
+
+void JobGraphControl::Wait(JobGraph *graph, unsigned int job)
+{
+	std::unique_lock<std::mutex> lock(graph->mutex);
+	while (!graph->jobs[job].done)
+	{
+		auto it = std::find_if(graph->ready.begin(), graph->ready.end(), [&](unsigned int id) { return IsNeededBy(*graph, id, job); });
+		if (it == graph->ready.end())
+		{
+			graph->changed.wait(lock);
+			continue;
+		}
+		unsigned int id = *it;
+		graph->ready.erase(it);
+		RunJob(graph, id, &lock);
+	}
+}
+
+bool JobGraphControl::IsDone(JobGraph *graph, unsigned int job)
+{
+	std::lock_guard<std::mutex> lock(graph->mutex);
+	return graph->jobs[job].done;
+}
+
+void JobGraphControl::Release(JobGraph *graph)
+{
+	for (unsigned int i = 0; i < graph->jobs.size(); ++i)
+		Wait(graph, i);
+
+	{
+		std::lock_guard<std::mutex> lock(graph->mutex);
+		graph->stop = true;
+	}
+	graph->changed.notify_all();
+	for (unsigned int i = 0; i < graph->workers.size(); ++i)
+		graph->workers[i].join();
+	graph->workers.clear();
+	graph->jobs.clear();
+	graph->ready.clear();
+	graph->doneCount = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+struct Job
+{
+	std::string name;
+	std::function<void()> run;
+	std::vector<unsigned int> dependencies;
+	std::vector<unsigned int> dependents;
+	unsigned int pendingDependencies = 0;
+	bool done = false;
+};
+
+// Jobs that run on a pool of worker threads as soon as every job they depend on has finished. Meant for the CPU side
+// of startup: the jobs only produce data (meshes, decoded images, file contents) and the GL thread waits for the ones
+// it needs next and uploads their results, so the wall-clock time approaches the longest chain of dependent jobs.
+struct JobGraph
+{
+	std::vector<Job> jobs;
+	std::deque<unsigned int> ready;			// Ids of the jobs whose dependencies have finished, in the order they got ready
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable changed;		// Signalled when a job gets ready or finishes
+	unsigned int doneCount = 0;
+	bool stop = false;
+};
+
+namespace JobGraphControl
+{
+	// Jobs can only be added before Start, dependencies are ids returned by earlier Adds
+	unsigned int Add(JobGraph *graph, const std::string &name, std::function<void()> run,
+					 const std::vector<unsigned int> &dependencies = std::vector<unsigned int>());
+	// workerCount = 0 leaves one hardware thread to the GL thread
+	void Start(JobGraph *graph, unsigned int workerCount = 0);
+	// Blocks until the job has finished, its results can be read afterwards. The job and the jobs it depends on are
+	// run on the calling thread if no worker has picked them up yet.
+	void Wait(JobGraph *graph, unsigned int job);
+	bool IsDone(JobGraph *graph, unsigned int job);
+	// Waits for every job and joins the workers
+	void Release(JobGraph *graph);
+}
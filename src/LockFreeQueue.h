@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// Bounded multi producer, multi consumer queue without locks. Every cell carries a sequence number that tells
+// producers and consumers whose turn it is, so a push or pop only contends on one compare-and-swap of its index.
+// Source: http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename T>
+class LockFreeQueue
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit LockFreeQueue(size_t capacity) : cells(RoundUpToPowerOfTwo(capacity)), mask(cells.size() - 1)
+	{
+		size_t size = cells.size();
+		for (size_t i = 0; i < size; ++i)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		enqueuePosition.store(0, std::memory_order_relaxed);
+		dequeuePosition.store(0, std::memory_order_relaxed);
+	}
+
+	LockFreeQueue(const LockFreeQueue &) = delete;
+	LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+	// Returns false if the queue is full, value is left untouched then
+	bool TryPush(T &value)
+	{
+		Cell *cell;
+		size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[position & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position);
+			if (difference == 0)
+			{
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+		cell->value = std::move(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Returns false if the queue is empty
+	bool TryPop(T *value)
+	{
+		Cell *cell;
+		size_t position = dequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[position & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+			if (difference == 0)
+			{
+				if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = dequeuePosition.load(std::memory_order_relaxed);
+		}
+		*value = std::move(cell->value);
+		cell->sequence.store(position + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t size = 2;
+		while (size < value)
+			size *= 2;
+		return size;
+	}
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// The positions live on their own cache lines so that producers and consumers do not invalidate each other
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	std::vector<Cell> cells;
+	size_t mask;
+	char padding0[CACHE_LINE_SIZE];
+	std::atomic<size_t> enqueuePosition;
+	char padding1[CACHE_LINE_SIZE];
+	std::atomic<size_t> dequeuePosition;
+	char padding2[CACHE_LINE_SIZE];
+};
@@ -0,0 +1,105 @@
+#include "MaterialPacking.h"
+
+#include <iostream>
+#include <fstream>
+
+#include "Graphics.h"
+#include "IOUtil.h"
+#include "stb_image.h"
+
+// Single channel map, pixels is null when the map is missing
+struct ChannelMap
+{
+	unsigned char *pixels = nullptr;
+	int width = 0;
+	int height = 0;
+};
+
+static bool LoadChannel(const char *file, ChannelMap *map)
+{
+	if (!file || !IOUtil::FileExists(file))
+		return true;
+	int numChannels;
+	map->pixels = stbi_load(file, &map->width, &map->height, &numChannels, 1);
+	if (!map->pixels)
+	{
+		std::cerr << "ERROR: Failed to load " << file << ": " << stbi_failure_reason() << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool MaterialPacking::PackORM(const char *occlusionFile, const char *roughnessFile, const char *metalnessFile, TextureData *packed)
+{
+	const unsigned int CHANNEL_COUNT = 3;
+	const char *files[CHANNEL_COUNT] = { occlusionFile, roughnessFile, metalnessFile };
+	const unsigned char neutralValues[CHANNEL_COUNT] = { 255, 255, 0 };
+
+	ChannelMap maps[CHANNEL_COUNT];
+	int width = 0, height = 0;
+	bool success = true;
+	for (unsigned int c = 0; c < CHANNEL_COUNT && success; ++c)
+	{
+		success = LoadChannel(files[c], &maps[c]);
+		if (!success || !maps[c].pixels)
+			continue;
+		if (width == 0)
+		{
+			width = maps[c].width;
+			height = maps[c].height;
+		}
+		else if (maps[c].width != width || maps[c].height != height)
+		{
+			std::cerr << "ERROR: PackORM: " << files[c] << " is " << maps[c].width << "x" << maps[c].height << ", expected "
+					  << width << "x" << height << "\n";
+			success = false;
+		}
+	}
+	if (success && width == 0)
+	{
+		std::cerr << "ERROR: PackORM: none of the maps exist\n";
+		success = false;
+	}
+
+	if (success)
+	{
+		*packed = TextureData();
+		packed->target = TextureTarget::Texture2D;
+		packed->internalFormat = packed->format = GL_RGB;
+		packed->type = GL_UNSIGNED_BYTE;
+		packed->width = (unsigned int)width;
+		packed->height = (unsigned int)height;
+		packed->mipCount = 1;
+		size_t texelCount = size_t(width) * size_t(height);
+		packed->levels.push_back(std::vector<uint8_t>(texelCount * CHANNEL_COUNT));
+		uint8_t *texels = packed->levels[0].data();
+		for (unsigned int c = 0; c < CHANNEL_COUNT; ++c)
+		{
+			for (size_t i = 0; i < texelCount; ++i)
+				texels[i * CHANNEL_COUNT + c] = maps[c].pixels ? maps[c].pixels[i] : neutralValues[c];
+		}
+	}
+
+	for (unsigned int c = 0; c < CHANNEL_COUNT; ++c)
+		stbi_image_free(maps[c].pixels);
+	return success;
+}
+
+bool MaterialPacking::WritePPM(const char *file, const TextureData &data)
+{
+	if (data.format != GL_RGB || data.type != GL_UNSIGNED_BYTE || data.levels.empty())
+	{
+		std::cerr << "ERROR: WritePPM: only 8 bit RGB textures are supported\n";
+		return false;
+	}
+
+	std::ofstream out(file, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR: Unable to open " << file << " for writing\n";
+		return false;
+	}
+	out << "P6\n" << data.width << " " << data.height << "\n255\n";
+	out.write((const char *)data.levels[0].data(), size_t(data.width) * size_t(data.height) * 3);
+	return out.good();
+}
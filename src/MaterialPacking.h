@@ -0,0 +1,17 @@
+#pragma once
+
+struct TextureData;
+
+// Packs the single channel maps of a material into the channels of one texture, so that the shader needs one fetch
+// (and the scene one texture bind) where it needed one per map. The packed image is written as a binary PPM, which
+// the texture loader and cooktex read like any other source image.
+namespace MaterialPacking
+{
+	// R = ambient occlusion, G = roughness, B = metalness. Maps that are null or do not exist get their neutral value
+	// (no occlusion, fully rough, dielectric), the others have to have the same size. Only the first channel of each map
+	// is used. The maps are decoded with the current stb_image flip setting, packorm leaves it off so that the packed
+	// file has the orientation of the sources.
+	bool PackORM(const char *occlusionFile, const char *roughnessFile, const char *metalnessFile, TextureData *packed);
+	// 8 bit GL_RGB level 0 only
+	bool WritePPM(const char *file, const TextureData &data);
+}
@@ -0,0 +1,364 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "MeshOptimizer.h"
+
+using std::vector;
+using glm::vec3;
+using MeshOptimizer::ANALYZE_CACHE_SIZE;
+
+// Forsyth's scoring, tuned for a 32 entry LRU cache
+static const unsigned int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static const unsigned int NO_TRIANGLE = ~0u;
+
+// Every level of detail as a range of the indices, a mesh without levels is one
+static vector<MeshLevel> Levels(const Mesh &mesh)
+{
+	if (!mesh.levels.empty())
+		return mesh.levels;
+	MeshLevel level;
+	level.indexCount = mesh.indexCount;
+	return vector<MeshLevel>(1, level);
+}
+
+static vector<uint32_t> ReadIndices(const Mesh &mesh, const MeshLevel &level)
+{
+	vector<uint32_t> indices(level.indexCount - level.indexCount % 3);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		unsigned int index = level.indexOffset + i;
+		indices[i] = mesh.indexStride == sizeof(uint16_t) ? ((const uint16_t *)mesh.indices)[index] : ((const uint32_t *)mesh.indices)[index];
+	}
+	return indices;
+}
+
+static void WriteIndices(Mesh *mesh, const MeshLevel &level, const vector<uint32_t> &indices)
+{
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		unsigned int index = level.indexOffset + i;
+		if (mesh->indexStride == sizeof(uint16_t))
+			((uint16_t *)mesh->indices)[index] = uint16_t(indices[i]);
+		else
+			((uint32_t *)mesh->indices)[index] = indices[i];
+	}
+}
+
+// Cache misses of one triangle in a FIFO cache. timestamps holds when each vertex entered the cache, the cache is
+// empty when time is more than cacheSize past every timestamp (add cacheSize + 1 to time to flush it).
+static unsigned int CacheMisses(const uint32_t *triangle, vector<unsigned int> *timestamps, unsigned int *time, unsigned int cacheSize)
+{
+	unsigned int misses = 0;
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		unsigned int *timestamp = &(*timestamps)[triangle[i]];
+		if (*time - *timestamp > cacheSize)
+		{
+			*timestamp = (*time)++;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const Mesh &mesh, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	vector<uint32_t> indices = ReadIndices(mesh, Levels(mesh)[0]);
+	if (indices.empty())
+		return stats;
+
+	vector<unsigned int> timestamps(mesh.vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	for (unsigned int i = 0; i < indices.size(); i += 3)
+		misses += CacheMisses(&indices[i], &timestamps, &time, cacheSize);
+
+	vector<bool> referenced(mesh.vertexCount, false);
+	unsigned int referencedCount = 0;
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		referencedCount += referenced[indices[i]] ? 0 : 1;
+		referenced[indices[i]] = true;
+	}
+
+	stats.acmr = float(misses) / float(indices.size() / 3);
+	stats.atvr = float(misses) / float(referencedCount);
+	return stats;
+}
+
+static float VertexScore(int cachePosition, unsigned int liveTriangles)
+{
+	if (liveTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0 && cachePosition < 3)
+		score = FORSYTH_LAST_TRIANGLE_SCORE;		// Used by the last triangle, whatever their order
+	else if (cachePosition >= 3)
+		score = powf(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+	// Vertices with few triangles left are finished first so that they do not have to come back into the cache
+	return score + FORSYTH_VALENCE_BOOST_SCALE * powf(float(liveTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+static vector<uint32_t> VertexCacheOrder(const vector<uint32_t> &indices, unsigned int vertexCount)
+{
+	unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+	if (triangleCount == 0)
+		return indices;
+
+	// Triangles of every vertex that have not been emitted yet, liveTriangles[v] of them from adjacencyOffsets[v]
+	vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		++liveTriangles[indices[i]];
+	vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	vector<unsigned int> adjacency(indices.size());
+	vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		adjacency[adjacencyFill[indices[i]]++] = i / 3;
+
+	vector<int> cachePositions(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+	vector<float> triangleScores(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; ++t)
+		triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+	vector<bool> emitted(triangleCount, false);
+	vector<uint32_t> cache, newCache;
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+	unsigned int bestTriangle = (unsigned int)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	unsigned int nextInputTriangle = 0;
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		if (bestTriangle == NO_TRIANGLE)
+		{
+			// Nothing in the cache has triangles left, continue with the input order
+			while (emitted[nextInputTriangle])
+				++nextInputTriangle;
+			bestTriangle = nextInputTriangle;
+		}
+
+		const uint32_t *triangle = &indices[3 * bestTriangle];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[bestTriangle] = true;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			unsigned int *begin = &adjacency[adjacencyOffsets[triangle[i]]];
+			unsigned int *end = begin + liveTriangles[triangle[i]];
+			*std::find(begin, end, bestTriangle) = *(end - 1);
+			--liveTriangles[triangle[i]];
+		}
+
+		// The triangle's vertices move to the front of the cache, the ones pushed past its end leave it
+		newCache.clear();
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			if (std::find(newCache.begin(), newCache.end(), triangle[i]) == newCache.end())
+				newCache.push_back(triangle[i]);
+		}
+		for (unsigned int i = 0; i < cache.size(); ++i)
+		{
+			if (std::find(triangle, triangle + 3, cache[i]) == triangle + 3)
+				newCache.push_back(cache[i]);
+		}
+		for (unsigned int i = 0; i < newCache.size(); ++i)
+		{
+			uint32_t v = newCache[i];
+			cachePositions[v] = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+			vertexScores[v] = VertexScore(cachePositions[v], liveTriangles[v]);
+		}
+
+		// Only the triangles of these vertices changed score, the next one is the best of them
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = 0.0f;
+		for (unsigned int i = 0; i < newCache.size(); ++i)
+		{
+			uint32_t v = newCache[i];
+			for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; ++a)
+			{
+				unsigned int t = adjacency[a];
+				triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+				if (bestTriangle == NO_TRIANGLE || triangleScores[t] > bestScore)
+				{
+					bestTriangle = t;
+					bestScore = triangleScores[t];
+				}
+			}
+		}
+		newCache.resize(std::min((unsigned int)(newCache.size()), FORSYTH_CACHE_SIZE));
+		cache.swap(newCache);
+	}
+
+	return result;
+}
+
+void MeshOptimizer::OptimizeVertexCache(Mesh *mesh)
+{
+	vector<MeshLevel> levels = Levels(*mesh);
+	for (unsigned int i = 0; i < levels.size(); ++i)
+		WriteIndices(mesh, levels[i], VertexCacheOrder(ReadIndices(*mesh, levels[i]), mesh->vertexCount));
+}
+
+static vector<uint32_t> OverdrawOrder(const Mesh &mesh, const vector<uint32_t> &indices, float threshold)
+{
+	unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+	if (triangleCount == 0)
+		return indices;
+
+	// Hard boundaries: triangles that miss the cache with all of their vertices, nothing connects them to the ones before
+	vector<unsigned int> timestamps(mesh.vertexCount, 0);
+	unsigned int time = ANALYZE_CACHE_SIZE + 1;
+	vector<unsigned int> hardClusters;
+	for (unsigned int t = 0; t < triangleCount; ++t)
+	{
+		if (CacheMisses(&indices[3 * t], &timestamps, &time, ANALYZE_CACHE_SIZE) == 3 || t == 0)
+			hardClusters.push_back(t);
+	}
+
+	// Soft boundaries: a hard cluster is split once its first triangles have come within threshold of its ACMR
+	vector<unsigned int> clusters;
+	for (unsigned int c = 0; c < hardClusters.size(); ++c)
+	{
+		unsigned int start = hardClusters[c];
+		unsigned int end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+		time += ANALYZE_CACHE_SIZE + 1;
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; ++t)
+			clusterMisses += CacheMisses(&indices[3 * t], &timestamps, &time, ANALYZE_CACHE_SIZE);
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		clusters.push_back(start);
+		time += ANALYZE_CACHE_SIZE + 1;
+		unsigned int runningMisses = 0;
+		unsigned int runningTriangles = 0;
+		for (unsigned int t = start; t + 1 < end; ++t)
+		{
+			runningMisses += CacheMisses(&indices[3 * t], &timestamps, &time, ANALYZE_CACHE_SIZE);
+			++runningTriangles;
+			if (float(runningMisses) / float(runningTriangles) <= clusterThreshold)
+			{
+				clusters.push_back(t + 1);
+				time += ANALYZE_CACHE_SIZE + 1;
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh
+	vector<vec3> clusterCentroids(clusters.size(), vec3(0.0f));
+	vector<vec3> clusterNormals(clusters.size(), vec3(0.0f));
+	vec3 meshCentroid = vec3(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int c = 0; c < clusters.size(); ++c)
+	{
+		unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		float clusterArea = 0.0f;
+		for (unsigned int t = clusters[c]; t < end; ++t)
+		{
+			vec3 p0 = UtilMesh::Position(mesh, indices[3 * t]);
+			vec3 p1 = UtilMesh::Position(mesh, indices[3 * t + 1]);
+			vec3 p2 = UtilMesh::Position(mesh, indices[3 * t + 2]);
+			vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			clusterCentroids[c] += area * (p0 + p1 + p2) / 3.0f;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : vec3(0.0f);
+	}
+	if (meshArea <= 0.0f)
+		return indices;
+	meshCentroid /= meshArea;
+
+	// Clusters that face away from the center (front faces are counterclockwise) are likely to occlude the others
+	vector<float> keys(clusters.size(), 0.0f);
+	for (unsigned int c = 0; c < clusters.size(); ++c)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		if (normalLength > 0.0f)
+			keys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength);
+	}
+	vector<unsigned int> order(clusters.size());
+	for (unsigned int c = 0; c < order.size(); ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		unsigned int c = order[i];
+		unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+	}
+	return result;
+}
+
+void MeshOptimizer::OptimizeOverdraw(Mesh *mesh, float threshold)
+{
+	// Needs the positions
+	if (mesh->vertexAttributes.empty() || mesh->vertexAttributes[0].size < 3 ||
+		!(mesh->vertexAttributes[0].type == VertexAttributeType::Float ||
+		  (mesh->vertexAttributes[0].type == VertexAttributeType::Short && mesh->vertexAttributes[0].normalized)))
+		return;
+	vector<MeshLevel> levels = Levels(*mesh);
+	for (unsigned int i = 0; i < levels.size(); ++i)
+		WriteIndices(mesh, levels[i], OverdrawOrder(*mesh, ReadIndices(*mesh, levels[i]), threshold));
+}
+
+void MeshOptimizer::OptimizeVertexFetch(Mesh *mesh)
+{
+	static const uint32_t UNUSED = ~0u;
+
+	// Over all levels: they share the vertices, level 0 decides their order
+	MeshLevel all;
+	all.indexCount = mesh->indexCount;
+	vector<uint32_t> indices = ReadIndices(*mesh, all);
+	vector<uint32_t> remap(mesh->vertexCount, UNUSED);
+	uint32_t nextVertex = 0;
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		if (remap[indices[i]] == UNUSED)
+			remap[indices[i]] = nextVertex++;
+		indices[i] = remap[indices[i]];
+	}
+	for (unsigned int v = 0; v < mesh->vertexCount; ++v)
+	{
+		if (remap[v] == UNUSED)
+			remap[v] = nextVertex++;
+	}
+
+	const uint8_t *source = (const uint8_t *)mesh->vertices;
+	vector<uint8_t> vertices(source, source + mesh->vertexCount * mesh->vertexStride);
+	for (unsigned int v = 0; v < mesh->vertexCount; ++v)
+		memcpy((uint8_t *)mesh->vertices + remap[v] * mesh->vertexStride, &vertices[v * mesh->vertexStride], mesh->vertexStride);
+	WriteIndices(mesh, all, indices);
+}
+
+void MeshOptimizer::Optimize(Mesh *mesh, VertexCacheStats *before, VertexCacheStats *after)
+{
+	if (before)
+		*before = AnalyzeVertexCache(*mesh);
+	OptimizeVertexCache(mesh);
+	OptimizeOverdraw(mesh);
+	OptimizeVertexFetch(mesh);
+	if (after)
+		*after = AnalyzeVertexCache(*mesh);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "UtilMesh.h"
+
+// Post-transform vertex cache efficiency of a triangle list, simulated with a FIFO cache
+struct VertexCacheStats
+{
+	float acmr = 0.0f;		// Average cache miss ratio: transformed vertices per triangle (3 at worst, about 0.5 for large grids)
+	float atvr = 0.0f;		// Average transformed vertex ratio: transformed vertices per referenced vertex (1 at best)
+};
+
+// Reorders the triangles and vertices of triangle list meshes for the GPU, the rendered result does not change.
+// Every pass works in place on the mesh's buffers, which keep their size and index type. Triangles are reordered within
+// each level of detail, the stats are those of level 0.
+namespace MeshOptimizer
+{
+	static const unsigned int ANALYZE_CACHE_SIZE = 16;
+
+	VertexCacheStats AnalyzeVertexCache(const Mesh &mesh, unsigned int cacheSize = ANALYZE_CACHE_SIZE);
+	// Triangle order for a small LRU cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+	void OptimizeVertexCache(Mesh *mesh);
+	// Splits the (cache optimized) triangles into clusters and draws the outward facing ones first so that early-z
+	// rejects more of the rest (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+	// threshold: how much worse than the cache order's ACMR a cluster may get, larger values give more clusters.
+	void OptimizeOverdraw(Mesh *mesh, float threshold = 1.05f);
+	// Vertices in the order the triangles first use them, unused ones last
+	void OptimizeVertexFetch(Mesh *mesh);
+	// All of the above, stats are optional
+	void Optimize(Mesh *mesh, VertexCacheStats *before = nullptr, VertexCacheStats *after = nullptr);
+}
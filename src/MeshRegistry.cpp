@@ -0,0 +1,155 @@
+#include <iterator>
+#include <vector>
+#include <cstring>
+
+#include "MeshRegistry.h"
+
+// FNV-1a
+static const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t HASH_PRIME = 1099511628211ull;
+
+static uint64_t Hash(const void *data, size_t size, uint64_t hash)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= HASH_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t HashMesh(const Mesh &mesh)
+{
+	uint64_t counts[4] = { mesh.vertexCount, mesh.vertexStride, mesh.indexCount, mesh.indexStride };
+	uint64_t hash = Hash(counts, sizeof(counts), HASH_OFFSET_BASIS);
+	for (unsigned int i = 0; i < mesh.vertexAttributes.size(); ++i)
+	{
+		// Field by field so that struct padding never ends up in the hash
+		uint32_t attribute[3] = { mesh.vertexAttributes[i].size, uint32_t(mesh.vertexAttributes[i].type), mesh.vertexAttributes[i].normalized };
+		hash = Hash(attribute, sizeof(attribute), hash);
+	}
+	hash = Hash(&mesh.positionScale, sizeof(mesh.positionScale), hash);
+	for (unsigned int i = 0; i < mesh.levels.size(); ++i)
+	{
+		uint32_t range[2] = { mesh.levels[i].indexOffset, mesh.levels[i].indexCount };
+		hash = Hash(range, sizeof(range), hash);
+		hash = Hash(&mesh.levels[i].error, sizeof(mesh.levels[i].error), hash);
+		uint32_t meshletRange[2] = { mesh.levels[i].meshletOffset, mesh.levels[i].meshletCount };
+		hash = Hash(meshletRange, sizeof(meshletRange), hash);
+	}
+	// Meshlet has no padding, it only holds 4 byte fields
+	hash = Hash(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet), hash);
+	hash = Hash(mesh.vertices, mesh.vertexCount * mesh.vertexStride, hash);
+	return Hash(mesh.indices, mesh.indexCount * mesh.indexStride, hash);
+}
+
+static bool SameBytes(GLuint buffer, const void *data, size_t size)
+{
+	std::vector<uint8_t> contents(size);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, contents.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	return size == 0 || memcmp(contents.data(), data, size) == 0;
+}
+
+static bool SameLayout(const std::vector<VertexAttribute> &a, const std::vector<VertexAttribute> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (unsigned int i = 0; i < a.size(); ++i)
+	{
+		if (a[i].size != b[i].size || a[i].type != b[i].type || a[i].normalized != b[i].normalized)
+			return false;
+	}
+	return true;
+}
+
+static bool SameLevels(const std::vector<MeshLevel> &a, const std::vector<MeshLevel> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (unsigned int i = 0; i < a.size(); ++i)
+	{
+		if (a[i].indexOffset != b[i].indexOffset || a[i].indexCount != b[i].indexCount || a[i].error != b[i].error ||
+			a[i].meshletOffset != b[i].meshletOffset || a[i].meshletCount != b[i].meshletCount)
+			return false;
+	}
+	return true;
+}
+
+// Everything the model is made of, the bytes of the buffers last. Collisions of the hash are rare enough that the
+// buffers are read back instead of keeping a CPU copy of every mesh.
+static bool SameContent(const RegisteredModel &registered, const Mesh &mesh)
+{
+	size_t vertexBytes = size_t(mesh.vertexCount) * mesh.vertexStride;
+	size_t indexBytes = size_t(mesh.indexCount) * mesh.indexStride;
+	if (registered.vertexBytes != vertexBytes || registered.indexBytes != indexBytes || registered.model.indexStride != mesh.indexStride ||
+		registered.model.positionScale != mesh.positionScale || !SameLayout(registered.vertexAttributes, mesh.vertexAttributes) ||
+		!SameLevels(registered.levels, mesh.levels) || registered.model.meshlets.size() != mesh.meshlets.size())
+		return false;
+	if (!mesh.meshlets.empty() && memcmp(registered.model.meshlets.data(), mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet)) != 0)
+		return false;
+	return SameBytes(registered.model.vbo, mesh.vertices, vertexBytes) && SameBytes(registered.model.ibo, mesh.indices, indexBytes);
+}
+
+Model *MeshRegistryControl::Acquire(MeshRegistry *registry, const std::string &key)
+{
+	auto it = registry->keys.find(key);
+	if (it == registry->keys.end())
+		return nullptr;
+	++it->second->references;
+	return &it->second->model;
+}
+
+Model *MeshRegistryControl::Add(MeshRegistry *registry, const std::string &key, const Mesh &mesh)
+{
+	Model *model = Acquire(registry, key);
+	if (model)
+		return model;
+
+	uint64_t contentHash = HashMesh(mesh);
+	auto range = registry->models.equal_range(contentHash);
+	auto it = range.first;
+	while (it != range.second && !SameContent(it->second, mesh))
+		++it;
+	if (it == range.second)
+	{
+		it = registry->models.insert(std::make_pair(contentHash, RegisteredModel()));
+		RegisteredModel *registered = &it->second;
+		Graphics::InitModel(&registered->model, mesh, false);
+		registered->contentHash = contentHash;
+		registered->vertexBytes = size_t(mesh.vertexCount) * mesh.vertexStride;
+		registered->indexBytes = size_t(mesh.indexCount) * mesh.indexStride;
+		registered->vertexAttributes = mesh.vertexAttributes;
+		registered->levels = mesh.levels;
+	}
+	registry->keys[key] = &it->second;
+	++it->second.references;
+	return &it->second.model;
+}
+
+void MeshRegistryControl::Release(MeshRegistry *registry, Model *model)
+{
+	for (auto it = registry->models.begin(); it != registry->models.end(); ++it)
+	{
+		if (&it->second.model != model)
+			continue;
+		if (--it->second.references == 0)
+		{
+			for (auto key = registry->keys.begin(); key != registry->keys.end();)
+				key = key->second == &it->second ? registry->keys.erase(key) : std::next(key);
+			Graphics::Release(&it->second.model);
+			registry->models.erase(it);
+		}
+		return;
+	}
+}
+
+void MeshRegistryControl::Release(MeshRegistry *registry)
+{
+	for (auto &it : registry->models)
+		Graphics::Release(&it.second.model);
+	registry->models.clear();
+	registry->keys.clear();
+}
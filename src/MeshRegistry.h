@@ -0,0 +1,42 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Graphics.h"
+#include "UtilMesh.h"
+
+// One uploaded model and the number of objects that use it. The layout and the levels of its mesh are kept to tell
+// meshes with the same hash apart, the model has no copy of them.
+struct RegisteredModel
+{
+	Model model;
+	uint64_t contentHash = 0;
+	size_t vertexBytes = 0;
+	size_t indexBytes = 0;
+	std::vector<VertexAttribute> vertexAttributes;
+	std::vector<MeshLevel> levels;
+	unsigned int references = 0;
+};
+
+// Hands out shared models so that objects with the same mesh use one VAO/VBO/IBO. Meshes are found by key (a name
+// for the generator and its parameters, e.g. "uvSphere64") and, under a new key, by a hash of their content. A model
+// with the same hash is only shared if its layout, levels, meshlets and buffers are the same as well.
+struct MeshRegistry
+{
+	std::multimap<uint64_t, RegisteredModel> models;	// By content hash, the models never move
+	std::map<std::string, RegisteredModel *> keys;		// Every key a model was added under
+};
+
+namespace MeshRegistryControl
+{
+	// The model added under key (adding a reference) or nullptr
+	Model *Acquire(MeshRegistry *registry, const std::string &key);
+	// Uploads the mesh unless a model with this key or the same content exists already, adds a reference either way.
+	// The mesh is not freed.
+	Model *Add(MeshRegistry *registry, const std::string &key, const Mesh &mesh);
+	// Releases the model once its last reference is gone
+	void Release(MeshRegistry *registry, Model *model);
+	void Release(MeshRegistry *registry);
+}
@@ -0,0 +1,394 @@
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "MeshSimplifier.h"
+
+using std::vector;
+using glm::vec3;
+using glm::dvec4;
+using glm::dmat4;
+
+// Positions closer than this (relative to the largest coordinate) are welded into one group
+static const float WELD_TOLERANCE = 1e-5f;
+// A level is dropped, and the chain ends, if it keeps more than this fraction of the triangles of the one before
+static const float MIN_LEVEL_REDUCTION = 0.75f;
+
+// Largest rotation of a remaining triangle's normal by one collapse, as the cosine of the angle
+static const float MIN_NORMAL_COSINE = 0.25f;
+
+static const uint32_t NO_VERTEX = ~0u;
+
+// Moves every vertex of group 'from' onto a vertex of group 'to'
+struct Collapse
+{
+	uint32_t from = 0;
+	uint32_t to = 0;
+	double cost = 0.0;
+};
+
+static vector<uint32_t> ReadIndices(const Mesh &mesh)
+{
+	unsigned int count = mesh.levels.empty() ? mesh.indexCount : mesh.levels[0].indexCount;
+	unsigned int offset = mesh.levels.empty() ? 0 : mesh.levels[0].indexOffset;
+	vector<uint32_t> indices(count - count % 3);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		indices[i] = mesh.indexStride == sizeof(uint16_t) ? ((const uint16_t *)mesh.indices)[offset + i] : ((const uint32_t *)mesh.indices)[offset + i];
+	return indices;
+}
+
+// Group of every vertex, vertices at the same position (within WELD_TOLERANCE) share one
+static vector<uint32_t> WeldPositions(const vector<vec3> &positions, uint32_t *groupCount)
+{
+	float extent = 0.0f;
+	for (unsigned int v = 0; v < positions.size(); ++v)
+		extent = std::max(extent, std::max(std::abs(positions[v].x), std::max(std::abs(positions[v].y), std::abs(positions[v].z))));
+	float cell = extent > 0.0f ? extent * WELD_TOLERANCE : 1.0f;
+	vector<glm::i64vec3> keys(positions.size());
+	for (unsigned int v = 0; v < positions.size(); ++v)
+		keys[v] = glm::i64vec3(glm::round(positions[v] / cell));
+
+	vector<uint32_t> order(positions.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return keys[a].x != keys[b].x ? keys[a].x < keys[b].x : keys[a].y != keys[b].y ? keys[a].y < keys[b].y : keys[a].z < keys[b].z;
+	});
+	vector<uint32_t> groups(positions.size());
+	uint32_t group = 0;
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		if (i > 0 && keys[order[i]] != keys[order[i - 1]])
+			++group;
+		groups[order[i]] = group;
+	}
+	*groupCount = positions.empty() ? 0 : group + 1;
+	return groups;
+}
+
+// Sum of the squared distances to the planes in the quadric, weighted by the area of their triangles
+static double QuadricError(const dmat4 &quadric, const vec3 &position)
+{
+	dvec4 p = dvec4(position, 1.0);
+	return std::max(glm::dot(p, quadric * p), 0.0);
+}
+
+// Triangles around every group, groupTriangles[groupOffsets[g]] to groupTriangles[groupOffsets[g + 1]]
+static void BuildAdjacency(const vector<uint32_t> &indices, const vector<uint32_t> &groups, uint32_t groupCount,
+						   vector<uint32_t> *groupOffsets, vector<uint32_t> *groupTriangles)
+{
+	groupOffsets->assign(groupCount + 1, 0);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		++(*groupOffsets)[groups[indices[i]] + 1];
+	for (uint32_t g = 0; g < groupCount; ++g)
+		(*groupOffsets)[g + 1] += (*groupOffsets)[g];
+	groupTriangles->resize(indices.size());
+	vector<uint32_t> fill(groupOffsets->begin(), groupOffsets->end() - 1);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		(*groupTriangles)[fill[groups[indices[i]]]++] = i / 3;
+}
+
+// One run that simplifies level 0 down to each of the decreasing targets in turn, levels and errors get one entry per
+// target (the last reachable level when a target is out of reach)
+static void Simplify(const Mesh &mesh, const vector<unsigned int> &targetIndexCounts, vector<vector<uint32_t>> *levels, vector<float> *errors)
+{
+	vector<uint32_t> indices = ReadIndices(mesh);
+	if (mesh.vertexAttributes.empty() || mesh.vertexAttributes[0].size < 3)
+	{
+		levels->assign(targetIndexCounts.size(), indices);
+		errors->assign(targetIndexCounts.size(), 0.0f);
+		return;
+	}
+
+	vector<vec3> vertexPositions(mesh.vertexCount);
+	for (unsigned int v = 0; v < mesh.vertexCount; ++v)
+		vertexPositions[v] = UtilMesh::Position(mesh, v);
+	uint32_t groupCount = 0;
+	vector<uint32_t> groups = WeldPositions(vertexPositions, &groupCount);
+	vector<vec3> positions(groupCount);
+	for (unsigned int v = 0; v < mesh.vertexCount; ++v)
+		positions[groups[v]] = vertexPositions[v];
+
+	// Triangles without area stay out of every level
+	vector<uint32_t> current;
+	current.reserve(indices.size());
+	for (unsigned int i = 0; i < indices.size(); i += 3)
+	{
+		uint32_t g0 = groups[indices[i]], g1 = groups[indices[i + 1]], g2 = groups[indices[i + 2]];
+		if (g0 != g1 && g1 != g2 && g0 != g2)
+			current.insert(current.end(), &indices[i], &indices[i] + 3);
+	}
+
+	// The planes of the original triangles around every group
+	vector<dmat4> quadrics(groupCount, dmat4(0.0));
+	vector<double> areas(groupCount, 0.0);
+	for (unsigned int i = 0; i < current.size(); i += 3)
+	{
+		const vec3 &p0 = positions[groups[current[i]]];
+		vec3 normal = glm::cross(positions[groups[current[i + 1]]] - p0, positions[groups[current[i + 2]]] - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		dvec4 plane = dvec4(glm::dvec3(normal / length), -glm::dot(normal / length, p0));
+		dmat4 quadric = glm::outerProduct(plane, plane) * double(0.5f * length);
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			quadrics[groups[current[i + k]]] += quadric;
+			areas[groups[current[i + k]]] += 0.5 * length;
+		}
+	}
+
+	// Groups on a border (or a non-manifold) edge keep their position so that the outline does not shrink
+	vector<uint64_t> edges;
+	edges.reserve(current.size());
+	for (unsigned int i = 0; i < current.size(); i += 3)
+	{
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			uint64_t a = groups[current[i + k]], b = groups[current[i + (k + 1) % 3]];
+			edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	vector<bool> locked(groupCount, false);
+	for (unsigned int i = 0; i < edges.size();)
+	{
+		unsigned int end = i;
+		while (end < edges.size() && edges[end] == edges[i])
+			++end;
+		if (end - i != 2)
+			locked[edges[i] >> 32] = locked[edges[i] & 0xffffffffu] = true;
+		i = end;
+	}
+
+	// Passes of independent collapses, cheapest first, until the target is reached or nothing can collapse anymore
+	double maxCost = 0.0;
+	vector<uint32_t> groupOffsets, groupTriangles;
+	vector<uint32_t> vertexTargets(mesh.vertexCount), candidateTargets(mesh.vertexCount, NO_VERTEX);
+	vector<bool> touched(groupCount);
+	vector<Collapse> collapses;
+	vector<uint32_t> written, fromNeighbors, tips;
+	bool stuck = false;
+	for (unsigned int level = 0; level < targetIndexCounts.size(); ++level)
+	{
+		unsigned int targetIndexCount = targetIndexCounts[level] - targetIndexCounts[level] % 3;
+		while (current.size() > targetIndexCount && !stuck)
+		{
+			BuildAdjacency(current, groups, groupCount, &groupOffsets, &groupTriangles);
+
+			collapses.clear();
+			for (unsigned int i = 0; i < current.size(); i += 3)
+			{
+				for (unsigned int k = 0; k < 3; ++k)
+				{
+					Collapse collapse;
+					collapse.from = groups[current[i + k]];
+					collapse.to = groups[current[i + (k + 1) % 3]];
+					for (unsigned int direction = 0; direction < 2; ++direction)
+					{
+						if (!locked[collapse.from])
+						{
+							double area = areas[collapse.from] + areas[collapse.to];
+							collapse.cost = area > 0.0 ? QuadricError(quadrics[collapse.from] + quadrics[collapse.to], positions[collapse.to]) / area : 0.0;
+							collapses.push_back(collapse);
+						}
+						std::swap(collapse.from, collapse.to);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+			std::iota(vertexTargets.begin(), vertexTargets.end(), 0);
+			std::fill(touched.begin(), touched.end(), false);
+			unsigned int triangleCount = (unsigned int)(current.size() / 3);
+			unsigned int collapseCount = 0;
+			for (unsigned int c = 0; c < collapses.size() && triangleCount * 3 > targetIndexCount; ++c)
+			{
+				uint32_t from = collapses[c].from, to = collapses[c].to;
+				if (touched[from] || touched[to])
+					continue;
+
+				// Every vertex of 'from' moves onto a vertex of 'to' it shares a triangle with, without one it would tear a seam
+				bool feasible = true;
+				unsigned int sharedTriangles = 0;
+				written.clear();
+				fromNeighbors.clear();
+				tips.clear();
+				for (uint32_t a = groupOffsets[from]; a < groupOffsets[from + 1] && feasible; ++a)
+				{
+					const uint32_t *triangle = &current[3 * groupTriangles[a]];
+					int toCorner = -1;
+					for (unsigned int k = 0; k < 3; ++k)
+					{
+						toCorner = groups[triangle[k]] == to ? int(k) : toCorner;
+						if (groups[triangle[k]] != from)
+							fromNeighbors.push_back(groups[triangle[k]]);
+					}
+					if (toCorner >= 0)
+					{
+						++sharedTriangles;
+						for (unsigned int k = 0; k < 3; ++k)
+						{
+							if (groups[triangle[k]] != from && groups[triangle[k]] != to)
+								tips.push_back(groups[triangle[k]]);
+						}
+						for (unsigned int k = 0; k < 3; ++k)
+						{
+							if (groups[triangle[k]] == from && candidateTargets[triangle[k]] == NO_VERTEX)
+							{
+								candidateTargets[triangle[k]] = triangle[toCorner];
+								written.push_back(triangle[k]);
+							}
+						}
+						continue;
+					}
+
+					// The triangles that stay must neither flip nor turn into slivers
+					vec3 p[3], moved[3];
+					for (unsigned int k = 0; k < 3; ++k)
+					{
+						p[k] = positions[groups[triangle[k]]];
+						moved[k] = groups[triangle[k]] == from ? positions[to] : p[k];
+					}
+					vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+					vec3 movedNormal = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+					feasible = glm::dot(normal, movedNormal) > MIN_NORMAL_COSINE * glm::length(normal) * glm::length(movedNormal);
+				}
+				for (uint32_t a = groupOffsets[from]; a < groupOffsets[from + 1] && feasible; ++a)
+				{
+					const uint32_t *triangle = &current[3 * groupTriangles[a]];
+					for (unsigned int k = 0; k < 3; ++k)
+						feasible = feasible && (groups[triangle[k]] != from || candidateTargets[triangle[k]] != NO_VERTEX);
+				}
+
+				// Link condition: only the tips of the triangles that disappear may be next to both ends, otherwise the
+				// collapse pinches the surface
+				if (feasible)
+				{
+					std::sort(fromNeighbors.begin(), fromNeighbors.end());
+					for (uint32_t a = groupOffsets[to]; a < groupOffsets[to + 1] && feasible; ++a)
+					{
+						const uint32_t *triangle = &current[3 * groupTriangles[a]];
+						for (unsigned int k = 0; k < 3; ++k)
+						{
+							uint32_t neighbor = groups[triangle[k]];
+							if (neighbor != to && std::find(tips.begin(), tips.end(), neighbor) == tips.end() &&
+								std::binary_search(fromNeighbors.begin(), fromNeighbors.end(), neighbor))
+								feasible = false;
+						}
+					}
+				}
+
+				for (unsigned int i = 0; i < written.size(); ++i)
+				{
+					if (feasible)
+						vertexTargets[written[i]] = candidateTargets[written[i]];
+					candidateTargets[written[i]] = NO_VERTEX;
+				}
+				if (!feasible)
+					continue;
+
+				// Everything around 'from' changed, it sits out the rest of the pass
+				for (uint32_t a = groupOffsets[from]; a < groupOffsets[from + 1]; ++a)
+				{
+					for (unsigned int k = 0; k < 3; ++k)
+						touched[groups[current[3 * groupTriangles[a] + k]]] = true;
+				}
+				quadrics[to] += quadrics[from];
+				areas[to] += areas[from];
+				maxCost = std::max(maxCost, collapses[c].cost);
+				triangleCount -= sharedTriangles;
+				++collapseCount;
+			}
+			stuck = collapseCount == 0;
+
+			vector<uint32_t> next;
+			next.reserve(triangleCount * 3);
+			for (unsigned int i = 0; i < current.size(); i += 3)
+			{
+				uint32_t v0 = vertexTargets[current[i]], v1 = vertexTargets[current[i + 1]], v2 = vertexTargets[current[i + 2]];
+				if (groups[v0] != groups[v1] && groups[v1] != groups[v2] && groups[v0] != groups[v2])
+				{
+					next.push_back(v0);
+					next.push_back(v1);
+					next.push_back(v2);
+				}
+			}
+			current.swap(next);
+		}
+		levels->push_back(current);
+		errors->push_back(float(std::sqrt(maxCost)));
+	}
+}
+
+vector<uint32_t> MeshSimplifier::Simplify(const Mesh &mesh, unsigned int targetIndexCount, float *error)
+{
+	vector<vector<uint32_t>> levels;
+	vector<float> errors;
+	Simplify(mesh, vector<unsigned int>(1, targetIndexCount), &levels, &errors);
+	if (error)
+		*error = errors[0];
+	return levels[0];
+}
+
+Mesh MeshSimplifier::BuildLevels(const Mesh &mesh, unsigned int maxLevelCount, float reduction)
+{
+	vector<unsigned int> targets;
+	unsigned int target = (unsigned int)ReadIndices(mesh).size();
+	for (unsigned int i = 1; i < maxLevelCount; ++i)
+	{
+		target = (unsigned int)(float(target / 3) * reduction) * 3;
+		targets.push_back(target);
+	}
+	vector<vector<uint32_t>> simplified;
+	vector<float> simplifiedErrors;
+	Simplify(mesh, targets, &simplified, &simplifiedErrors);
+
+	vector<vector<uint32_t>> levels(1, ReadIndices(mesh));
+	vector<float> errors(1, 0.0f);
+	for (unsigned int i = 0; i < simplified.size(); ++i)
+	{
+		if (simplified[i].empty() || float(simplified[i].size()) > float(levels.back().size()) * MIN_LEVEL_REDUCTION)
+			break;
+		levels.push_back(simplified[i]);
+		errors.push_back(simplifiedErrors[i]);
+	}
+
+	Mesh result = {};
+	result.vertexCount = mesh.vertexCount;
+	result.vertexStride = mesh.vertexStride;
+	result.vertexAttributes = mesh.vertexAttributes;
+	result.positionScale = mesh.positionScale;
+	result.vertices = malloc(mesh.vertexCount * mesh.vertexStride);
+	memcpy(result.vertices, mesh.vertices, mesh.vertexCount * mesh.vertexStride);
+
+	result.indexStride = mesh.indexStride;
+	for (unsigned int i = 0; i < levels.size(); ++i)
+	{
+		MeshLevel level;
+		level.indexOffset = result.indexCount;
+		level.indexCount = (unsigned int)levels[i].size();
+		level.error = errors[i];
+		result.levels.push_back(level);
+		result.indexCount += level.indexCount;
+	}
+	result.indices = malloc(result.indexCount * result.indexStride);
+	unsigned int index = 0;
+	for (unsigned int i = 0; i < levels.size(); ++i)
+	{
+		for (unsigned int j = 0; j < levels[i].size(); ++j, ++index)
+		{
+			if (result.indexStride == sizeof(uint16_t))
+				((uint16_t *)result.indices)[index] = uint16_t(levels[i][j]);
+			else
+				((uint32_t *)result.indices)[index] = levels[i][j];
+		}
+	}
+	return result;
+}
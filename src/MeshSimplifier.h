@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include "UtilMesh.h"
+
+// Levels of detail for triangle list meshes by edge collapses ordered with quadric error metrics (Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics"). Vertices at the same position collapse together and only
+// onto existing vertices, so that every level indexes the original vertex buffer and UV or normal seams stay closed.
+// Border edges are kept and collapses that would flip a triangle are skipped.
+namespace MeshSimplifier
+{
+	// Indices of level 0 reduced to at most targetIndexCount if the topology allows it. error: the square root of the
+	// largest collapse cost, an estimate of the distance to the original surface in model space.
+	std::vector<uint32_t> Simplify(const Mesh &mesh, unsigned int targetIndexCount, float *error = nullptr);
+	// Copy of the mesh (level 0 of it) with up to maxLevelCount levels of detail in one index buffer, each one with about
+	// reduction times the triangles of the one before. Stops early once a level does not get much smaller.
+	Mesh BuildLevels(const Mesh &mesh, unsigned int maxLevelCount = 6, float reduction = 0.5f);
+}
@@ -0,0 +1,203 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+#include "MeshletBuilder.h"
+
+using std::vector;
+using glm::vec3;
+
+// Normal cones wider than this (the smallest cosine between a triangle normal and the axis) are not worth testing
+static const float MIN_CONE_COSINE = 0.1f;
+
+static const uint32_t NO_TRIANGLE = ~0u;
+
+static vector<MeshLevel> Levels(const Mesh &mesh)
+{
+	if (!mesh.levels.empty())
+		return mesh.levels;
+	MeshLevel level;
+	level.indexCount = mesh.indexCount;
+	return vector<MeshLevel>(1, level);
+}
+
+static uint32_t ReadIndex(const Mesh &mesh, unsigned int index)
+{
+	return mesh.indexStride == sizeof(uint16_t) ? ((const uint16_t *)mesh.indices)[index] : ((const uint32_t *)mesh.indices)[index];
+}
+
+static void WriteIndex(Mesh *mesh, unsigned int index, uint32_t value)
+{
+	if (mesh->indexStride == sizeof(uint16_t))
+		((uint16_t *)mesh->indices)[index] = uint16_t(value);
+	else
+		((uint32_t *)mesh->indices)[index] = value;
+}
+
+Meshlet MeshletBuilder::ComputeBounds(const Mesh &mesh, const uint32_t *indices, unsigned int indexCount)
+{
+	Meshlet meshlet;
+	if (indexCount < 3)
+		return meshlet;
+
+	// Sphere around the bounding box
+	vec3 minimum = vec3(FLT_MAX), maximum = vec3(-FLT_MAX);
+	for (unsigned int i = 0; i < indexCount; ++i)
+	{
+		vec3 position = UtilMesh::Position(mesh, indices[i]);
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+	meshlet.center = 0.5f * (minimum + maximum);
+	for (unsigned int i = 0; i < indexCount; ++i)
+		meshlet.radius = std::max(meshlet.radius, glm::length(UtilMesh::Position(mesh, indices[i]) - meshlet.center));
+
+	// Cone around the triangle normals, triangles without area face nowhere
+	vector<vec3> normals;
+	vector<vec3> corners;
+	vec3 axis = vec3(0.0f);
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		vec3 p0 = UtilMesh::Position(mesh, indices[i]);
+		vec3 normal = glm::cross(UtilMesh::Position(mesh, indices[i + 1]) - p0, UtilMesh::Position(mesh, indices[i + 2]) - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normals.push_back(normal / length);
+		corners.push_back(p0);
+		axis += normal / length;
+	}
+	float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return meshlet;
+	axis /= axisLength;
+	float minCosine = 1.0f;
+	for (unsigned int t = 0; t < normals.size(); ++t)
+		minCosine = std::min(minCosine, glm::dot(normals[t], axis));
+	if (minCosine < MIN_CONE_COSINE)
+		return meshlet;
+
+	// The apex is on the back side of every triangle's plane, a camera that sees it within 90 degrees minus the cone's
+	// angle of the axis then sees the back of every triangle
+	float apexDistance = 0.0f;
+	for (unsigned int t = 0; t < normals.size(); ++t)
+		apexDistance = std::max(apexDistance, glm::dot(meshlet.center - corners[t], normals[t]) / glm::dot(axis, normals[t]));
+	meshlet.coneApex = meshlet.center - axis * apexDistance;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+	return meshlet;
+}
+
+void MeshletBuilder::Build(Mesh *mesh, unsigned int maxVertices, unsigned int maxTriangles)
+{
+	mesh->meshlets.clear();
+	if (mesh->vertexAttributes.empty() || mesh->vertexAttributes[0].size < 3)
+		return;
+
+	vector<MeshLevel> levels = Levels(*mesh);
+	vector<uint32_t> vertexMeshlets(mesh->vertexCount, NO_TRIANGLE);		// Last meshlet that used the vertex
+	for (unsigned int l = 0; l < levels.size(); ++l)
+	{
+		vector<uint32_t> indices(levels[l].indexCount - levels[l].indexCount % 3);
+		for (unsigned int i = 0; i < indices.size(); ++i)
+			indices[i] = ReadIndex(*mesh, levels[l].indexOffset + i);
+		unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+
+		// Triangles of every vertex
+		vector<uint32_t> adjacencyOffsets(mesh->vertexCount + 1, 0);
+		for (unsigned int i = 0; i < indices.size(); ++i)
+			++adjacencyOffsets[indices[i] + 1];
+		for (unsigned int v = 0; v < mesh->vertexCount; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		vector<uint32_t> adjacency(indices.size());
+		vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int i = 0; i < indices.size(); ++i)
+			adjacency[adjacencyFill[indices[i]]++] = i / 3;
+
+		vector<vec3> centroids(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			centroids[t] = (UtilMesh::Position(*mesh, indices[3 * t]) + UtilMesh::Position(*mesh, indices[3 * t + 1]) +
+							UtilMesh::Position(*mesh, indices[3 * t + 2])) / 3.0f;
+		}
+
+		vector<bool> emitted(triangleCount, false);
+		vector<uint32_t> result;
+		result.reserve(indices.size());
+		vector<uint32_t> meshletVertices;
+		unsigned int nextSeed = 0;
+		levels[l].meshletOffset = (unsigned int)mesh->meshlets.size();
+		while (result.size() < indices.size())
+		{
+			while (emitted[nextSeed])
+				++nextSeed;
+			uint32_t meshletId = (uint32_t)mesh->meshlets.size();
+			unsigned int meshletStart = (unsigned int)result.size();
+			unsigned int meshletTriangles = 0;
+			vec3 centroidSum = vec3(0.0f);
+			meshletVertices.clear();
+
+			// Grows by the neighbour that brings the fewest new vertices along, the one closest to the center on ties
+			uint32_t next = nextSeed;
+			while (next != NO_TRIANGLE)
+			{
+				for (unsigned int k = 0; k < 3; ++k)
+				{
+					uint32_t v = indices[3 * next + k];
+					if (vertexMeshlets[v] != meshletId)
+					{
+						vertexMeshlets[v] = meshletId;
+						meshletVertices.push_back(v);
+					}
+				}
+				result.insert(result.end(), &indices[3 * next], &indices[3 * next] + 3);
+				emitted[next] = true;
+				centroidSum += centroids[next];
+				++meshletTriangles;
+				if (meshletTriangles == maxTriangles)
+					break;
+
+				vec3 center = centroidSum / float(meshletTriangles);
+				next = NO_TRIANGLE;
+				unsigned int bestNewVertices = 0;
+				float bestDistance = 0.0f;
+				for (unsigned int i = 0; i < meshletVertices.size(); ++i)
+				{
+					uint32_t v = meshletVertices[i];
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+					{
+						uint32_t t = adjacency[a];
+						if (emitted[t])
+							continue;
+						unsigned int newVertices = 0;
+						for (unsigned int k = 0; k < 3; ++k)
+							newVertices += vertexMeshlets[indices[3 * t + k]] == meshletId ? 0 : 1;
+						if (meshletVertices.size() + newVertices > maxVertices)
+							continue;
+						float distance = glm::length(centroids[t] - center);
+						if (next == NO_TRIANGLE || newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance))
+						{
+							next = t;
+							bestNewVertices = newVertices;
+							bestDistance = distance;
+						}
+					}
+				}
+			}
+
+			Meshlet meshlet = ComputeBounds(*mesh, &result[meshletStart], (unsigned int)result.size() - meshletStart);
+			meshlet.indexOffset = levels[l].indexOffset + meshletStart;
+			meshlet.indexCount = (unsigned int)result.size() - meshletStart;
+			mesh->meshlets.push_back(meshlet);
+		}
+		levels[l].meshletCount = (unsigned int)mesh->meshlets.size() - levels[l].meshletOffset;
+
+		for (unsigned int i = 0; i < result.size(); ++i)
+			WriteIndex(mesh, levels[l].indexOffset + i, result[i]);
+	}
+	if (!mesh->levels.empty())
+		mesh->levels = levels;
+}
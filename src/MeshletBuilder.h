@@ -0,0 +1,18 @@
+#pragma once
+
+#include "UtilMesh.h"
+
+// Splits the triangles of every level of detail into meshlets: small clusters that share few vertices with each other,
+// each with a bounding sphere and a normal cone so that whole clusters can be culled before they are drawn.
+namespace MeshletBuilder
+{
+	static const unsigned int MAX_VERTICES = 64;
+	static const unsigned int MAX_TRIANGLES = 124;
+
+	// Reorders the triangles within each level so that every meshlet is a contiguous range of indices and fills
+	// mesh->meshlets (and the meshlet ranges of the levels). Meshlets grow from the first free triangle in index order
+	// over neighbouring triangles, so run it after MeshOptimizer::OptimizeVertexCache to keep the cache order.
+	void Build(Mesh *mesh, unsigned int maxVertices = MAX_VERTICES, unsigned int maxTriangles = MAX_TRIANGLES);
+	// Bounding sphere and normal cone of a triangle list
+	Meshlet ComputeBounds(const Mesh &mesh, const uint32_t *indices, unsigned int indexCount);
+}
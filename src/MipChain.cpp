@@ -0,0 +1,343 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define MIP_CHAIN_SSE2 1
+#endif
+
+#include "stb_image.h"
+
+#include "Graphics.h"
+#include "IOUtil.h"
+#include "Parallel.h"
+#include "TextureFile.h"
+#include "MipChain.h"
+
+static const float PI = 3.14159265358979f;
+// Radius of the Kaiser filter in destination texels and the shape of its window, as in NVIDIA Texture Tools
+static const float KAISER_RADIUS = 2.0f;
+static const float KAISER_ALPHA = 4.0f;
+// Levels with fewer rows than this are filtered on the calling thread only
+static const unsigned int MIN_PARALLEL_ROWS = 64;
+
+// Source taps of every destination texel along one axis, every texel has the same (zero padded) number of taps
+struct FilterTaps
+{
+	unsigned int tapCount = 0;
+	std::vector<unsigned int> indices;		// [texel * tapCount + tap]
+	std::vector<float> weights;
+};
+
+// Every channel layout is filtered as RGBA, so that one texel is one SSE register
+struct FloatImage
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<float> texels;
+};
+
+static float SRGBToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (unsigned int k = 1; k < 32; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static float Sinc(float x)
+{
+	return fabsf(x) < 1e-6f ? 1.0f : sinf(PI * x) / (PI * x);
+}
+
+static float Kaiser(float x)
+{
+	float t = x / KAISER_RADIUS;
+	if (fabsf(t) >= 1.0f)
+		return 0.0f;
+	return Sinc(x) * float(BesselI0(KAISER_ALPHA * sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA));
+}
+
+static unsigned int WrapIndex(int index, unsigned int size, GLenum wrap)
+{
+	if (wrap == GL_REPEAT)
+		return unsigned(((index % int(size)) + int(size)) % int(size));
+	if (wrap == GL_MIRRORED_REPEAT)
+	{
+		int period = 2 * int(size);
+		int mirrored = ((index % period) + period) % period;
+		return unsigned(mirrored < int(size) ? mirrored : period - 1 - mirrored);
+	}
+	return unsigned(std::min(std::max(index, 0), int(size) - 1));
+}
+
+static FilterTaps InitFilterTaps(unsigned int sourceSize, unsigned int size, MipFilter::Type filter, GLenum wrap)
+{
+	// Footprint of one destination texel in source texels
+	float scale = float(sourceSize) / float(size);
+	float radius = filter == MipFilter::Box ? 0.5f * scale : KAISER_RADIUS * scale;
+
+	FilterTaps taps;
+	taps.tapCount = (unsigned int)ceilf(2.0f * radius) + 1;
+	taps.indices.assign(size * taps.tapCount, 0);
+	taps.weights.assign(size * taps.tapCount, 0.0f);
+	for (unsigned int x = 0; x < size; ++x)
+	{
+		float center = (float(x) + 0.5f) * scale;
+		int first = int(floorf(center - radius));
+		float totalWeight = 0.0f;
+		for (unsigned int tap = 0; tap < taps.tapCount; ++tap)
+		{
+			int source = first + int(tap);
+			float weight;
+			if (filter == MipFilter::Box)
+			{
+				// Overlap of the source texel with the box
+				weight = std::max(0.0f, std::min(float(source + 1), center + radius) - std::max(float(source), center - radius));
+			}
+			else
+			{
+				weight = Kaiser((float(source) + 0.5f - center) / scale);
+			}
+			taps.indices[x * taps.tapCount + tap] = WrapIndex(source, sourceSize, wrap);
+			taps.weights[x * taps.tapCount + tap] = weight;
+			totalWeight += weight;
+		}
+		for (unsigned int tap = 0; tap < taps.tapCount; ++tap)
+			taps.weights[x * taps.tapCount + tap] /= totalWeight;
+	}
+	return taps;
+}
+
+// dst += weight * src for count RGBA texels
+static inline void AddWeighted(float *dst, const float *src, float weight, unsigned int count)
+{
+	unsigned int i = 0;
+#ifdef MIP_CHAIN_SSE2
+	__m128 w = _mm_set1_ps(weight);
+	for (; i + 4 <= 4 * count; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+#endif
+	for (; i < 4 * count; ++i)
+		dst[i] += weight * src[i];
+}
+
+// Separable filter, the rows are reduced first so the vertical pass only runs on the narrower image
+static void Downsample(const FloatImage &source, FloatImage *image, const MipChainSettings &settings, unsigned int threadCount)
+{
+	FilterTaps horizontalTaps = InitFilterTaps(source.width, image->width, settings.filter, settings.wrap);
+	FilterTaps verticalTaps = InitFilterTaps(source.height, image->height, settings.filter, settings.wrap);
+
+	FloatImage rows;
+	rows.width = image->width;
+	rows.height = source.height;
+	rows.texels.assign(4 * size_t(rows.width) * rows.height, 0.0f);
+	Parallel::For(rows.height, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int y = begin; y < end; ++y)
+		{
+			const float *sourceRow = source.texels.data() + 4 * size_t(y) * source.width;
+			float *row = rows.texels.data() + 4 * size_t(y) * rows.width;
+			for (unsigned int x = 0; x < rows.width; ++x)
+			{
+				const unsigned int *indices = horizontalTaps.indices.data() + x * horizontalTaps.tapCount;
+				const float *weights = horizontalTaps.weights.data() + x * horizontalTaps.tapCount;
+#ifdef MIP_CHAIN_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for (unsigned int tap = 0; tap < horizontalTaps.tapCount; ++tap)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(sourceRow + 4 * indices[tap])));
+				_mm_storeu_ps(row + 4 * x, sum);
+#else
+				for (unsigned int tap = 0; tap < horizontalTaps.tapCount; ++tap)
+					AddWeighted(row + 4 * x, sourceRow + 4 * indices[tap], weights[tap], 1);
+#endif
+			}
+		}
+	}, rows.height >= MIN_PARALLEL_ROWS ? threadCount : 1);
+
+	image->texels.assign(4 * size_t(image->width) * image->height, 0.0f);
+	Parallel::For(image->height, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int y = begin; y < end; ++y)
+		{
+			float *row = image->texels.data() + 4 * size_t(y) * image->width;
+			for (unsigned int tap = 0; tap < verticalTaps.tapCount; ++tap)
+			{
+				float weight = verticalTaps.weights[y * verticalTaps.tapCount + tap];
+				if (weight != 0.0f)
+				{
+					unsigned int sourceY = verticalTaps.indices[y * verticalTaps.tapCount + tap];
+					AddWeighted(row, rows.texels.data() + 4 * size_t(sourceY) * rows.width, weight, image->width);
+				}
+			}
+		}
+	}, image->height >= MIN_PARALLEL_ROWS ? threadCount : 1);
+}
+
+// Linear values at which the rounded sRGB encoding steps to the next byte, and a coarse table of starting guesses
+// for the search, so that encoding is exact without a pow per channel
+struct SRGBEncoder
+{
+	static const unsigned int GUESS_COUNT = 4096;
+	float thresholds[255];
+	uint8_t guesses[GUESS_COUNT];
+
+	SRGBEncoder()
+	{
+		for (unsigned int i = 0; i < 255; ++i)
+			thresholds[i] = SRGBToLinear((float(i) + 0.5f) / 255.0f);
+		for (unsigned int i = 0; i < GUESS_COUNT; ++i)
+			guesses[i] = uint8_t(std::upper_bound(thresholds, thresholds + 255, float(i) / float(GUESS_COUNT - 1)) - thresholds);
+	}
+
+	uint8_t Encode(float value) const
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		unsigned int encoded = guesses[unsigned(value * float(GUESS_COUNT - 1))];
+		while (encoded < 255 && value >= thresholds[encoded])
+			++encoded;
+		while (encoded > 0 && value < thresholds[encoded - 1])
+			--encoded;
+		return uint8_t(encoded);
+	}
+};
+
+static void Encode(const FloatImage &image, unsigned int channelCount, bool srgb, const SRGBEncoder &srgbEncoder, std::vector<uint8_t> *level)
+{
+	level->resize(size_t(image.width) * image.height * channelCount);
+	size_t texelCount = size_t(image.width) * image.height;
+	for (size_t i = 0; i < texelCount; ++i)
+	{
+		for (unsigned int c = 0; c < channelCount; ++c)
+		{
+			float value = image.texels[4 * i + c];
+			uint8_t encoded;
+			if (srgb && c < 3)
+				encoded = srgbEncoder.Encode(value);
+			else
+				encoded = uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+			(*level)[i * channelCount + c] = encoded;
+		}
+	}
+}
+
+bool MipChain::Build(TextureData *data, const MipChainSettings &settings, unsigned int threadCount)
+{
+	unsigned int channelCount = 0;
+	switch (data->format)
+	{
+		case GL_RED: channelCount = 1; break;
+		case GL_RG: channelCount = 2; break;
+		case GL_RGB: channelCount = 3; break;
+		case GL_RGBA: channelCount = 4; break;
+	}
+	if (data->target != TextureTarget::Texture2D || data->type != GL_UNSIGNED_BYTE || channelCount == 0 || data->levels.empty())
+	{
+		std::cerr << "ERROR: Mip chains can only be built for 8 bit 2D textures\n";
+		return false;
+	}
+
+	float decode[256];
+	for (unsigned int i = 0; i < 256; ++i)
+		decode[i] = settings.srgb ? SRGBToLinear(float(i) / 255.0f) : float(i) / 255.0f;
+	SRGBEncoder srgbEncoder;
+
+	FloatImage image;
+	image.width = data->width;
+	image.height = data->height;
+	image.texels.assign(4 * size_t(image.width) * image.height, 0.0f);
+	const uint8_t *bytes = data->levels[0].data();
+	for (size_t i = 0; i < size_t(image.width) * image.height; ++i)
+	{
+		for (unsigned int c = 0; c < channelCount; ++c)
+		{
+			uint8_t value = bytes[i * channelCount + c];
+			image.texels[4 * i + c] = c < 3 ? decode[value] : float(value) / 255.0f;
+		}
+	}
+
+	unsigned int mipCount = 1;
+	while ((std::max(data->width, data->height) >> mipCount) > 0)
+		++mipCount;
+	data->levels.resize(mipCount);
+	data->mipCount = mipCount;
+	data->wrap = settings.wrap;
+	for (unsigned int mip = 1; mip < mipCount; ++mip)
+	{
+		FloatImage mipImage;
+		mipImage.width = std::max(image.width / 2, 1u);
+		mipImage.height = std::max(image.height / 2, 1u);
+		Downsample(image, &mipImage, settings, threadCount);
+		Encode(mipImage, channelCount, settings.srgb, srgbEncoder, &data->levels[mip]);
+		image = std::move(mipImage);
+	}
+	return true;
+}
+
+std::string MipChain::CookedFile(const char *sourceFile, const MipChainSettings &settings)
+{
+	const char *wrap = settings.wrap == GL_REPEAT ? "repeat" : settings.wrap == GL_MIRRORED_REPEAT ? "mirror" : "clamp";
+	std::string file = sourceFile;
+	if (!settings.cookDirectory.empty())
+		file = settings.cookDirectory + file.substr(file.find_last_of("/\\") + 1);
+	return file + "." + MipChain::FilterName(settings.filter) + (settings.srgb ? "_srgb_" : "_linear_") + wrap + ".tex";
+}
+
+bool MipChain::Load(const char *sourceFile, const MipChainSettings &settings, TextureData *data, unsigned int threadCount)
+{
+	std::string cookedFile = MipChain::CookedFile(sourceFile, settings);
+	time_t sourceTime = 0, cookedTime = 0;
+	if (IOUtil::FileExists(cookedFile.c_str()) && IOUtil::GetFileModificationTime(cookedFile.c_str(), &cookedTime) && IOUtil::GetFileModificationTime(sourceFile, &sourceTime) &&
+		cookedTime >= sourceTime && TextureFile::Read(cookedFile.c_str(), data))
+		return true;
+
+	int width, height, numChannels;
+	unsigned char *pixels = stbi_load(sourceFile, &width, &height, &numChannels, 0);
+	if (!pixels)
+		return false;
+
+	const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	*data = TextureData();
+	data->target = TextureTarget::Texture2D;
+	data->internalFormat = data->format = formats[numChannels - 1];
+	data->type = GL_UNSIGNED_BYTE;
+	data->width = (unsigned int)width;
+	data->height = (unsigned int)height;
+	data->mipCount = 1;
+	data->levels.push_back(std::vector<uint8_t>(pixels, pixels + size_t(width) * size_t(height) * numChannels));
+	stbi_image_free(pixels);
+
+	if (!MipChain::Build(data, settings, threadCount))
+		return false;
+	// Loader threads may cook the same image at once, each one writes its own file and renames it into place
+	if (!settings.cookDirectory.empty())
+		IOUtil::MakeDirectory(settings.cookDirectory.c_str());
+	std::ostringstream partialFile;
+	partialFile << cookedFile << "." << std::this_thread::get_id() << ".partial";
+	remove(cookedFile.c_str());
+	if (!TextureFile::Write(partialFile.str().c_str(), *data) || rename(partialFile.str().c_str(), cookedFile.c_str()) != 0)
+	{
+		std::cerr << "WARNING: Unable to write the mip chain of " << sourceFile << " to " << cookedFile << "\n";
+		remove(partialFile.str().c_str());
+	}
+	return true;
+}
+
+const char *MipChain::FilterName(MipFilter::Type filter)
+{
+	const char *names[] = { "box", "kaiser" };
+	return filter < MipFilter::FilterCount ? names[filter] : "unknown";
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+#include <glad/glad.h>
+
+struct TextureData;
+
+namespace MipFilter
+{
+	enum Type
+	{
+		Box,		// Same footprint as glGenerateMipmap
+		Kaiser,		// Kaiser windowed sinc, keeps more detail in the smaller mips without aliasing
+		FilterCount
+	};
+}
+
+struct MipChainSettings
+{
+	MipFilter::Type filter = MipFilter::Kaiser;
+	bool srgb = false;				// Color channels are sRGB encoded (albedo) and filtered in linear space, alpha is always linear
+	GLenum wrap = GL_REPEAT;		// Addressing of the filter taps past the edges
+	std::string cookDirectory;		// Directory the chain is cooked to (ending in a separator), next to the source image if empty
+};
+
+// CPU mip chain builder for 8 bit textures. Levels are filtered separably in float from the previous level (not from
+// the rounded bytes) with SSE2 where available. Built chains are cooked to a TextureFile (next to the source image or in
+// MipChainSettings::cookDirectory) so the next start loads the complete chain instead of generating it.
+namespace MipChain
+{
+	// Replaces any mips of an 8 bit 2D texture with a complete chain down to 1x1, returns false for other formats
+	bool Build(TextureData *data, const MipChainSettings &settings, unsigned int threadCount = 0);
+	// e.g. roughness.png.kaiser_linear_repeat.tex
+	std::string CookedFile(const char *sourceFile, const MipChainSettings &settings);
+	// Reads the cooked file if it is at least as new as the source image. Otherwise decodes the source with the current
+	// stb_image flip setting, builds the chain and writes the cooked file for the next time.
+	bool Load(const char *sourceFile, const MipChainSettings &settings, TextureData *data, unsigned int threadCount = 0);
+	const char *FilterName(MipFilter::Type filter);
+}
@@ -0,0 +1,47 @@
+#include <thread>
+#include <vector>
+
+#include "Parallel.h"
+
+unsigned int Parallel::ThreadCount()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+void Parallel::For(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)> &body, unsigned int threadCount)
+{
+	if (count == 0)
+		return;
+
+	if (threadCount == 0)
+		threadCount = Parallel::ThreadCount();
+	if (threadCount > count)
+		threadCount = count;
+
+	if (threadCount == 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	// The calling thread takes the first range itself
+	std::vector<std::thread> workers;
+	unsigned int rangeSize = count / threadCount;
+	unsigned int remainder = count % threadCount;
+	unsigned int begin = 0;
+	unsigned int firstEnd = 0;
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		unsigned int end = begin + rangeSize + (i < remainder ? 1 : 0);
+		if (i == 0)
+			firstEnd = end;
+		else
+			workers.push_back(std::thread(body, begin, end));
+		begin = end;
+	}
+
+	body(0, firstEnd);
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
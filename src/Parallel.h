@@ -0,0 +1,12 @@
+#pragma once
+
+#include <functional>
+
+namespace Parallel
+{
+	unsigned int ThreadCount();
+
+	// Splits [0, count) into contiguous ranges and runs body(begin, end) for each of them on its own thread.
+	// Returns once every range has been processed. threadCount = 0 uses all hardware threads.
+	void For(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)> &body, unsigned int threadCount = 0);
+}
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define RADIANCE_HDR_SSE2 1
+#endif
+
+#include <glm/gtc/packing.hpp>
+
+#include "IOUtil.h"
+#include "Parallel.h"
+#include "RadianceHDR.h"
+
+// Scanlines of these widths are always stored flat, the RLE header can only encode 15 bit widths
+static const unsigned int MIN_RLE_WIDTH = 8;
+static const unsigned int MAX_RLE_WIDTH = 32767;
+// Scanlines decoded by one task, small enough to balance the threads and large enough to amortize the task
+static const unsigned int ROWS_PER_CHUNK = 16;
+
+static bool HasSignature(const uint8_t *data, size_t size)
+{
+	const char *signatures[] = { "#?RADIANCE\n", "#?RGBE\n" };
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		size_t length = strlen(signatures[i]);
+		if (size >= length && memcmp(data, signatures[i], length) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Reads a header line without the newline, returns false at the end of the data
+static bool ReadLine(const uint8_t *data, size_t size, size_t *offset, std::string *line)
+{
+	const uint8_t *begin = data + *offset;
+	const uint8_t *end = (const uint8_t *)memchr(begin, '\n', size - *offset);
+	if (!end)
+		return false;
+	line->assign((const char *)begin, end - begin);
+	*offset = size_t(end - data) + 1;
+	return true;
+}
+
+static bool IsRLEScanline(const uint8_t *data, size_t size, size_t offset, unsigned int width)
+{
+	if (width < MIN_RLE_WIDTH || width > MAX_RLE_WIDTH || offset + 4 > size)
+		return false;
+	const uint8_t *header = data + offset;
+	return header[0] == 2 && header[1] == 2 && !(header[2] & 0x80) && ((unsigned int)header[2] << 8 | header[3]) == width;
+}
+
+// Returns the offset of the next scanline, or 0 if the scanline runs past the end of the data
+static size_t SkipScanline(const uint8_t *data, size_t size, size_t offset, unsigned int width)
+{
+	if (!IsRLEScanline(data, size, offset, width))
+		return offset + 4 * size_t(width) <= size ? offset + 4 * size_t(width) : 0;
+
+	offset += 4;
+	for (unsigned int channel = 0; channel < 4; ++channel)
+	{
+		unsigned int x = 0;
+		while (x < width)
+		{
+			if (offset >= size)
+				return 0;
+			unsigned int count = data[offset++];
+			if (count > 128)
+			{
+				x += count - 128;
+				offset += 1;
+			}
+			else
+			{
+				x += count;
+				offset += count;
+			}
+		}
+		if (x != width || offset > size)
+			return 0;
+	}
+	return offset;
+}
+
+// Decodes one scanline into interleaved RGBE bytes, the offset has been validated by SkipScanline
+static void DecodeScanline(const uint8_t *data, size_t size, size_t offset, unsigned int width, uint8_t *rgbe)
+{
+	if (!IsRLEScanline(data, size, offset, width))
+	{
+		memcpy(rgbe, data + offset, 4 * size_t(width));
+		return;
+	}
+
+	offset += 4;
+	for (unsigned int channel = 0; channel < 4; ++channel)
+	{
+		uint8_t *out = rgbe + channel;
+		unsigned int x = 0;
+		while (x < width)
+		{
+			unsigned int count = data[offset++];
+			if (count > 128)
+			{
+				uint8_t value = data[offset++];
+				for (count -= 128; count > 0; --count, ++x)
+					out[4 * x] = value;
+			}
+			else
+			{
+				for (; count > 0; --count, ++x)
+					out[4 * x] = data[offset++];
+			}
+		}
+	}
+}
+
+// Same value as stbi__hdr_convert (m * 2^(e - 136), black for e = 0), rounded to the nearest half
+static inline uint16_t RGBEToHalf(uint8_t mantissa, uint8_t exponent)
+{
+	if (exponent == 0)
+		return 0;
+	return glm::packHalf1x16(float(mantissa) * ldexpf(1.0f, int(exponent) - (128 + 8)));
+}
+
+#ifdef RADIANCE_HDR_SSE2
+// Round to nearest even float to half conversion of non-negative finite values, overflows become +infinity
+// Source: https://gist.github.com/rygorous/2156668 (float_to_half_rtne_SSE2)
+static inline __m128i FloatToHalfSSE2(__m128 f)
+{
+	const __m128i halfMaxExponent = _mm_set1_epi32((127 + 16) << 23);		// Values >= this round to infinity
+	const __m128i halfInfinity = _mm_set1_epi32(0x7c00);
+	const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);			// Smallest value with a normalized half
+	const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+	__m128i bits = _mm_castps_si128(f);
+	__m128i isFinite = _mm_cmpgt_epi32(halfMaxExponent, bits);
+	__m128i isSubnormal = _mm_cmpgt_epi32(minNormal, bits);
+
+	// The float addition rounds the mantissa of the subnormal result
+	__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(f, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+	// Bias towards rounding up if the last half mantissa bit is odd
+	__m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+	__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(bits, normalBias), mantissaOdd), 13);
+
+	__m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+	return _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, halfInfinity));
+}
+#endif
+
+// Converts count RGBE pixels to RGB halves. The float values only ever exist in registers.
+static void ConvertScanline(const uint8_t *rgbe, uint16_t *rgb, unsigned int count)
+{
+	unsigned int x = 0;
+#ifdef RADIANCE_HDR_SSE2
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+	const __m128i exponentBias = _mm_set1_epi32(128 + 8 - 127);
+	const __m128i minExponent = _mm_set1_epi32(128 + 8 - 126);		// Below this the scale is not a normal float
+	for (; x + 4 <= count; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(rgbe + 4 * x));
+		__m128i exponent = _mm_srli_epi32(pixels, 24);
+		// 2^(e - 136) built directly in the exponent bits, zero for e = 0 and for results below the half range anyway
+		__m128i scaleBits = _mm_slli_epi32(_mm_sub_epi32(exponent, exponentBias), 23);
+		__m128 scale = _mm_castsi128_ps(_mm_andnot_si128(_mm_cmplt_epi32(exponent, minExponent), scaleBits));
+
+		__m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, byteMask)), scale);
+		__m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask)), scale);
+		__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask)), scale);
+
+		// Halves are at most 0x7c00, so the signed saturation of the pack never triggers
+		__m128i rg = _mm_packs_epi32(FloatToHalfSSE2(r), FloatToHalfSSE2(g));
+		__m128i bb = _mm_packs_epi32(FloatToHalfSSE2(b), FloatToHalfSSE2(b));
+		uint16_t *out = rgb + 3 * x;
+		out[0] = (uint16_t)_mm_extract_epi16(rg, 0);
+		out[1] = (uint16_t)_mm_extract_epi16(rg, 4);
+		out[2] = (uint16_t)_mm_extract_epi16(bb, 0);
+		out[3] = (uint16_t)_mm_extract_epi16(rg, 1);
+		out[4] = (uint16_t)_mm_extract_epi16(rg, 5);
+		out[5] = (uint16_t)_mm_extract_epi16(bb, 1);
+		out[6] = (uint16_t)_mm_extract_epi16(rg, 2);
+		out[7] = (uint16_t)_mm_extract_epi16(rg, 6);
+		out[8] = (uint16_t)_mm_extract_epi16(bb, 2);
+		out[9] = (uint16_t)_mm_extract_epi16(rg, 3);
+		out[10] = (uint16_t)_mm_extract_epi16(rg, 7);
+		out[11] = (uint16_t)_mm_extract_epi16(bb, 3);
+	}
+#endif
+	for (; x < count; ++x)
+	{
+		const uint8_t *pixel = rgbe + 4 * x;
+		rgb[3 * x + 0] = RGBEToHalf(pixel[0], pixel[3]);
+		rgb[3 * x + 1] = RGBEToHalf(pixel[1], pixel[3]);
+		rgb[3 * x + 2] = RGBEToHalf(pixel[2], pixel[3]);
+	}
+}
+
+bool RadianceHDR::IsRadianceFile(const char *file)
+{
+	std::ifstream in(file, std::ios::binary | std::ios::in);
+	char signature[16] = {};
+	in.read(signature, sizeof(signature));
+	return HasSignature((const uint8_t *)signature, size_t(in.gcount()));
+}
+
+bool RadianceHDR::Read(const char *file, HalfImage *image, bool flipVertically, unsigned int threadCount)
+{
+	MappedFile mapped;
+	if (!IOUtil::MapFile(file, &mapped))
+		return false;
+	const uint8_t *data = mapped.data;
+	size_t size = mapped.size;
+
+	if (!HasSignature(data, size))
+	{
+		std::cerr << "ERROR: " << file << " is not a Radiance HDR file\n";
+		IOUtil::UnmapFile(&mapped);
+		return false;
+	}
+
+	// Header lines end with an empty line, the resolution line follows
+	size_t offset = 0;
+	std::string line;
+	bool validFormat = true;
+	while (ReadLine(data, size, &offset, &line) && !line.empty())
+	{
+		if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+			validFormat = false;
+	}
+	int width = 0, height = 0;
+	if (!validFormat || !ReadLine(data, size, &offset, &line) || sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+		width <= 0 || height <= 0)
+	{
+		std::cerr << "ERROR: Unsupported format or orientation in " << file << "\n";
+		IOUtil::UnmapFile(&mapped);
+		return false;
+	}
+
+	// Scanlines have variable length, so their offsets have to be found serially. Only the run lengths are read.
+	std::vector<size_t> scanlineOffsets(height);
+	for (int y = 0; y < height; ++y)
+	{
+		scanlineOffsets[y] = offset;
+		offset = SkipScanline(data, size, offset, width);
+		if (offset == 0)
+		{
+			std::cerr << "ERROR: " << file << " is truncated or corrupt\n";
+			IOUtil::UnmapFile(&mapped);
+			return false;
+		}
+	}
+
+	image->width = (unsigned int)width;
+	image->height = (unsigned int)height;
+	image->texels.resize(3 * size_t(width) * size_t(height));
+	unsigned int chunkCount = (unsigned int)(height + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+	Parallel::For(chunkCount, [&](unsigned int begin, unsigned int end)
+	{
+		std::vector<uint8_t> rgbe(4 * size_t(width));
+		unsigned int lastRow = std::min(end * ROWS_PER_CHUNK, (unsigned int)height);
+		for (unsigned int y = begin * ROWS_PER_CHUNK; y < lastRow; ++y)
+		{
+			DecodeScanline(data, size, scanlineOffsets[y], width, rgbe.data());
+			unsigned int row = flipVertically ? height - 1 - y : y;
+			ConvertScanline(rgbe.data(), image->texels.data() + 3 * size_t(row) * size_t(width), width);
+		}
+	}, threadCount);
+
+	IOUtil::UnmapFile(&mapped);
+	return true;
+}
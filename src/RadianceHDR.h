@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// RGB half float image, rows are stored in file order (top to bottom) unless they were flipped while reading
+struct HalfImage
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<uint16_t> texels;
+};
+
+// Reader for Radiance .hdr (RGBE) files. The file is memory mapped, the scanlines are located in one serial pass over
+// the run lengths and then decoded in parallel chunks straight to half floats (no float32 copy of the image is made).
+// Supports the same subset as stb_image: 32-bit_rle_rgbe with the -Y h +X w orientation, flat or new style RLE scanlines.
+namespace RadianceHDR
+{
+	bool IsRadianceFile(const char *file);
+	// flipVertically puts the last row first, like stbi_set_flip_vertically_on_load(true)
+	bool Read(const char *file, HalfImage *image, bool flipVertically, unsigned int threadCount = 0);
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "StartupProfile.h"
+
+static const unsigned int NO_PHASE = ~0u;
+
+void StartupProfileControl::Start(StartupProfile *profile)
+{
+	StartupProfileControl::Release(profile);
+	profile->recording = true;
+}
+
+void StartupProfileControl::Stop(StartupProfile *profile)
+{
+	while (!profile->open.empty())
+		StartupProfileControl::EndPhase(profile, profile->open.back());
+	profile->recording = false;
+}
+
+unsigned int StartupProfileControl::BeginPhase(StartupProfile *profile, const std::string &name)
+{
+	if (!profile->recording)
+		return NO_PHASE;
+
+	ProfilePhase phase;
+	phase.name = name;
+	phase.depth = (unsigned int)profile->open.size();
+	glGenQueries(2, phase.queries);
+	glQueryCounter(phase.queries[0], GL_TIMESTAMP);
+	phase.start = std::chrono::high_resolution_clock::now();
+	profile->phases.push_back(phase);
+	profile->open.push_back((unsigned int)profile->phases.size() - 1);
+	return profile->open.back();
+}
+
+void StartupProfileControl::EndPhase(StartupProfile *profile, unsigned int phase)
+{
+	if (phase == NO_PHASE || phase >= profile->phases.size() || profile->open.empty() || profile->open.back() != phase)
+		return;
+
+	ProfilePhase *ended = &profile->phases[phase];
+	ended->cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - ended->start).count();
+	glQueryCounter(ended->queries[1], GL_TIMESTAMP);
+	profile->open.pop_back();
+}
+
+bool StartupProfileControl::Resolve(StartupProfile *profile, bool wait)
+{
+	if (profile->resolved || profile->recording)
+		return profile->resolved;
+
+	for (unsigned int i = 0; i < profile->phases.size() && !wait; ++i)
+	{
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(profile->phases[i].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+	}
+
+	for (unsigned int i = 0; i < profile->phases.size(); ++i)
+	{
+		ProfilePhase *phase = &profile->phases[i];
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(phase->queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(phase->queries[1], GL_QUERY_RESULT, &end);
+		phase->gpuMs = end > start ? double(end - start) / 1.0e6 : 0.0;
+		glDeleteQueries(2, phase->queries);
+		phase->queries[0] = phase->queries[1] = 0;
+	}
+	profile->resolved = true;
+	return true;
+}
+
+void StartupProfileControl::Print(const StartupProfile &profile)
+{
+	std::cout << "Startup phases (CPU ms / GPU ms):\n" << std::fixed << std::setprecision(2);
+	for (unsigned int i = 0; i < profile.phases.size(); ++i)
+	{
+		const ProfilePhase &phase = profile.phases[i];
+		std::cout << "  " << std::string(2 * phase.depth, ' ') << phase.name << ": " << phase.cpuMs << " / ";
+		if (profile.resolved)
+			std::cout << phase.gpuMs << "\n";
+		else
+			std::cout << "-\n";
+	}
+	std::cout << std::defaultfloat;
+}
+
+void StartupProfileControl::Release(StartupProfile *profile)
+{
+	for (unsigned int i = 0; i < profile->phases.size(); ++i)
+	{
+		if (profile->phases[i].queries[0] != 0)
+			glDeleteQueries(2, profile->phases[i].queries);
+	}
+	*profile = StartupProfile();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <glad/glad.h>
+
+struct ProfilePhase
+{
+	std::string name;
+	unsigned int depth = 0;					// Number of enclosing phases
+	double cpuMs = 0.0;						// Wall clock of the GL thread
+	double gpuMs = 0.0;						// Between GL_TIMESTAMP queries at the start and the end, valid once resolved
+	GLuint queries[2] = {};
+	std::chrono::high_resolution_clock::time_point start;
+};
+
+// Records how long the phases of App::Init take on the CPU and on the GPU. The GPU times come from timestamp queries
+// at the start and the end of every phase (GL_TIME_ELAPSED queries cannot nest), they are read back by Resolve once
+// the GPU has finished, so recording does not stall the GL thread.
+struct StartupProfile
+{
+	bool recording = false;
+	bool resolved = false;
+	std::vector<ProfilePhase> phases;		// In start order
+	std::vector<unsigned int> open;			// Phases that have not ended yet, innermost last
+};
+
+namespace StartupProfileControl
+{
+	// Clears the profile, phases are recorded until Stop
+	void Start(StartupProfile *profile);
+	void Stop(StartupProfile *profile);
+	// Returns an id for EndPhase, phases begun while not recording are ignored
+	unsigned int BeginPhase(StartupProfile *profile, const std::string &name);
+	void EndPhase(StartupProfile *profile, unsigned int phase);
+	// Reads the GPU times back and deletes the queries. Returns false if wait is false and the GPU is not done yet.
+	bool Resolve(StartupProfile *profile, bool wait);
+	void Print(const StartupProfile &profile);
+	void Release(StartupProfile *profile);
+}
+
+// Times the enclosing scope as one phase of the profile
+struct ProfileScope
+{
+	StartupProfile *profile;
+	unsigned int phase;
+
+	ProfileScope(StartupProfile *profile, const std::string &name)
+	{
+		this->profile = profile;
+		this->phase = StartupProfileControl::BeginPhase(profile, name);
+	}
+
+	~ProfileScope()
+	{
+		StartupProfileControl::EndPhase(profile, phase);
+	}
+};
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "Graphics.h"
+#include "BlockCompression.h"
+#include "IOUtil.h"
+#include "TextureFile.h"
+
+static const char TEXTURE_FILE_MAGIC[4] = { 'P', 'B', 'R', 'T' };
+static const uint32_t TEXTURE_FILE_VERSION = 1;
+
+struct TextureFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t target;
+	uint32_t internalFormat;
+	uint32_t format;
+	uint32_t type;
+	uint32_t wrap;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+	uint32_t levelCount;
+};
+
+uint64_t TextureFile::ExpectedLevelSize(const TextureData &description, unsigned int mip)
+{
+	uint64_t width = std::max(description.width >> mip, 1u);
+	uint64_t height = std::max(description.height >> mip, 1u);
+	switch (description.internalFormat)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return (width + 3) / 4 * ((height + 3) / 4) * 8;
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+			return (width + 3) / 4 * ((height + 3) / 4) * 16;
+	}
+
+	uint64_t channelCount = 0, channelBytes = 0;
+	switch (description.format)
+	{
+		case GL_RED:	channelCount = 1; break;
+		case GL_RG:		channelCount = 2; break;
+		case GL_RGB:	channelCount = 3; break;
+		case GL_RGBA:	channelCount = 4; break;
+	}
+	switch (description.type)
+	{
+		case GL_UNSIGNED_BYTE:	channelBytes = 1; break;
+		case GL_HALF_FLOAT:		channelBytes = 2; break;
+		case GL_FLOAT:			channelBytes = 4; break;
+	}
+	return width * height * channelCount * channelBytes;
+}
+
+static uint64_t ExpectedLevelSize(const TextureFileHeader &header, unsigned int mip)
+{
+	TextureData description;
+	description.internalFormat = header.internalFormat;
+	description.format = header.format;
+	description.type = header.type;
+	description.width = header.width;
+	description.height = header.height;
+	return TextureFile::ExpectedLevelSize(description, mip);
+}
+
+// Checks everything but the levels, a mipCount beyond the size of a level's dimensions is rejected too
+static bool ValidHeader(const TextureFileHeader &header)
+{
+	unsigned int faceCount = header.target == TextureTarget::Cubemap ? 6 : 1;
+	return memcmp(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic)) == 0 && header.version == TEXTURE_FILE_VERSION &&
+		   (header.target == TextureTarget::Texture2D || header.target == TextureTarget::Cubemap) &&
+		   header.width > 0 && header.height > 0 && header.mipCount > 0 && header.mipCount <= 32 &&
+		   header.levelCount == header.mipCount * faceCount && ExpectedLevelSize(header, 0) > 0;
+}
+
+bool TextureFile::Write(const char *file, const TextureData &data)
+{
+	std::ofstream out(file, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR: Unable to open " << file << " for writing\n";
+		return false;
+	}
+
+	TextureFileHeader header;
+	memcpy(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic));
+	header.version = TEXTURE_FILE_VERSION;
+	header.target = data.target;
+	header.internalFormat = data.internalFormat;
+	header.format = data.format;
+	header.type = data.type;
+	header.wrap = data.wrap;
+	header.width = data.width;
+	header.height = data.height;
+	header.mipCount = data.mipCount;
+	header.levelCount = (uint32_t)data.levels.size();
+	out.write((const char *)&header, sizeof(header));
+
+	for (unsigned int i = 0; i < data.levels.size(); ++i)
+	{
+		uint64_t levelSize = data.levels[i].size();
+		out.write((const char *)&levelSize, sizeof(levelSize));
+		out.write((const char *)data.levels[i].data(), levelSize);
+	}
+	return out.good();
+}
+
+bool TextureFile::Read(const char *file, TextureData *data)
+{
+	std::ifstream in(file, std::ios::binary | std::ios::in | std::ios::ate);
+	if (!in.is_open())
+		return false;
+	uint64_t remaining = uint64_t(in.tellg());
+	in.seekg(0);
+
+	TextureFileHeader header;
+	in.read((char *)&header, sizeof(header));
+	bool valid = in.good() && remaining >= sizeof(header) && ValidHeader(header);
+	if (valid)
+		remaining -= sizeof(header);
+
+	// Every level has to have its format's size and be in the file before anything is allocated for it
+	TextureData result;
+	unsigned int faceCount = valid && header.target == TextureTarget::Cubemap ? 6 : 1;
+	result.levels.resize(valid ? header.levelCount : 0);
+	for (unsigned int i = 0; valid && i < header.levelCount; ++i)
+	{
+		uint64_t levelSize = 0;
+		in.read((char *)&levelSize, sizeof(levelSize));
+		valid = in.good() && remaining >= sizeof(levelSize) && levelSize == ExpectedLevelSize(header, i / faceCount) &&
+				levelSize <= remaining - sizeof(levelSize);
+		if (!valid)
+			break;
+		remaining -= sizeof(levelSize) + levelSize;
+		result.levels[i].resize(size_t(levelSize));
+		in.read((char *)result.levels[i].data(), levelSize);
+		valid = in.good();
+	}
+	if (!valid)
+	{
+		std::cerr << "ERROR: " << file << " is not a valid texture file\n";
+		return false;
+	}
+
+	result.target = TextureTarget(header.target);
+	result.internalFormat = header.internalFormat;
+	result.format = header.format;
+	result.type = header.type;
+	result.wrap = header.wrap;
+	result.width = header.width;
+	result.height = header.height;
+	result.mipCount = header.mipCount;
+	*data = std::move(result);
+	return true;
+}
+
+bool TextureFile::Map(const char *file, MappedFile *mappedFile, TextureData *description, std::vector<TextureLevelView> *levels)
+{
+	if (!IOUtil::MapFile(file, mappedFile))
+		return false;
+
+	TextureFileHeader header;
+	bool valid = mappedFile->size >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, mappedFile->data, sizeof(header));
+		valid = ValidHeader(header);
+	}
+	unsigned int faceCount = valid && header.target == TextureTarget::Cubemap ? 6 : 1;
+
+	levels->clear();
+	size_t offset = sizeof(header);
+	for (unsigned int i = 0; valid && i < header.levelCount; ++i)
+	{
+		uint64_t levelSize = 0;
+		valid = mappedFile->size - offset >= sizeof(levelSize);
+		if (!valid)
+			break;
+		memcpy(&levelSize, mappedFile->data + offset, sizeof(levelSize));
+		offset += sizeof(levelSize);
+		valid = levelSize == ExpectedLevelSize(header, i / faceCount) && levelSize <= mappedFile->size - offset;
+		if (!valid)
+			break;
+		TextureLevelView level;
+		level.data = mappedFile->data + offset;
+		level.size = size_t(levelSize);
+		levels->push_back(level);
+		offset += size_t(levelSize);
+	}
+	if (!valid)
+	{
+		std::cerr << "ERROR: " << file << " is not a valid texture file\n";
+		IOUtil::UnmapFile(mappedFile);
+		levels->clear();
+		return false;
+	}
+
+	*description = TextureData();
+	description->target = TextureTarget(header.target);
+	description->internalFormat = header.internalFormat;
+	description->format = header.format;
+	description->type = header.type;
+	description->wrap = header.wrap;
+	description->width = header.width;
+	description->height = header.height;
+	description->mipCount = header.mipCount;
+	return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct TextureData;
+struct TextureLevelView;
+struct MappedFile;
+
+// Binary container for TextureData: a small header followed by every level of every face in upload order
+namespace TextureFile
+{
+	bool Write(const char *file, const TextureData &data);
+	bool Read(const char *file, TextureData *data);
+	// Points levels into a read only mapping of the file instead of reading it, description gets no levels of its own.
+	// The views stay valid until the file is unmapped with IOUtil::UnmapFile.
+	bool Map(const char *file, MappedFile *mappedFile, TextureData *description, std::vector<TextureLevelView> *levels);
+	// Bytes of one face of a mip level as it is uploaded (GL_UNPACK_ALIGNMENT 1), 0 for formats the files do not hold
+	uint64_t ExpectedLevelSize(const TextureData &description, unsigned int mip);
+}
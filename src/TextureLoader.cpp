@@ -0,0 +1,429 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "stb_image.h"
+
+#include "Parallel.h"
+#include "RadianceHDR.h"
+#include "BlockCompression.h"
+#include "TextureLoader.h"
+
+// How long a worker waiting for room in the full result queue (or Flush waiting for results) sleeps before it polls again
+static const std::chrono::milliseconds WORKER_POLL_INTERVAL(1);
+
+static bool DecodeLDR(const char *file, TextureData *data)
+{
+	int width, height, numChannels;
+	unsigned char *pixels = stbi_load(file, &width, &height, &numChannels, 0);
+	if (!pixels)
+		return false;
+
+	const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	data->internalFormat = data->format = formats[numChannels - 1];
+	data->type = GL_UNSIGNED_BYTE;
+	data->width = (unsigned int)width;
+	data->height = (unsigned int)height;
+	data->levels.push_back(std::vector<uint8_t>(pixels, pixels + size_t(width) * size_t(height) * numChannels));
+	stbi_image_free(pixels);
+	return true;
+}
+
+// Radiance files are decoded by RadianceHDR straight to half floats, anything else stb_image can read goes through floats
+static bool DecodeHDR(const char *file, TextureData *data)
+{
+	data->internalFormat = GL_RGB16F;
+	data->format = GL_RGB;
+
+	HalfImage image;
+	if (RadianceHDR::IsRadianceFile(file))
+	{
+		// One thread per file, the other workers decode the other files
+		if (!RadianceHDR::Read(file, &image, true, 1))
+			return false;
+		const uint8_t *bytes = (const uint8_t *)image.texels.data();
+		data->type = GL_HALF_FLOAT;
+		data->width = image.width;
+		data->height = image.height;
+		data->levels.push_back(std::vector<uint8_t>(bytes, bytes + image.texels.size() * sizeof(uint16_t)));
+		return true;
+	}
+
+	int width, height, numComponents;
+	float *pixels = stbi_loadf(file, &width, &height, &numComponents, 3);
+	if (!pixels)
+		return false;
+	const uint8_t *bytes = (const uint8_t *)pixels;
+	data->type = GL_FLOAT;
+	data->width = (unsigned int)width;
+	data->height = (unsigned int)height;
+	data->levels.push_back(std::vector<uint8_t>(bytes, bytes + size_t(width) * size_t(height) * 3 * sizeof(float)));
+	stbi_image_free(pixels);
+	return true;
+}
+
+static void RunWorker(TextureLoader *loader)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(loader->mutex);
+			loader->requested.wait(lock, [=]() { return loader->stop.load(std::memory_order_relaxed) || loader->unclaimedRequests > 0; });
+			if (loader->stop.load(std::memory_order_relaxed))
+				return;
+			--loader->unclaimedRequests;
+		}
+		// Pushed before it was counted, so there is one for this worker
+		TextureLoadRequest request;
+		if (!loader->requests->TryPop(&request))
+			continue;
+
+		DecodedTexture result;
+		result.id = request.id;
+		result.data.target = TextureTarget::Texture2D;
+		result.data.mipCount = 1;
+		if (request.hdr)
+			result.success = DecodeHDR(request.file.c_str(), &result.data);
+		else if (request.compression != BlockFormat::None &&
+				 BlockCompression::LoadCooked(request.file.c_str(), request.mipChain, request.compression, &result.data))
+		{
+			result.success = true;
+			result.cookedFile = BlockCompression::CookedFile(request.file.c_str(), request.mipChain, request.compression);
+		}
+		else if (request.generateMipmaps)
+		{
+			result.success = MipChain::Load(request.file.c_str(), request.mipChain, &result.data, 1);
+			result.cookedFile = MipChain::CookedFile(request.file.c_str(), request.mipChain);
+		}
+		else
+			result.success = DecodeLDR(request.file.c_str(), &result.data);
+		while (!loader->decoded->TryPush(result) && !loader->stop.load(std::memory_order_relaxed))
+			std::this_thread::sleep_for(WORKER_POLL_INTERVAL);
+	}
+}
+
+// Returns false if the request queue is full
+static bool PushRequest(TextureLoader *loader, TextureLoadRequest &request)
+{
+	if (!loader->requests->TryPush(request))
+		return false;
+	{
+		std::lock_guard<std::mutex> lock(loader->mutex);
+		++loader->unclaimedRequests;
+	}
+	loader->requested.notify_one();
+	return true;
+}
+
+static TextureUpload *FindUpload(TextureLoader *loader, unsigned int id)
+{
+	for (unsigned int i = 0; i < loader->uploads.size(); ++i)
+	{
+		if (loader->uploads[i].id == id)
+			return &loader->uploads[i];
+	}
+	return nullptr;
+}
+
+static void InitPlaceholder(Texture *texture, const uint8_t color[4])
+{
+	glGenTextures(1, &texture->id);
+	texture->target = TextureTarget::Texture2D;
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	texture->memoryBytes = 4;
+}
+
+static unsigned int MipHeight(const TextureData &data, unsigned int mip)
+{
+	return std::max(data.height >> mip, 1u);
+}
+
+// Rows are uploaded one at a time, block compressed levels in rows of 4x4 blocks
+static unsigned int UploadRowCount(const TextureData &data, unsigned int mip)
+{
+	unsigned int mipHeight = MipHeight(data, mip);
+	return BlockCompression::IsCompressedFormat(data.internalFormat) ? (mipHeight + 3) / 4 : mipHeight;
+}
+
+// Uploads up to budget bytes of the upload's remaining rows through the pixel buffer, a call never spans two mips.
+// Returns the number of bytes uploaded (0 if the buffer could not be mapped, the rows are retried next frame).
+static size_t UploadRows(TextureLoader *loader, TextureUpload *upload, size_t budget)
+{
+	const TextureData &data = upload->data;
+	bool compressed = BlockCompression::IsCompressedFormat(data.internalFormat);
+	unsigned int mipWidth = std::max(data.width >> upload->mip, 1u);
+	unsigned int mipHeight = MipHeight(data, upload->mip);
+	unsigned int mipRowCount = UploadRowCount(data, upload->mip);
+	const std::vector<uint8_t> &level = data.levels[upload->mip];
+	size_t rowBytes = level.size() / mipRowCount;
+	unsigned int rowCount = (unsigned int)std::min(std::max(budget / rowBytes, size_t(1)), size_t(mipRowCount - upload->nextRow));
+	size_t byteCount = rowCount * rowBytes;
+
+	if (upload->uploadTexture == 0)
+	{
+		glGenTextures(1, &upload->uploadTexture);
+		glBindTexture(GL_TEXTURE_2D, upload->uploadTexture);
+		for (unsigned int mip = 0; mip < data.mipCount; ++mip)
+		{
+			if (compressed)
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, mip, data.internalFormat, std::max(data.width >> mip, 1u), MipHeight(data, mip), 0,
+									   GLsizei(data.levels[mip].size()), nullptr);
+			}
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, mip, data.internalFormat, std::max(data.width >> mip, 1u), MipHeight(data, mip), 0,
+							 data.format, data.type, nullptr);
+			}
+		}
+	}
+
+	// Orphaning the buffer lets the driver hand out fresh storage while last frame's copy may still be reading the old one
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, loader->pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, byteCount, nullptr, GL_STREAM_DRAW);
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, byteCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped)
+	{
+		memcpy(mapped, level.data() + upload->nextRow * rowBytes, byteCount);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glBindTexture(GL_TEXTURE_2D, upload->uploadTexture);
+		if (compressed)
+		{
+			unsigned int y = 4 * upload->nextRow;
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, upload->mip, 0, y, mipWidth, std::min(4 * rowCount, mipHeight - y), data.internalFormat,
+									  GLsizei(byteCount), nullptr);
+		}
+		else
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, upload->mip, 0, upload->nextRow, mipWidth, rowCount, data.format, data.type, nullptr);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+		upload->nextRow += rowCount;
+		if (upload->nextRow == mipRowCount)
+		{
+			upload->nextRow = 0;
+			++upload->mip;
+		}
+	}
+	else
+	{
+		std::cerr << "ERROR: Failed to map the texture upload buffer\n";
+		byteCount = 0;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return byteCount;
+}
+
+// Swaps the uploaded texture in place of the placeholder
+static void FinishUpload(TextureLoader *loader, TextureUpload *upload)
+{
+	bool generateMipmaps = upload->options.generateMipmaps && upload->data.mipCount == 1;
+	GLint minFilter = upload->options.generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+	glBindTexture(GL_TEXTURE_2D, upload->uploadTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, upload->options.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, upload->options.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	if (generateMipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D);
+	else
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, upload->data.mipCount - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Graphics::Release(upload->texture);
+	upload->texture->id = upload->uploadTexture;
+	upload->texture->target = TextureTarget::Texture2D;
+	upload->texture->memoryBytes = Graphics::TextureMemoryBytes(upload->texture);
+	upload->uploadTexture = 0;
+	++loader->loadedCount;
+	if (upload->onLoaded)
+		upload->onLoaded(upload->texture, upload->cookedFile);
+}
+
+static void RemoveUpload(TextureLoader *loader, unsigned int id)
+{
+	for (auto it = loader->uploads.begin(); it != loader->uploads.end(); ++it)
+	{
+		if (it->id == id)
+		{
+			loader->uploads.erase(it);
+			return;
+		}
+	}
+}
+
+static void UploadWithinBudget(TextureLoader *loader, size_t budget)
+{
+	while (!loader->overflow.empty() && PushRequest(loader, loader->overflow.front()))
+		loader->overflow.pop_front();
+
+	// Results of cancelled loads no longer have an upload and are dropped
+	DecodedTexture result;
+	while (loader->decoded->TryPop(&result))
+	{
+		TextureUpload *upload = FindUpload(loader, result.id);
+		if (!upload)
+			continue;
+		if (!result.success)
+		{
+			std::cerr << "ERROR: Failed to load texture " << upload->file << "\n";
+			RemoveUpload(loader, result.id);
+			continue;
+		}
+		upload->data = std::move(result.data);
+		upload->cookedFile = std::move(result.cookedFile);
+		upload->decoded = true;
+	}
+
+	// Uploads run in request order, the budget may be split between the end of one texture and the start of the next
+	loader->lastFrameUploadBytes = 0;
+	for (unsigned int i = 0; i < loader->uploads.size() && loader->lastFrameUploadBytes < budget;)
+	{
+		TextureUpload *upload = &loader->uploads[i];
+		if (!upload->decoded)
+		{
+			++i;
+			continue;
+		}
+		// The first upload of a frame always gets at least one row, later ones only when a whole row still fits
+		size_t remaining = budget - loader->lastFrameUploadBytes;
+		if (loader->lastFrameUploadBytes > 0 && remaining < upload->data.levels[upload->mip].size() / UploadRowCount(upload->data, upload->mip))
+			break;
+
+		size_t uploadedBytes = UploadRows(loader, upload, remaining);
+		if (uploadedBytes == 0)
+			break;
+		loader->lastFrameUploadBytes += uploadedBytes;
+		if (upload->mip < upload->data.mipCount)
+			continue;
+
+		// The callback may load more textures, which only appends to the uploads
+		unsigned int id = upload->id;
+		FinishUpload(loader, upload);
+		RemoveUpload(loader, id);
+	}
+}
+
+void TextureLoaderControl::Init(TextureLoader *loader, unsigned int workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::max(Parallel::ThreadCount(), 2u) - 1;
+
+	// stb_image 2.16 keeps the flip flag in a global that the workers cannot set without racing each other. Every
+	// loader in the app flips, so it is set once here and the workers only read it.
+	stbi_set_flip_vertically_on_load(true);
+
+	loader->requests.reset(new LockFreeQueue<TextureLoadRequest>(loader->queueCapacity));
+	loader->decoded.reset(new LockFreeQueue<DecodedTexture>(loader->queueCapacity));
+	loader->stop.store(false);
+	loader->unclaimedRequests = 0;
+	for (unsigned int i = 0; i < workerCount; ++i)
+		loader->workers.push_back(std::thread(RunWorker, loader));
+	glGenBuffers(1, &loader->pixelBuffer);
+}
+
+void TextureLoaderControl::Load(TextureLoader *loader, Texture *texture, const std::string &name, const char *file,
+								const TextureLoadOptions &options, std::function<void(Texture *, const std::string &)> onLoaded)
+{
+	InitPlaceholder(texture, options.placeholder);
+
+	TextureUpload upload;
+	upload.id = loader->nextId++;
+	upload.name = name;
+	upload.file = file;
+	upload.texture = texture;
+	upload.options = options;
+	upload.onLoaded = onLoaded;
+	loader->uploads.push_back(std::move(upload));
+
+	TextureLoadRequest request;
+	request.id = loader->uploads.back().id;
+	request.file = file;
+	request.hdr = options.hdr;
+	request.generateMipmaps = options.generateMipmaps;
+	request.mipChain.filter = options.mipFilter;
+	request.mipChain.srgb = options.srgb;
+	request.mipChain.wrap = options.wrap;
+	request.mipChain.cookDirectory = options.cookDirectory;
+	request.compression = options.compression;
+	if (!loader->overflow.empty() || !PushRequest(loader, request))
+		loader->overflow.push_back(request);
+}
+
+void TextureLoaderControl::Update(TextureLoader *loader)
+{
+	UploadWithinBudget(loader, loader->uploadBudgetBytes);
+}
+
+void TextureLoaderControl::Cancel(TextureLoader *loader, const std::string &name)
+{
+	for (unsigned int i = 0; i < loader->uploads.size(); ++i)
+	{
+		TextureUpload *upload = &loader->uploads[i];
+		if (upload->name != name)
+			continue;
+
+		if (upload->uploadTexture != 0)
+			glDeleteTextures(1, &upload->uploadTexture);
+		for (auto it = loader->overflow.begin(); it != loader->overflow.end(); ++it)
+		{
+			if (it->id == upload->id)
+			{
+				loader->overflow.erase(it);
+				break;
+			}
+		}
+		RemoveUpload(loader, upload->id);
+		return;
+	}
+}
+
+void TextureLoaderControl::Flush(TextureLoader *loader)
+{
+	while (!TextureLoaderControl::IsIdle(*loader))
+	{
+		UploadWithinBudget(loader, SIZE_MAX);
+		if (!TextureLoaderControl::IsIdle(*loader))
+			std::this_thread::sleep_for(WORKER_POLL_INTERVAL);
+	}
+}
+
+bool TextureLoaderControl::IsIdle(const TextureLoader &loader)
+{
+	return loader.uploads.empty();
+}
+
+void TextureLoaderControl::Release(TextureLoader *loader)
+{
+	{
+		// Under the lock, so that no worker misses it between checking and waiting
+		std::lock_guard<std::mutex> lock(loader->mutex);
+		loader->stop.store(true);
+	}
+	loader->requested.notify_all();
+	for (unsigned int i = 0; i < loader->workers.size(); ++i)
+		loader->workers[i].join();
+	loader->workers.clear();
+
+	for (unsigned int i = 0; i < loader->uploads.size(); ++i)
+	{
+		if (loader->uploads[i].uploadTexture != 0)
+			glDeleteTextures(1, &loader->uploads[i].uploadTexture);
+	}
+	loader->uploads.clear();
+	loader->overflow.clear();
+	loader->requests.reset();
+	loader->decoded.reset();
+	if (loader->pixelBuffer != 0)
+		glDeleteBuffers(1, &loader->pixelBuffer);
+	loader->pixelBuffer = 0;
+}
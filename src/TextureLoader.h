@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "Graphics.h"
+#include "MipChain.h"
+#include "BlockCompression.h"
+#include "LockFreeQueue.h"
+
+struct TextureLoadOptions
+{
+	bool hdr = false;						// Decoded to RGB16F, anything else to 8 bits per channel
+	bool generateMipmaps = true;			// 8 bit textures get a cooked CPU mip chain (see MipChain), HDR ones glGenerateMipmap
+	MipFilter::Type mipFilter = MipFilter::Kaiser;
+	bool srgb = false;						// Color channels are sRGB encoded, only affects the mip filtering
+	BlockFormat::Type compression = BlockFormat::None;	// Used if cooktex has cooked the image in this format, see BlockCompression
+	GLenum wrap = GL_REPEAT;
+	std::string cookDirectory;				// See MipChainSettings::cookDirectory
+	uint8_t placeholder[4] = { 255, 255, 255, 255 };	// RGBA8 color of the 1x1 texture shown until the upload completes
+};
+
+// Sent to the worker threads
+struct TextureLoadRequest
+{
+	unsigned int id = 0;
+	std::string file;
+	bool hdr = false;
+	bool generateMipmaps = false;
+	MipChainSettings mipChain;
+	BlockFormat::Type compression = BlockFormat::None;
+};
+
+// Sent back to the GL thread, data holds every level in its upload format
+struct DecodedTexture
+{
+	unsigned int id = 0;
+	bool success = false;
+	TextureData data;
+	std::string cookedFile;					// TextureFile the levels were read from (or cooked to), empty if decoded from the image
+};
+
+struct TextureUpload
+{
+	unsigned int id = 0;
+	std::string name;
+	std::string file;
+	Texture *texture = nullptr;				// Holds the placeholder until the upload completes
+	TextureLoadOptions options;
+	std::function<void(Texture *, const std::string &)> onLoaded;
+
+	bool decoded = false;
+	TextureData data;
+	std::string cookedFile;
+	GLuint uploadTexture = 0;				// Receives the rows, swapped into texture once they are all uploaded
+	unsigned int mip = 0;
+	unsigned int nextRow = 0;
+};
+
+// Decodes image files (and builds or reads their mip chains) on worker threads and streams them to the GPU through a
+// pixel buffer object, a few rows at a time within a per frame byte budget. The workers and the GL thread only
+// communicate through two lock-free queues, idle workers sleep until a request is pushed.
+struct TextureLoader
+{
+	size_t uploadBudgetBytes = 4 * 1024 * 1024;	// Per frame, at least one row is uploaded every frame
+	unsigned int queueCapacity = 64;
+
+	std::unique_ptr<LockFreeQueue<TextureLoadRequest>> requests;
+	std::unique_ptr<LockFreeQueue<DecodedTexture>> decoded;
+	std::deque<TextureLoadRequest> overflow;		// Requests that did not fit into the request queue yet
+	std::vector<std::thread> workers;
+	std::atomic<bool> stop{ false };
+	std::mutex mutex;
+	std::condition_variable requested;		// Signalled when a request is pushed and when the workers have to stop
+	unsigned int unclaimedRequests = 0;		// Pushed but not yet popped by a worker, guarded by mutex
+
+	std::deque<TextureUpload> uploads;
+	GLuint pixelBuffer = 0;
+	unsigned int nextId = 1;
+
+	// Stats
+	size_t lastFrameUploadBytes = 0;
+	unsigned int loadedCount = 0;
+};
+
+namespace TextureLoaderControl
+{
+	// workerCount = 0 leaves one hardware thread to the GL thread
+	void Init(TextureLoader *loader, unsigned int workerCount = 0);
+	// Points texture at a 1x1 placeholder right away and replaces it with the file's contents once they are uploaded.
+	// texture has to stay valid until onLoaded is called or the load is cancelled. onLoaded also gets the cooked
+	// TextureFile the levels came from (empty if they were decoded from the image), e.g. for TextureResidency.
+	void Load(TextureLoader *loader, Texture *texture, const std::string &name, const char *file, const TextureLoadOptions &options,
+			  std::function<void(Texture *, const std::string &)> onLoaded = nullptr);
+	// Uploads decoded textures within the byte budget, called once per frame on the GL thread
+	void Update(TextureLoader *loader);
+	// Drops the pending load with the given name, the texture keeps its placeholder
+	void Cancel(TextureLoader *loader, const std::string &name);
+	// Blocks until every pending load has been uploaded
+	void Flush(TextureLoader *loader);
+	bool IsIdle(const TextureLoader &loader);
+	void Release(TextureLoader *loader);
+}
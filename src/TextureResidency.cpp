@@ -0,0 +1,209 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "BlockCompression.h"
+#include "TextureFile.h"
+#include "TextureResidency.h"
+
+static unsigned int LevelSize(const TextureData &description, unsigned int level)
+{
+	return std::max(std::max(description.width, description.height) >> level, 1u);
+}
+
+// Levels from here on are never dropped
+static unsigned int CoarsestLevel(const TextureResidency &residency, const StreamedTexture &streamed)
+{
+	unsigned int level = 0;
+	while (level + 1 < streamed.description.mipCount && LevelSize(streamed.description, level) > residency.minResidentSize)
+		++level;
+	return level;
+}
+
+// Finest level that still has at least texels across
+static unsigned int LevelForTexels(const StreamedTexture &streamed, float texels)
+{
+	if (texels <= 1.0f)
+		return streamed.description.mipCount - 1;
+	float ratio = float(LevelSize(streamed.description, 0)) / texels;
+	return ratio <= 1.0f ? 0 : (unsigned int)floorf(log2f(ratio));
+}
+
+static size_t BytesFromLevel(const StreamedTexture &streamed, unsigned int level)
+{
+	size_t bytes = 0;
+	for (unsigned int i = level; i < streamed.levels.size(); ++i)
+		bytes += streamed.levels[i].size;
+	return bytes;
+}
+
+static void DefineLevel(const StreamedTexture &streamed, unsigned int level, bool resident)
+{
+	const TextureData &description = streamed.description;
+	unsigned int width = resident ? std::max(description.width >> level, 1u) : 0;
+	unsigned int height = resident ? std::max(description.height >> level, 1u) : 0;
+	const uint8_t *data = resident ? streamed.levels[level].data : nullptr;
+	if (BlockCompression::IsCompressedFormat(description.internalFormat))
+	{
+		GLsizei imageSize = resident ? GLsizei(streamed.levels[level].size) : 0;
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, description.internalFormat, width, height, 0, imageSize, data);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, description.internalFormat, width, height, 0, description.format, description.type, data);
+	}
+}
+
+// Redefines the levels between the resident and the new base level and moves GL_TEXTURE_BASE_LEVEL
+static void SetResidentLevel(Texture *texture, StreamedTexture *streamed, unsigned int level)
+{
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int i = std::min(level, streamed->residentLevel); i < std::max(level, streamed->residentLevel); ++i)
+		DefineLevel(*streamed, i, i >= level);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	streamed->residentLevel = level;
+	texture->memoryBytes = Graphics::TextureMemoryBytes(texture);
+}
+
+static bool AddLevels(TextureResidency *residency, Texture *texture, StreamedTexture *streamed)
+{
+	GLint width = 0;
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if (texture->target != TextureTarget::Texture2D || streamed->description.target != TextureTarget::Texture2D ||
+		streamed->levels.size() != streamed->description.mipCount || GLuint(width) != streamed->description.width)
+	{
+		std::cerr << "ERROR: The source of a streamed texture does not match the texture\n";
+		return false;
+	}
+
+	TextureResidencyControl::Remove(residency, texture);
+	residency->streamed[texture] = *streamed;
+	return true;
+}
+
+bool TextureResidencyControl::AddStreamed(TextureResidency *residency, Texture *texture, const char *cookedFile)
+{
+	StreamedTexture streamed;
+	if (!TextureFile::Map(cookedFile, &streamed.file, &streamed.description, &streamed.levels))
+		return false;
+	if (!AddLevels(residency, texture, &streamed))
+	{
+		IOUtil::UnmapFile(&streamed.file);
+		return false;
+	}
+	return true;
+}
+
+void TextureResidencyControl::AddStreamed(TextureResidency *residency, Texture *texture, const TextureData &description,
+										  const std::vector<TextureLevelView> &levels)
+{
+	StreamedTexture streamed;
+	streamed.description = description;
+	streamed.levels = levels;
+	AddLevels(residency, texture, &streamed);
+}
+
+void TextureResidencyControl::Remove(TextureResidency *residency, Texture *texture)
+{
+	auto it = residency->streamed.find(texture);
+	if (it == residency->streamed.end())
+		return;
+	if (it->second.residentLevel > 0)
+		SetResidentLevel(texture, &it->second, 0);
+	IOUtil::UnmapFile(&it->second.file);
+	residency->streamed.erase(it);
+}
+
+void TextureResidencyControl::Request(TextureResidency *residency, Texture *texture, float texels)
+{
+	auto it = residency->streamed.find(texture);
+	if (it != residency->streamed.end())
+		it->second.requestedTexels = std::max(it->second.requestedTexels, texels);
+}
+
+void TextureResidencyControl::Update(TextureResidency *residency, size_t totalTextureBytes)
+{
+	// What the objects need, finer levels right away and coarser ones only once they have not been needed for a while
+	size_t streamedBytes = 0;
+	for (auto &it : residency->streamed)
+	{
+		StreamedTexture *streamed = &it.second;
+		unsigned int neededLevel = std::min(LevelForTexels(*streamed, streamed->requestedTexels), CoarsestLevel(*residency, *streamed));
+		streamed->requestedTexels = 0.0f;
+		if (neededLevel <= streamed->wantedLevel || ++streamed->coarserFrames > residency->dropDelayFrames)
+		{
+			streamed->wantedLevel = neededLevel;
+			streamed->coarserFrames = 0;
+		}
+		streamed->targetLevel = streamed->wantedLevel;
+		streamedBytes += it.first->memoryBytes;
+	}
+
+	// Give up the finest level of the largest texture until everything fits
+	size_t fixedBytes = totalTextureBytes - std::min(streamedBytes, totalTextureBytes);
+	size_t targetBytes = fixedBytes;
+	for (auto &it : residency->streamed)
+		targetBytes += BytesFromLevel(it.second, it.second.targetLevel);
+	while (targetBytes > residency->budgetBytes)
+	{
+		StreamedTexture *largest = nullptr;
+		for (auto &it : residency->streamed)
+		{
+			StreamedTexture *streamed = &it.second;
+			if (streamed->targetLevel < CoarsestLevel(*residency, *streamed) &&
+				(!largest || streamed->levels[streamed->targetLevel].size > largest->levels[largest->targetLevel].size))
+				largest = streamed;
+		}
+		if (!largest)
+			break;
+		targetBytes -= largest->levels[largest->targetLevel].size;
+		++largest->targetLevel;
+	}
+
+	// Drop first so that the uploads have the memory, then upload one level at a time from coarse to fine
+	residency->lastFrameUploadBytes = 0;
+	for (auto &it : residency->streamed)
+	{
+		if (it.second.targetLevel > it.second.residentLevel)
+			SetResidentLevel(it.first, &it.second, it.second.targetLevel);
+	}
+	bool uploading = true;
+	while (uploading)
+	{
+		uploading = false;
+		for (auto &it : residency->streamed)
+		{
+			StreamedTexture *streamed = &it.second;
+			if (streamed->targetLevel >= streamed->residentLevel)
+				continue;
+			size_t levelBytes = streamed->levels[streamed->residentLevel - 1].size;
+			if (residency->lastFrameUploadBytes > 0 && residency->lastFrameUploadBytes + levelBytes > residency->streamBudgetBytes)
+				continue;
+			SetResidentLevel(it.first, streamed, streamed->residentLevel - 1);
+			residency->lastFrameUploadBytes += levelBytes;
+			uploading = true;
+		}
+	}
+
+	residency->totalBytes = fixedBytes;
+	residency->streamedBytes = 0;
+	residency->droppedLevelCount = 0;
+	for (auto &it : residency->streamed)
+	{
+		residency->streamedBytes += it.first->memoryBytes;
+		residency->droppedLevelCount += it.second.residentLevel;
+	}
+	residency->totalBytes += residency->streamedBytes;
+}
+
+void TextureResidencyControl::Release(TextureResidency *residency)
+{
+	for (auto &it : residency->streamed)
+		IOUtil::UnmapFile(&it.second.file);
+	residency->streamed.clear();
+}
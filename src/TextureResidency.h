@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Graphics.h"
+#include "IOUtil.h"
+
+// A texture whose finer mip levels can leave the GPU and be uploaded again from their source when they are needed
+struct StreamedTexture
+{
+	TextureData description;				// Has no levels, see levels
+	std::vector<TextureLevelView> levels;	// Every level of the source, in a mapped cooked file or an asset pack
+	MappedFile file;						// Mapping of the cooked file, unmapped when the texture is removed
+	unsigned int residentLevel = 0;			// Finest level on the GPU (GL_TEXTURE_BASE_LEVEL), the finer ones are 0x0
+	unsigned int wantedLevel = 0;			// Finest level the objects that use the texture need
+	unsigned int targetLevel = 0;			// wantedLevel after the budget, residentLevel moves towards it
+	unsigned int coarserFrames = 0;			// Frames the objects have needed a coarser level than wantedLevel
+	float requestedTexels = 0.0f;			// Largest request of this frame
+};
+
+// Tracks the GPU memory of the textures (see Texture::memoryBytes) against a budget. Only streamed textures give
+// memory back: every frame the finest level each of them needs is chosen from the screen space size of the objects
+// that use it, and the finest levels of the largest textures are given up until everything fits the budget. Levels
+// that are no longer needed are dropped right away, missing ones are uploaded within a per frame byte budget.
+struct TextureResidency
+{
+	size_t budgetBytes = 64 * 1024 * 1024;			// Every texture, including the ones that are not streamed
+	size_t streamBudgetBytes = 4 * 1024 * 1024;	// Uploaded per frame, at least one level
+	unsigned int minResidentSize = 64;				// Levels of this size and smaller are never dropped
+	unsigned int dropDelayFrames = 60;				// Needed levels are only dropped after this many frames without use
+
+	std::map<Texture *, StreamedTexture> streamed;
+
+	// Stats of the last Update
+	size_t totalBytes = 0;
+	size_t streamedBytes = 0;
+	size_t lastFrameUploadBytes = 0;
+	unsigned int droppedLevelCount = 0;
+};
+
+namespace TextureResidencyControl
+{
+	// The texture has to hold every level of the source already, e.g. as uploaded by the TextureLoader from cookedFile
+	bool AddStreamed(TextureResidency *residency, Texture *texture, const char *cookedFile);
+	// Levels from an asset pack, they have to stay mapped while the texture is streamed
+	void AddStreamed(TextureResidency *residency, Texture *texture, const TextureData &description,
+					 const std::vector<TextureLevelView> &levels);
+	// Uploads the dropped levels again and stops streaming the texture
+	void Remove(TextureResidency *residency, Texture *texture);
+	// texels: texture width an object that uses the texture needs this frame (its size on screen times the texture's
+	// repetitions across it). Textures that nothing requests fall back to their coarsest streamed level.
+	void Request(TextureResidency *residency, Texture *texture, float texels);
+	// Called once per frame on the GL thread. totalTextureBytes is the memoryBytes of every texture, streamed or not.
+	void Update(TextureResidency *residency, size_t totalTextureBytes);
+	void Release(TextureResidency *residency);
+}
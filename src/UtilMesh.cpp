@@ -3,10 +3,13 @@
 #include <cstring>
 #include <iostream>
 #include <limits> 
+#include <algorithm>
+#include <cstddef>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "UtilMesh.h"
 
@@ -66,7 +69,7 @@ Mesh UtilMesh::MakeScreenQuad()
 		float position[3];
 		float texCoords[2];
 	};
-	mesh.vertexAttributeSizes = vector<unsigned int>{POSITION_SIZE, TEXCOORD_SIZE};
+	mesh.vertexAttributes = vector<VertexAttribute>{POSITION_SIZE, TEXCOORD_SIZE};
 
 	const Vertex vertices[] =
 	{
@@ -104,7 +107,7 @@ Mesh UtilMesh::MakeFloor(float size)
 		float normal[3];
 		float texCoords[2];
 	};
-	mesh.vertexAttributeSizes = vector<unsigned int>{POSITION_SIZE, NORMAL_SIZE, TEXCOORD_SIZE};
+	mesh.vertexAttributes = vector<VertexAttribute>{POSITION_SIZE, NORMAL_SIZE, TEXCOORD_SIZE};
 	
 	const Vertex vertices[] =
 	{
@@ -140,7 +143,7 @@ Mesh UtilMesh::MakeCubeCenteredWithNormals(float edgeSize)
 		float normal[3];
 	};
 	Mesh mesh = {};
-	mesh.vertexAttributeSizes = vector<unsigned int>{POSITION_SIZE, NORMAL_SIZE};
+	mesh.vertexAttributes = vector<VertexAttribute>{POSITION_SIZE, NORMAL_SIZE};
 
 	mesh.vertexCount = 36;
 	mesh.vertexStride = sizeof(Vertex);
@@ -265,7 +268,7 @@ Mesh UtilMesh::MakeSkyBox()
 
 
 	Mesh mesh = {};
-	mesh.vertexAttributeSizes = vector<unsigned int>{ POSITION_SIZE };
+	mesh.vertexAttributes = vector<VertexAttribute>{ POSITION_SIZE };
 
 	mesh.vertexCount = ARRAYSIZE(skyboxVertices);
 	mesh.vertexStride = sizeof(SkyBoxVertex);
@@ -291,7 +294,7 @@ Mesh UtilMesh::DEBUGVector(vec3 startPoint, vec3 endPoint, vec3 color)
 		vec3 color;
 	};
 	Mesh mesh = {};
-	mesh.vertexAttributeSizes = vector<unsigned int>{POSITION_SIZE, COLOR_SIZE};
+	mesh.vertexAttributes = vector<VertexAttribute>{POSITION_SIZE, COLOR_SIZE};
 
 	uint16_t numSides = 20;
 	float width = 0.01f;
@@ -393,7 +396,7 @@ Mesh UtilMesh::DEBUGMakeCube(float edgeSize, vec3 color)
 		vec3 color;
 	};
 	Mesh mesh = {};
-	mesh.vertexAttributeSizes = vector<unsigned int>{ POSITION_SIZE, COLOR_SIZE };
+	mesh.vertexAttributes = vector<VertexAttribute>{ POSITION_SIZE, COLOR_SIZE };
 
 	mesh.vertexCount = 36;
 	mesh.vertexStride = sizeof(Vertex);
@@ -466,12 +469,14 @@ Mesh UtilMesh::DEBUGMakeCube(float edgeSize, vec3 color)
 Mesh ConcatenateMeshes(std::vector<Mesh> meshes)
 {
 	// Check that layout is identical
-	vector<unsigned int> attributeSizes = meshes[0].vertexAttributeSizes;
+	vector<VertexAttribute> attributes = meshes[0].vertexAttributes;
 	size_t vertexStride = meshes[0].vertexStride;
 	size_t indexStride = meshes[0].indexStride;
 	for (unsigned int i = 1; i < meshes.size(); ++i)
 	{
-		assert(meshes[i].vertexAttributeSizes == attributeSizes);
+		assert(meshes[i].vertexAttributes == attributes);
+		assert(meshes[i].positionScale == meshes[0].positionScale);
+		assert(meshes[i].levels.empty() && meshes[i].meshlets.empty());
 		assert(meshes[i].indexStride == indexStride);
 		assert(meshes[i].vertexStride == vertexStride);
 	}
@@ -491,7 +496,8 @@ Mesh ConcatenateMeshes(std::vector<Mesh> meshes)
 	concat.indexCount = totalIndexCount;
 	concat.indexStride = indexStride;
 	concat.indices = malloc(concat.indexStride * concat.indexCount);
-	concat.vertexAttributeSizes = attributeSizes;
+	concat.vertexAttributes = attributes;
+	concat.positionScale = meshes[0].positionScale;
 
 	uint8_t *vertexPtrOffset = (uint8_t *)concat.vertices;
 	uint8_t  *indexPtrOffset = (uint8_t *)concat.indices;
@@ -527,7 +533,10 @@ glm::vec3 SphericalToCartesian(float r, float polarAngle, float azimuth)
 	return cartesian;
 }
 
-Mesh UtilMesh::MakeUVSphere(unsigned int subdivisions, float radius)
+// Latitude/longitude grid whose vertices are shared by the triangles around them. The poles get one vertex per slice
+// (each with the texture coordinates of its slice) and the seam column is duplicated for its texture coordinates, the
+// triangles are the same as with one vertex per triangle corner. Indices are 16 bit while the vertex count allows.
+Mesh UtilMesh::MakeUVSphere(unsigned int subdivisions, float radius, VertexFormat::Type format)
 {
 	struct UVSphereVertex
 	{
@@ -541,71 +550,88 @@ Mesh UtilMesh::MakeUVSphere(unsigned int subdivisions, float radius)
 	float r = radius;
 	vec3 c = vec3(0.0f, 0.0f, 0.0f);
 
+	// Rows 0 and stacks are the poles with slices vertices, the rows in between have slices + 1
+	unsigned int rowStart[2] = { slices, slices + (stacks - 1) * (slices + 1) };
+	auto vertexIndex = [&](unsigned int row, unsigned int column) -> unsigned int
+	{
+		if (row == 0)
+			return column;
+		if (row == stacks)
+			return rowStart[1] + column;
+		return rowStart[0] + (row - 1) * (slices + 1) + column;
+	};
+
 	Mesh mesh = {};
-	mesh.vertexCount = 0;
-	mesh.vertices = malloc(3 * (slices * 2 + ((stacks - 2) * slices * 2)) * sizeof(UVSphereVertex));
+	mesh.vertexCount = 2 * slices + (stacks - 1) * (slices + 1);
+	mesh.vertices = malloc(mesh.vertexCount * sizeof(UVSphereVertex));
 	mesh.vertexStride = sizeof(UVSphereVertex);
-	mesh.vertexAttributeSizes = vector<unsigned int>{ POSITION_SIZE, NORMAL_SIZE, TEXCOORD_SIZE };
+	mesh.vertexAttributes = vector<VertexAttribute>{ POSITION_SIZE, NORMAL_SIZE, TEXCOORD_SIZE };
 
-	for (unsigned int stack = 0; stack < stacks; ++stack)
+	UVSphereVertex *vertices = (UVSphereVertex *)mesh.vertices;
+	for (unsigned int row = 0; row <= stacks; ++row)
 	{
-		float polar1 = (float(stack) / stacks) * PI;
-		float polar2 = (float(stack + 1) / stacks) * PI;
-
-		for (unsigned int slice = 0; slice < slices; ++slice)
+		float polar = (float(row) / stacks) * PI;
+		float texPolar = float(row) / float(stacks + 1);
+		unsigned int columns = (row == 0 || row == stacks) ? slices : slices + 1;
+		for (unsigned int column = 0; column < columns; ++column)
 		{
-			float azimuth1 = (float(slice) / slices) * 2 * PI;
-			float azimuth2 = (float(slice + 1) / slices) * 2 * PI;
+			float azimuth = (float(column) / slices) * 2 * PI;
+			UVSphereVertex *v = &vertices[vertexIndex(row, column)];
+			v->position = SphericalToCartesian(r, polar, azimuth);
+			v->normal = normalize(vec3(v->position) - c);
+			v->texCoords = vec2(float(column) / float(slices + 1), texPolar);
+		}
+	}
 
-			UVSphereVertex v1 = {}, v2 = {}, v3 = {}, v4 = {};
+	mesh.indexCount = 3 * (slices * 2 + ((stacks - 2) * slices * 2));
+	mesh.indexStride = mesh.vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+	mesh.indices = malloc(mesh.indexCount * mesh.indexStride);
+	unsigned int index = 0;
+	auto addTriangle = [&](unsigned int i0, unsigned int i1, unsigned int i2)
+	{
+		unsigned int triangle[3] = { i0, i1, i2 };
+		for (unsigned int i = 0; i < 3; ++i, ++index)
+		{
+			if (mesh.indexStride == sizeof(uint16_t))
+				((uint16_t *)mesh.indices)[index] = uint16_t(triangle[i]);
+			else
+				((uint32_t *)mesh.indices)[index] = triangle[i];
+		}
+	};
 
+	for (unsigned int stack = 0; stack < stacks; ++stack)
+	{
+		for (unsigned int slice = 0; slice < slices; ++slice)
+		{
 			/* azim1      azim2
 				 v1 ----- v4		polar1
  				 |	       |
 				 v2 ----- v3		polar2
 			
 			*/
-			v1.position = SphericalToCartesian(r, polar1, azimuth1);
-			v2.position = SphericalToCartesian(r, polar2, azimuth1);
-			v3.position = SphericalToCartesian(r, polar2, azimuth2);
-			v4.position = SphericalToCartesian(r, polar1, azimuth2);
-
-			v1.normal = normalize(vec3(v1.position) - c);
-			v2.normal = normalize(vec3(v2.position) - c);
-			v3.normal = normalize(vec3(v3.position) - c);
-			v4.normal = normalize(vec3(v4.position) - c);
-
-			float texAzimuth1 = float(slice) / float(slices + 1);
-			float texAzimuth2 = float(slice + 1) / float(slices + 1);
-			float texPolar1 = float(stack) / float(stacks + 1);
-			float texPolar2 = float(stack + 1) / float(stacks + 1);
-
-			v1.texCoords = vec2(texAzimuth1, texPolar1);
-			v2.texCoords = vec2(texAzimuth1, texPolar2);
-			v3.texCoords = vec2(texAzimuth2, texPolar2);
-			v4.texCoords = vec2(texAzimuth2, texPolar1);
+			unsigned int v1 = vertexIndex(stack, slice);
+			unsigned int v2 = vertexIndex(stack + 1, slice);
 
 			if (stack == 0)									// First stack
-				AddVertexTriangle(&mesh, v1, v2, v3);
+				addTriangle(v1, v2, vertexIndex(stack + 1, slice + 1));
 			else if (stack == stacks - 1)
-				AddVertexTriangle(&mesh, v2, v4, v1);	// Last stack
+				addTriangle(v2, vertexIndex(stack, slice + 1), v1);	// Last stack
 			else
 			{
-				AddVertexTriangle(&mesh, v1, v2, v3);	// Middle stacks
-				AddVertexTriangle(&mesh, v3, v4, v1);
+				unsigned int v3 = vertexIndex(stack + 1, slice + 1);
+				unsigned int v4 = vertexIndex(stack, slice + 1);
+				addTriangle(v1, v2, v3);					// Middle stacks
+				addTriangle(v3, v4, v1);
 			}
 		}
 	}
 
-	mesh.indexCount = mesh.vertexCount;
-	mesh.indexStride = sizeof(uint32_t);
-	mesh.indices = (uint32_t*)malloc(mesh.indexCount * mesh.indexStride);
-
-	for (unsigned int i = 0; i < mesh.indexCount; ++i)
+	if (format == VertexFormat::Quantized)
 	{
-		((uint32_t*)(mesh.indices))[i] = i;
+		Mesh quantized = UtilMesh::Quantize(mesh);
+		UtilMesh::Free(mesh);
+		return quantized;
 	}
-
 	return mesh;
 }
 
@@ -629,7 +655,7 @@ Mesh UtilMesh::MakeIcosahedronSphere(unsigned int recursionLevel)
 	mesh.vertexStride = sizeof(IcoSphereVertex);
 	unsigned int finalVertexCount = 20 * 3 * (unsigned int)(powf(4.0f, float(recursionLevel)));
 	mesh.vertices = malloc(finalVertexCount * mesh.vertexStride);
-	mesh.vertexAttributeSizes = vector<unsigned int>{ POSITION_SIZE, NORMAL_SIZE };
+	mesh.vertexAttributes = vector<VertexAttribute>{ POSITION_SIZE, NORMAL_SIZE };
 
 	mesh.indexCount = 0;
 	mesh.indexStride = sizeof(uint16_t);
@@ -754,6 +780,113 @@ Mesh UtilMesh::MakeIcosahedronSphere(unsigned int recursionLevel)
 	return mesh;
 }
 
+// Projects the unit vector onto the octahedron |x| + |y| + |z| = 1 and folds its lower half over the upper one, which
+// maps the sphere onto the [-1, 1] square. Decoded by OctahedralDecode in the vertex shaders.
+static vec2 OctahedralEncode(vec3 n)
+{
+	float length = abs(n.x) + abs(n.y) + abs(n.z);
+	if (length == 0.0f)
+		return vec2(0.0f, 0.0f);
+	n /= length;
+	vec2 encoded = vec2(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (vec2(1.0f, 1.0f) - abs(vec2(n.y, n.x))) * signs;
+	}
+	return encoded;
+}
+
+Mesh UtilMesh::Quantize(const Mesh &mesh)
+{
+	const vector<VertexAttribute> &attributes = mesh.vertexAttributes;
+	bool texCoords = attributes.size() == 3;
+	bool supported = (attributes.size() == 2 || texCoords) && attributes[0] == VertexAttribute(POSITION_SIZE) &&
+					 attributes[1] == VertexAttribute(NORMAL_SIZE) && (!texCoords || attributes[2] == VertexAttribute(TEXCOORD_SIZE));
+	if (!supported)
+	{
+		std::cerr << "ERROR: Only meshes with float positions, normals and texture coordinates can be quantized\n";
+		return Mesh();
+	}
+
+	struct QuantizedVertex
+	{
+		uint16_t position[4];
+		uint16_t normal[2];
+		uint16_t texCoords[2];		// Only with texCoords
+	};
+
+	// The largest coordinate becomes 1
+	float maxCoordinate = 0.0f;
+	for (unsigned int v = 0; v < mesh.vertexCount; ++v)
+	{
+		const float *position = (const float *)((const uint8_t *)mesh.vertices + v * mesh.vertexStride);
+		maxCoordinate = std::max(maxCoordinate, std::max(std::abs(position[0]), std::max(std::abs(position[1]), std::abs(position[2]))));
+	}
+	if (maxCoordinate == 0.0f)
+		maxCoordinate = 1.0f;
+
+	Mesh quantized = {};
+	quantized.vertexCount = mesh.vertexCount;
+	quantized.vertexStride = texCoords ? sizeof(QuantizedVertex) : offsetof(QuantizedVertex, texCoords);
+	quantized.vertices = malloc(quantized.vertexCount * quantized.vertexStride);
+	quantized.indexCount = mesh.indexCount;
+	quantized.indexStride = mesh.indexStride;
+	quantized.indices = malloc(quantized.indexCount * quantized.indexStride);
+	memcpy(quantized.indices, mesh.indices, quantized.indexCount * quantized.indexStride);
+	quantized.vertexAttributes = vector<VertexAttribute>{ VertexAttribute(4, VertexAttributeType::Short, true),
+														   VertexAttribute(2, VertexAttributeType::Short, true) };
+	if (texCoords)
+		quantized.vertexAttributes.push_back(VertexAttribute(TEXCOORD_SIZE, VertexAttributeType::HalfFloat));
+	quantized.positionScale = mesh.positionScale * maxCoordinate;
+	// The meshlet bounds would no longer be conservative, MeshletBuilder has to run again
+	quantized.levels = mesh.levels;
+	for (unsigned int i = 0; i < quantized.levels.size(); ++i)
+		quantized.levels[i].meshletOffset = quantized.levels[i].meshletCount = 0;
+
+	for (unsigned int v = 0; v < mesh.vertexCount; ++v)
+	{
+		const float *source = (const float *)((const uint8_t *)mesh.vertices + v * mesh.vertexStride);
+		QuantizedVertex *destination = (QuantizedVertex *)((uint8_t *)quantized.vertices + v * quantized.vertexStride);
+		for (unsigned int i = 0; i < 3; ++i)
+			destination->position[i] = glm::packSnorm1x16(source[i] / maxCoordinate);
+		destination->position[3] = glm::packSnorm1x16(1.0f);
+		vec2 normal = OctahedralEncode(vec3(source[3], source[4], source[5]));
+		destination->normal[0] = glm::packSnorm1x16(normal.x);
+		destination->normal[1] = glm::packSnorm1x16(normal.y);
+		if (texCoords)
+		{
+			destination->texCoords[0] = glm::packHalf1x16(source[6]);
+			destination->texCoords[1] = glm::packHalf1x16(source[7]);
+		}
+	}
+	return quantized;
+}
+
+unsigned int UtilMesh::AttributeBytes(const VertexAttribute &attribute)
+{
+	switch (attribute.type)
+	{
+		case VertexAttributeType::HalfFloat:
+		case VertexAttributeType::Short:
+			return attribute.size * sizeof(uint16_t);
+		default:
+			return attribute.size * sizeof(float);
+	}
+}
+
+glm::vec3 UtilMesh::Position(const Mesh &mesh, unsigned int vertex)
+{
+	const uint8_t *data = (const uint8_t *)mesh.vertices + vertex * mesh.vertexStride;
+	if (mesh.vertexAttributes[0].type == VertexAttributeType::Short)
+	{
+		const uint16_t *position = (const uint16_t *)data;
+		return mesh.positionScale * vec3(glm::unpackSnorm1x16(position[0]), glm::unpackSnorm1x16(position[1]), glm::unpackSnorm1x16(position[2]));
+	}
+	const float *position = (const float *)data;
+	return mesh.positionScale * vec3(position[0], position[1], position[2]);
+}
+
 void UtilMesh::Free(Mesh mesh)
 {
 	free(mesh.vertices);
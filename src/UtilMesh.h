@@ -1,8 +1,64 @@
 #pragma once
 
+#include <vector>
+
 #include "Def.h"
 #include <glm/glm.hpp>
 
+namespace VertexAttributeType
+{
+	enum Type
+	{
+		Float,				// 32 bit floats
+		HalfFloat,			// 16 bit floats
+		Short,				// 16 bit signed integers, snorm16 when normalized
+		TypeCount
+	};
+}
+
+// Layout of one vertex attribute, the vertex shader reads every type as floats
+struct VertexAttribute
+{
+	unsigned int size = 0;				// Components
+	VertexAttributeType::Type type = VertexAttributeType::Float;
+	bool normalized = false;			// Integers map to [-1, 1] instead of to their value
+
+	VertexAttribute() {}
+	VertexAttribute(unsigned int size, VertexAttributeType::Type type = VertexAttributeType::Float, bool normalized = false)
+	{
+		this->size = size;
+		this->type = type;
+		this->normalized = normalized;
+	}
+};
+
+inline bool operator==(const VertexAttribute &a, const VertexAttribute &b)
+{
+	return a.size == b.size && a.type == b.type && a.normalized == b.normalized;
+}
+
+// One level of detail, a range of the mesh's indices
+struct MeshLevel
+{
+	unsigned int indexOffset = 0;
+	unsigned int indexCount = 0;
+	float error = 0.0f;					// Estimated largest distance from the surface of level 0, in model space
+	unsigned int meshletOffset = 0;		// The level's range of Mesh::meshlets
+	unsigned int meshletCount = 0;
+};
+
+// A cluster of triangles, a range of one level's indices, with the bounds the cluster culling tests (see MeshletBuilder)
+struct Meshlet
+{
+	unsigned int indexOffset = 0;
+	unsigned int indexCount = 0;
+	glm::vec3 center = glm::vec3(0.0f);		// Bounding sphere in model space (positionScale applied)
+	float radius = 0.0f;
+	glm::vec3 coneApex = glm::vec3(0.0f);	// Normal cone: every triangle faces away from a camera at position p if
+	glm::vec3 coneAxis = glm::vec3(0.0f);	// dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+	float coneCutoff = 2.0f;				// Above 1 when the normals spread too far for the test
+};
+
 struct Mesh
 {
 	void *vertices = nullptr;
@@ -13,9 +69,21 @@ struct Mesh
 	unsigned int indexCount = 0;
 	size_t indexStride = 0;
 	
-	std::vector<unsigned int> vertexAttributeSizes;
+	std::vector<VertexAttribute> vertexAttributes;
+	float positionScale = 1.0f;			// Positions are stored divided by this (quantized ones have to fit into [-1, 1])
+	std::vector<MeshLevel> levels;		// Levels of detail finest first, see MeshSimplifier. Empty: all indices are one level.
+	std::vector<Meshlet> meshlets;		// Of every level, see MeshletBuilder. Without levels they cover all indices.
 };
 
+namespace VertexFormat
+{
+	enum Type
+	{
+		Float,				// Every attribute as 32 bit floats
+		Quantized			// 16 bytes for position, normal and texture coordinates, see UtilMesh::Quantize
+	};
+}
+
 namespace UtilMesh
 {
 	Mesh MakeCubeCenteredWithNormals(float edgeSize);
@@ -25,7 +93,14 @@ namespace UtilMesh
 	Mesh DEBUGVector(glm::vec3 startPoint, glm::vec3 endPoint, glm::vec3 color = glm::vec3(1.0f, 0.0f, 0.0f));
 	Mesh DEBUGWorldAxes(float axLength);	
 	Mesh DEBUGMakeCube(float edgeSize, glm::vec3 color);
-	Mesh MakeUVSphere(unsigned int subdivisions, float radius = 1.0f);
+	Mesh MakeUVSphere(unsigned int subdivisions, float radius = 1.0f, VertexFormat::Type format = VertexFormat::Float);
 	Mesh MakeIcosahedronSphere(unsigned int recursionLevel = 2);
+	// Float position, normal and (optionally) texture coordinates to snorm16 positions (padded to 4 components),
+	// octahedral snorm16 normals (the shaders decode them with OCTAHEDRAL_NORMALS) and half float texture coordinates.
+	// Returns a new mesh with a copy of the indices.
+	Mesh Quantize(const Mesh &mesh);
+	unsigned int AttributeBytes(const VertexAttribute &attribute);
+	// Float or snorm16 position of a vertex, times positionScale
+	glm::vec3 Position(const Mesh &mesh, unsigned int vertex);
 	void Free(Mesh mesh);
 }
\ No newline at end of file
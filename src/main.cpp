@@ -272,7 +272,7 @@ int main()
     }
 
     AppContext appContext;
-    App::Init(&appContext, SCREEN_WIDTH, SCREEN_HEIGHT);
+    App::Init(&appContext, SCREEN_WIDTH, SCREEN_HEIGHT, ASSET_PACK_FILE);
 
     Uint64 currentTick = SDL_GetPerformanceCounter();
     Uint64 previousTick = 0;
@@ -0,0 +1,14 @@
+#version 330 core
+
+layout (location = 0) in vec3 inPosition;
+
+out vec3 gsLocalPosition;
+flat out int gsFace;
+
+// Drawn with one instance per cubemap face, the geometry shader projects the vertices and routes them to the face
+void main()
+{
+	gsLocalPosition = inPosition;
+	gsFace = gl_InstanceID;
+	gl_Position = vec4(inPosition, 1.0);
+}
@@ -2,11 +2,20 @@
 
 uniform samplerCube uHDREnvironmentCubemap;
 
+// Progressive baking evaluates every uSampleBatchCount-th sample starting at uSampleBatch, the batch results are averaged
+uniform int uSampleBatch;
+uniform int uSampleBatchCount;
+
 in vec3 vsLocalPosition;
 out vec4 fragColor;
 
 #define PI 3.14159265359
 
+// Set from IBLBakeSettings::irradianceSampleStep
+#ifndef RIEMANN_SUM_STEP
+#define RIEMANN_SUM_STEP 0.015
+#endif
+
 void main()
 {
 	vec3 N = normalize(vsLocalPosition);
@@ -14,18 +23,21 @@ void main()
 	vec3 left = normalize(cross(up, N));
 	up = normalize(cross(N, left));
 
-	const float riemannSumStep = 0.015;
+	const float riemannSumStep = RIEMANN_SUM_STEP;
+	const int polarSteps = int(ceil(0.5 * PI / riemannSumStep));
+	const int azimuthSteps = int(ceil(2.0 * PI / riemannSumStep));
+	int batchCount = max(uSampleBatchCount, 1);
+
 	int numSamples = 0;
 	vec3 irradiance = vec3(0.0);
-	for (float polar = 0.0; polar < 0.5 * PI; polar += riemannSumStep)
+	for (int i = uSampleBatch; i < polarSteps * azimuthSteps; i += batchCount)
 	{
-		for (float azimuth = 0.0; azimuth < 2.0 * PI; azimuth += riemannSumStep)
-		{
-			vec3 tangentDir = vec3(sin(polar) * cos(azimuth), sin(polar) * sin(azimuth), cos(polar));	
-			vec3 sampleDir = tangentDir.x * left + tangentDir.y * up + tangentDir.z * N;
-			irradiance += texture(uHDREnvironmentCubemap, sampleDir).rgb * cos(polar) * sin(polar);
-			++numSamples;
-		}
+		float polar = float(i / azimuthSteps) * riemannSumStep;
+		float azimuth = float(i % azimuthSteps) * riemannSumStep;
+		vec3 tangentDir = vec3(sin(polar) * cos(azimuth), sin(polar) * sin(azimuth), cos(polar));	
+		vec3 sampleDir = tangentDir.x * left + tangentDir.y * up + tangentDir.z * N;
+		irradiance += texture(uHDREnvironmentCubemap, sampleDir).rgb * cos(polar) * sin(polar);
+		++numSamples;
 	}
 	irradiance = PI * irradiance * (1.0 / float(numSamples));
 	fragColor = vec4(irradiance, 1.0);
@@ -2,6 +2,19 @@
 
 uniform samplerCube uHDREnvironmentCubemap;
 uniform float uRoughness;
+uniform int uNumSamples;
+
+// Progressive baking splits the samples into uSampleBatchCount contiguous ranges (an azimuth wedge with the full polar
+// distribution each) and evaluates range uSampleBatch. Every batch is normalized by the weight of the whole sample set,
+// so the average of all batch results equals the result of a single pass.
+uniform int uSampleBatch;
+uniform int uSampleBatchCount;
+
+#ifdef FILTERED_IMPORTANCE_SAMPLING
+// Filtered importance sampling (GPU Gems 3, chapter 20): every sample reads the environment mip whose texel
+// solid angle matches the solid angle of the sample, the environment cubemap needs a full mip chain
+uniform float uEnvironmentSize;		// Edge length of mip 0
+#endif
 
 in vec3 vsLocalPosition;
 out vec4 fragColor;
@@ -51,6 +64,28 @@ vec3 ImportanceSampleGGX(vec2 Xi, float roughness, vec3 N)
 	return tangentX * H.x + tangentY * H.y + N * H.z;
 }
 
+#ifdef FILTERED_IMPORTANCE_SAMPLING
+float DistributionGGX(float NdotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float denominator = NdotH * NdotH * (a2 - 1.0) + 1.0;
+	return a2 / (PI * denominator * denominator);
+}
+
+float SourceMipLevel(float NdotH, int numSamples)
+{
+	if (uRoughness == 0.0)
+		return 0.0;
+
+	// pdf(L) = D * NdotH / (4 * VdotH) = D / 4 since V = N, the +1 bias smooths the undersampling of the lobe tails
+	float pdf = DistributionGGX(NdotH, uRoughness) * 0.25;
+	float sampleSolidAngle = 1.0 / (float(numSamples) * pdf);
+	float texelSolidAngle = 4.0 * PI / (6.0 * uEnvironmentSize * uEnvironmentSize);
+	return max(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0);
+}
+#endif
+
 // Run biased Monte-Carlo integration with importance sampling
 void main()
 {
@@ -60,8 +95,11 @@ void main()
 
 	vec3 prefilteredColor = vec3(0);
 	float totalWeight = 0.0;
-	const int numSamples = 1024;
-	for(int i = 0; i < numSamples; i++)
+	int numSamples = uNumSamples;
+	int batchCount = max(uSampleBatchCount, 1);
+	int firstSample = uSampleBatch * numSamples / batchCount;
+	int lastSample = (uSampleBatch + 1) * numSamples / batchCount;
+	for(int i = firstSample; i < lastSample; i++)
 	{
 		vec2 Xi = Hammersley(uint(i), uint(numSamples));
 		vec3 H = ImportanceSampleGGX(Xi, uRoughness, N);				// Randomly (with importance sampling) generated half-vector
@@ -69,10 +107,28 @@ void main()
 		float NdotL = clamp(dot(N, L), 0, 1);
 		if(NdotL > 0)
 		{
+#ifdef FILTERED_IMPORTANCE_SAMPLING
+			float mipLevel = SourceMipLevel(clamp(dot(N, H), 0, 1), numSamples);
+			prefilteredColor += textureLod(uHDREnvironmentCubemap, L, mipLevel).rgb * NdotL;
+#else
 			prefilteredColor += texture(uHDREnvironmentCubemap, L).rgb * NdotL;		// Weighed by NdotL since it looks better (see Epic notes)
+#endif
 			totalWeight += NdotL;
 		}
 	}
-	vec3 irradiance = prefilteredColor / totalWeight;
+	if (batchCount > 1)
+	{
+		// NdotL = 2 * NdotH^2 - 1 since V = N, so the weight of the whole set does not depend on N
+		float a = uRoughness * uRoughness;
+		totalWeight = 0.0;
+		for(int i = 0; i < numSamples; i++)
+		{
+			float Xi_y = RadicalInverse_VdC(uint(i));
+			float cosTheta2 = (1 - Xi_y) / (1 + (a*a - 1) * Xi_y);
+			totalWeight += max(2 * cosTheta2 - 1, 0);
+		}
+		totalWeight /= float(batchCount);
+	}
+	vec3 irradiance = totalWeight > 0.0 ? prefilteredColor / totalWeight : vec3(0.0);
 	fragColor = vec4(irradiance, 1.0);
 }
\ No newline at end of file
@@ -20,17 +20,30 @@ uniform float uMetalness;
 uniform float uRoughness;
 uniform float uAO;
 
-// Texture material
-uniform sampler2D uTexAlbedo;
+// Texture material, there is no albedo map (uAlbedo is used)
+#ifdef ORM_TEXTURE
+uniform sampler2D uTexORM;			// R = occlusion, G = roughness, B = metalness (packorm)
+#else
 uniform sampler2D uTexMetalness;
 uniform sampler2D uTexRoughness;
-uniform sampler2D uTexNormal;
+#endif
 
 // Environment
+#ifndef PREFILTERED_MIP_LEVELS
+#define PREFILTERED_MIP_LEVELS 5		// Set from IBLBakeSettings::prefilteredMipLevels
+#endif
 uniform sampler2D uTexIntegratedBRDF;
 uniform samplerCube uCubeIrradiance;
 uniform samplerCube uCubePrefilteredEnvMap;
 
+#ifdef SH_IRRADIANCE
+// Order 2 SH irradiance (rgb), premultiplied with the cosine lobe convolution and the basis constants
+layout(std140) uniform SHIrradiance
+{
+	vec4 uSHCoefficients[9];
+};
+#endif
+
 in VS_OUT 
 {
 	vec3 normal;
@@ -86,14 +99,50 @@ float N_GGXTR(vec3 N, vec3 H, float roughness)
 	return nom / denom;
 }
 
+#ifdef ANALYTIC_ENVIRONMENT_BRDF
+// Fitted approximation of the split sum BRDF LUT that needs no texture fetch
+// Source: https://www.unrealengine.com/en-US/blog/physically-based-shading-on-mobile (Karis, EnvBRDFApprox)
+vec2 EnvironmentBRDFApprox(float NdotV, float roughness)
+{
+	const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+	const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+	vec4 r = roughness * c0 + c1;
+	float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+	return vec2(-1.04, 1.04) * a004 + r.zw;
+}
+#endif
+
+#ifdef SH_IRRADIANCE
+// Returns the same value as the irradiance cubemap (irradiance / PI) without any texture fetch
+vec3 EvaluateSHIrradiance(vec3 n)
+{
+	vec3 irradiance = uSHCoefficients[0].rgb
+					+ uSHCoefficients[1].rgb * n.y
+					+ uSHCoefficients[2].rgb * n.z
+					+ uSHCoefficients[3].rgb * n.x
+					+ uSHCoefficients[4].rgb * (n.x * n.y)
+					+ uSHCoefficients[5].rgb * (n.y * n.z)
+					+ uSHCoefficients[6].rgb * (3.0 * n.z * n.z - 1.0)
+					+ uSHCoefficients[7].rgb * (n.x * n.z)
+					+ uSHCoefficients[8].rgb * (n.x * n.x - n.y * n.y);
+	return max(irradiance, vec3(0.0));
+}
+#endif
+
 void main() 
 {
-#if 0	// Use textures
-	vec3 albedo = texture(uTexAlbedo, fs_in.texCoords).rgb;
-	albedo = pow(albedo, vec3(gamma));
+#ifdef MATERIAL_TEXTURES	// Use textures
+	vec3 albedo = uAlbedo;
+#ifdef ORM_TEXTURE
+	vec3 ORM = texture(uTexORM, fs_in.texCoords).rgb;
+	float AO = ORM.r;
+	float roughness = ORM.g;
+	float metalness = ORM.b;
+#else
 	float roughness = texture(uTexRoughness, fs_in.texCoords).r;
 	float metalness = texture(uTexMetalness, fs_in.texCoords).r;
 	float AO = 1.0;
+#endif
 #else	// Use uniform value
 	vec3 albedo = uAlbedo;
 	float roughness = uRoughness;
@@ -156,16 +205,24 @@ void main()
 	kD *= 1.0 - metalness;
 
 	// Indirect diffuse
+#ifdef SH_IRRADIANCE
+	vec3 diffuseIrradiance = EvaluateSHIrradiance(N);
+#else
 	vec3 diffuseIrradiance = texture(uCubeIrradiance, N).rgb;
+#endif
 	vec3 indirectDiffuse = diffuseIrradiance * albedo;
 	
 	// Indirect specular
 	vec3 R = 2 * dot(V, N) * N - V;
-	const float MAX_MIP_LEVEL = 4.5;	// Should be 4.9, but buggy at older devices
+	const float MAX_MIP_LEVEL = float(PREFILTERED_MIP_LEVELS) - 0.5;	// Should be PREFILTERED_MIP_LEVELS - 0.1, but buggy at older devices
 	float mipLevel = roughness * MAX_MIP_LEVEL;
 	vec3 prefilteredColor = textureLod(uCubePrefilteredEnvMap, R, mipLevel).rgb;
 
+#ifdef ANALYTIC_ENVIRONMENT_BRDF
+	vec2 envBRDF = EnvironmentBRDFApprox(VdotN, roughness);
+#else
 	vec2 envBRDF = texture(uTexIntegratedBRDF, vec2(VdotN, roughness)).rg;		// Get F scale and bias from the LUT
+#endif
 	F = F * envBRDF.x + envBRDF.y;
 	vec3 indirectSpecular = prefilteredColor * F;
 
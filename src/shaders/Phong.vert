@@ -6,7 +6,11 @@ uniform mat4 uProjectionMatrix;
 uniform mat4 uLightViewProjectionMatrix;
 
 layout(location = 0) in vec3 inPosition;
+#ifdef OCTAHEDRAL_NORMALS
+layout(location = 1) in vec2 inNormal;		// See UtilMesh::Quantize
+#else
 layout(location = 1) in vec3 inNormal;
+#endif
 layout(location = 2) in vec2 inTexCoords;
 
 out VS_OUT	
@@ -17,6 +21,17 @@ out VS_OUT
 	vec4 posLightSpace;
 } vs_out;
 
+#ifdef OCTAHEDRAL_NORMALS
+// Unfolds the lower half of the octahedron, see OctahedralEncode in UtilMesh.cpp
+vec3 OctahedralDecode(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+#endif
+
 void main()
 {
 	vec4 posWorld = uModelMatrix * vec4(inPosition, 1.0f);
@@ -24,6 +39,11 @@ void main()
 	vs_out.posLightSpace = uLightViewProjectionMatrix * posWorld;
 	gl_Position = uProjectionMatrix * uViewMatrix * posWorld;
 
-	vs_out.normal = transpose(inverse(mat3(uModelMatrix))) * inNormal;
+#ifdef OCTAHEDRAL_NORMALS
+	vec3 normal = OctahedralDecode(inNormal);
+#else
+	vec3 normal = inNormal;
+#endif
+	vs_out.normal = transpose(inverse(mat3(uModelMatrix))) * normal;
 	vs_out.texCoords = inTexCoords;
 }
\ No newline at end of file
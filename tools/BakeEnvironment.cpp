@@ -0,0 +1,142 @@
+// Offline baker for the image based lighting textures. Runs the same integrations as EquirectToCubeMap.frag,
+// EnvToIrradiance.frag and EnvToPrefilteredEnv.frag on all CPU cores, so it does not need a GL context.
+//
+// Writes the products of the IBL cache as TextureFiles: <prefix>_skybox.tex, <prefix>_irradianceMap.tex,
+// <prefix>_prefilteredEnvMap.tex and <prefix>_irradianceSH.tex. Pack them as an environment of the app (the sizes
+// have to match the app's quality tier, Interactive by default), e.g. for the first one:
+//
+//     packassets assets.pack ... -texture skybox0 <prefix>_skybox.tex -texture irradianceMap0 <prefix>_irradianceMap.tex
+//         -texture prefilteredEnvMap0 <prefix>_prefilteredEnvMap.tex -texture irradianceSH0 <prefix>_irradianceSH.tex
+//
+// Usage: bakeenv <input.hdr> <output prefix> [threads] [Draft|Interactive|Production]
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include "stb_image.h"
+
+#include "Graphics.h"
+#include "IBLBake.h"
+#include "Parallel.h"
+#include "TextureFile.h"
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Half float cubemap like the GPU bakes, the float texels are converted when the app uploads them
+static void CubemapToTextureData(const CubemapImage &image, TextureData *data)
+{
+	*data = TextureData();
+	data->target = TextureTarget::Cubemap;
+	data->internalFormat = GL_RGB16F;
+	data->format = GL_RGB;
+	data->type = GL_FLOAT;
+	data->width = image.size;
+	data->height = image.size;
+	data->mipCount = image.mipCount;
+	data->levels.resize(image.faces.size());
+	for (unsigned int i = 0; i < image.faces.size(); ++i)
+	{
+		const uint8_t *texels = (const uint8_t *)image.faces[i].data();
+		data->levels[i].assign(texels, texels + image.faces[i].size() * sizeof(float));
+	}
+}
+
+// Same layout as IBLCacheControl::IrradianceSHToTexture, a 9x1 RGB float texture
+static void IrradianceSHToTextureData(const SHIrradiance &irradiance, TextureData *data)
+{
+	*data = TextureData();
+	data->target = TextureTarget::Texture2D;
+	data->internalFormat = GL_RGB32F;
+	data->format = GL_RGB;
+	data->type = GL_FLOAT;
+	data->width = sizeof(irradiance.coefficients) / sizeof(irradiance.coefficients[0]);
+	data->height = 1;
+	data->mipCount = 1;
+	data->levels.resize(1);
+	const uint8_t *coefficients = (const uint8_t *)irradiance.coefficients;
+	data->levels[0].assign(coefficients, coefficients + sizeof(irradiance.coefficients));
+}
+
+static bool WriteProduct(const std::string &prefix, const char *product, const TextureData &data)
+{
+	std::string file = prefix + "_" + product + ".tex";
+	if (!TextureFile::Write(file.c_str(), data))
+		return false;
+	std::cout << "Written " << file << "\n";
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: bakeenv <input.hdr> <output prefix> [threads] [Draft|Interactive|Production]\n";
+		return 1;
+	}
+	unsigned int threadCount = argc > 3 ? (unsigned int)atoi(argv[3]) : Parallel::ThreadCount();
+	IBLQuality::Tier tier = IBLQuality::Interactive;
+	if (argc > 4)
+	{
+		for (int i = 0; i < IBLQuality::TierCount; ++i)
+		{
+			if (strcmp(argv[4], IBLBake::TierName(IBLQuality::Tier(i))) == 0)
+				tier = IBLQuality::Tier(i);
+		}
+	}
+	IBLBakeSettings settings = IBLBake::SettingsForTier(tier);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	stbi_set_flip_vertically_on_load(true);
+	int width, height, numComponents;
+	float *data = stbi_loadf(argv[1], &width, &height, &numComponents, 3);
+	if (!data)
+	{
+		std::cerr << "Failed to load HDR image " << argv[1] << "\n";
+		return 1;
+	}
+	std::cout << "Loaded " << argv[1] << " (" << width << "x" << height << ") in " << MillisecondsSince(start) << " ms\n";
+
+	start = std::chrono::high_resolution_clock::now();
+	CubemapImage environment;
+	IBLBake::CubemapFromEquirect(data, width, height, &environment, settings.environmentSize, threadCount);
+	stbi_image_free(data);
+	std::cout << "Environment cubemap " << settings.environmentSize << ": " << MillisecondsSince(start) << " ms\n";
+
+	start = std::chrono::high_resolution_clock::now();
+	if (settings.filteredImportanceSampling)
+		IBLBake::GenerateMips(&environment, threadCount);
+	CubemapImage irradianceMap;
+	IBLBake::IrradianceMapFromCubemap(environment, &irradianceMap, settings.irradianceSize, settings.irradianceSampleStep, threadCount);
+	SHIrradiance irradianceSH;
+	IBLBake::ProjectIrradianceSH(environment, &irradianceSH, threadCount);
+	std::cout << "Irradiance map " << settings.irradianceSize << " and SH irradiance: " << MillisecondsSince(start) << " ms\n";
+
+	start = std::chrono::high_resolution_clock::now();
+	CubemapImage prefiltered;
+	IBLBake::PrefilteredEnvMapFromCubemap(environment, &prefiltered, settings, threadCount);
+	std::cout << IBLBake::TierName(tier) << " prefiltered environment map " << settings.prefilteredSize << " x " << settings.prefilteredMipLevels << " mips, "
+			  << (settings.filteredImportanceSampling ? "filtered importance sampling, " : "") << threadCount << " threads: "
+			  << MillisecondsSince(start) << " ms\n";
+
+	std::string prefix = argv[2];
+	TextureData textureData;
+	CubemapToTextureData(environment, &textureData);
+	if (!WriteProduct(prefix, "skybox", textureData))
+		return 1;
+	CubemapToTextureData(irradianceMap, &textureData);
+	if (!WriteProduct(prefix, "irradianceMap", textureData))
+		return 1;
+	CubemapToTextureData(prefiltered, &textureData);
+	if (!WriteProduct(prefix, "prefilteredEnvMap", textureData))
+		return 1;
+	IrradianceSHToTextureData(irradianceSH, &textureData);
+	if (!WriteProduct(prefix, "irradianceSH", textureData))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,129 @@
+// Cooks the mip chains of material textures ahead of time, so that even the first start of the app only reads them.
+// Writes the same files the app would write next to the images, or into the -out directory (see MipChain::CookedFile).
+// With a block format the chain is also compressed (see BlockCompression::CookedFile) and the error of the
+// compression is reported.
+//
+// Usage: cooktex [-srgb] [-box] [-clamp] [-bc1|-bc4|-bc5|-bc7] [-threads n] [-out directory] <image>...
+//        -srgb for color textures (albedo), the default is linear data (metallic, roughness, normal)
+//        -bc7 (or -bc1) for albedo, -bc4 for metalness and roughness, -bc5 for normal maps
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#include "stb_image.h"
+
+#include "Graphics.h"
+#include "MipChain.h"
+#include "BlockCompression.h"
+#include "Parallel.h"
+#include "TextureFile.h"
+
+// Over the channels the compressed format keeps, level 0 only
+static double PSNR(const TextureData &original, const TextureData &compressed)
+{
+	TextureData decoded;
+	BlockCompression::Decompress(compressed, &decoded);
+	unsigned int originalChannels = (unsigned int)(original.levels[0].size() / (size_t(original.width) * original.height));
+	unsigned int decodedChannels = (unsigned int)(decoded.levels[0].size() / (size_t(decoded.width) * decoded.height));
+	double squaredError = 0.0;
+	size_t count = 0;
+	for (size_t i = 0; i < size_t(original.width) * original.height; ++i)
+	{
+		for (unsigned int c = 0; c < decodedChannels; ++c)
+		{
+			// Channels missing in the source read as 0, alpha as 255
+			double reference = c < originalChannels ? original.levels[0][i * originalChannels + c] : c == 3 ? 255.0 : 0.0;
+			double error = reference - decoded.levels[0][i * decodedChannels + c];
+			squaredError += error * error;
+			++count;
+		}
+	}
+	double meanSquaredError = squaredError / double(count);
+	return meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+}
+
+static size_t ByteCount(const TextureData &data)
+{
+	size_t byteCount = 0;
+	for (unsigned int level = 0; level < data.levels.size(); ++level)
+		byteCount += data.levels[level].size();
+	return byteCount;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	MipChainSettings settings;
+	BlockFormat::Type format = BlockFormat::None;
+	unsigned int threadCount = Parallel::ThreadCount();
+	int firstImage = 1;
+	for (; firstImage < argc && argv[firstImage][0] == '-'; ++firstImage)
+	{
+		if (strcmp(argv[firstImage], "-srgb") == 0)
+			settings.srgb = true;
+		else if (strcmp(argv[firstImage], "-box") == 0)
+			settings.filter = MipFilter::Box;
+		else if (strcmp(argv[firstImage], "-clamp") == 0)
+			settings.wrap = GL_CLAMP_TO_EDGE;
+		else if (strcmp(argv[firstImage], "-bc1") == 0)
+			format = BlockFormat::BC1;
+		else if (strcmp(argv[firstImage], "-bc4") == 0)
+			format = BlockFormat::BC4;
+		else if (strcmp(argv[firstImage], "-bc5") == 0)
+			format = BlockFormat::BC5;
+		else if (strcmp(argv[firstImage], "-bc7") == 0)
+			format = BlockFormat::BC7;
+		else if (strcmp(argv[firstImage], "-threads") == 0 && firstImage + 1 < argc)
+			threadCount = (unsigned int)atoi(argv[++firstImage]);
+		else if (strcmp(argv[firstImage], "-out") == 0 && firstImage + 1 < argc)
+			settings.cookDirectory = std::string(argv[++firstImage]) + "/";
+	}
+	if (firstImage >= argc)
+	{
+		std::cerr << "Usage: cooktex [-srgb] [-box] [-clamp] [-bc1|-bc4|-bc5|-bc7] [-threads n] [-out directory] <image>...\n";
+		return 1;
+	}
+
+	// Same orientation as the app loads the images with
+	stbi_set_flip_vertically_on_load(true);
+	for (int i = firstImage; i < argc; ++i)
+	{
+		// A stale cooked file would only be read back, so always cook from the source image
+		std::string cookedFile = MipChain::CookedFile(argv[i], settings);
+		remove(cookedFile.c_str());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		TextureData data;
+		if (!MipChain::Load(argv[i], settings, &data, threadCount))
+		{
+			std::cerr << "Failed to cook " << argv[i] << "\n";
+			return 1;
+		}
+		std::cout << argv[i] << " (" << data.width << "x" << data.height << ", " << data.mipCount << " mips, "
+				  << MipChain::FilterName(settings.filter) << (settings.srgb ? ", sRGB" : ", linear") << "): "
+				  << MillisecondsSince(start) << " ms, " << ByteCount(data) / 1024 << " KB -> " << cookedFile << "\n";
+		if (format == BlockFormat::None)
+			continue;
+
+		start = std::chrono::high_resolution_clock::now();
+		TextureData compressed;
+		std::string compressedFile = BlockCompression::CookedFile(argv[i], settings, format);
+		if (!BlockCompression::Compress(data, format, &compressed, threadCount) || !TextureFile::Write(compressedFile.c_str(), compressed))
+		{
+			std::cerr << "Failed to compress " << argv[i] << "\n";
+			return 1;
+		}
+		std::cout << "  " << BlockCompression::FormatName(format) << ": " << MillisecondsSince(start) << " ms, "
+				  << ByteCount(compressed) / 1024 << " KB (" << double(ByteCount(data)) / double(ByteCount(compressed)) << "x smaller), "
+				  << "PSNR " << PSNR(data, compressed) << " dB -> " << compressedFile << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+// Build step that integrates the split sum BRDF LUT (formerly rendered at startup by EnvToIntegratedBRDF.frag) and
+// writes it as a C++ array of RG half floats, which src/IntegratedBRDFLUT.cpp compiles into the binary.
+//
+// Usage: brdflutgen <output.inl> [size] [samples]
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdint>
+
+#include <glm/gtc/packing.hpp>
+
+#include "IBLBake.h"
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: brdflutgen <output.inl> [size] [samples]\n";
+		return 1;
+	}
+	unsigned int size = argc > 2 ? (unsigned int)atoi(argv[2]) : 128;
+	unsigned int numSamples = argc > 3 ? (unsigned int)atoi(argv[3]) : 1024;
+
+	std::vector<glm::vec2> lut;
+	IBLBake::IntegratedBRDFLUT(&lut, size, numSamples);
+
+	std::ofstream out(argv[1], std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR: Unable to open " << argv[1] << " for writing\n";
+		return 1;
+	}
+
+	out << "// Generated by brdflutgen (tools/GenerateBRDFLUT.cpp), " << size << "x" << size << " RG16F, " << numSamples << " samples per texel\n";
+	out << "const unsigned int INTEGRATED_BRDF_LUT_SIZE = " << size << ";\n";
+	out << "const uint16_t INTEGRATED_BRDF_LUT[" << size * size * 2 << "] =\n{";
+	for (size_t i = 0; i < lut.size(); ++i)
+	{
+		out << (i % 8 == 0 ? "\n\t" : " ");
+		out << glm::packHalf1x16(lut[i].x) << ", " << glm::packHalf1x16(lut[i].y) << ",";
+	}
+	out << "\n};\n";
+
+	if (!out.good())
+	{
+		std::cerr << "ERROR: Unable to write " << argv[1] << "\n";
+		return 1;
+	}
+	return 0;
+}
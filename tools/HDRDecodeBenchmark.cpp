@@ -0,0 +1,182 @@
+// Compares RadianceHDR::Read (memory mapped, parallel scanlines, RGBE straight to half floats) against stbi_loadf
+// followed by the float to half conversion that the GL upload of an RGB16F texture needs. Checks that both give the
+// same halves. The tile mode writes a larger RLE encoded test file, e.g. 8192x4096 from four by two copies of a 2k map.
+//
+// Usage: hdrbench <input.hdr> [threads]
+//        hdrbench -tile <input.hdr> <output.hdr> <tiles x> <tiles y>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include "stb_image.h"
+
+#include "RadianceHDR.h"
+#include "Parallel.h"
+
+static const unsigned int BENCHMARK_RUNS = 5;
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Same encoding as stbi_write_hdr
+static void FloatToRGBE(const float *color, uint8_t *rgbe)
+{
+	float maxComponent = std::max(color[0], std::max(color[1], color[2]));
+	if (maxComponent < 1e-32f)
+	{
+		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+		return;
+	}
+	int exponent;
+	float normalize = frexpf(maxComponent, &exponent) * 256.0f / maxComponent;
+	rgbe[0] = uint8_t(color[0] * normalize);
+	rgbe[1] = uint8_t(color[1] * normalize);
+	rgbe[2] = uint8_t(color[2] * normalize);
+	rgbe[3] = uint8_t(exponent + 128);
+}
+
+// New style RLE: runs of at least 4 equal bytes become run packets, the rest literal packets
+static void WriteRLEChannel(std::ofstream &out, const uint8_t *values, unsigned int count)
+{
+	unsigned int x = 0;
+	while (x < count)
+	{
+		unsigned int runEnd = x + 1;
+		while (runEnd < count && runEnd - x < 127 && values[runEnd] == values[x])
+			++runEnd;
+		if (runEnd - x >= 4)
+		{
+			uint8_t packet[2] = { uint8_t(128 + runEnd - x), values[x] };
+			out.write((const char *)packet, 2);
+			x = runEnd;
+			continue;
+		}
+
+		unsigned int literalEnd = x;
+		while (literalEnd < count && literalEnd - x < 128)
+		{
+			if (literalEnd + 3 < count && values[literalEnd] == values[literalEnd + 1] && values[literalEnd] == values[literalEnd + 2] &&
+				values[literalEnd] == values[literalEnd + 3])
+				break;
+			++literalEnd;
+		}
+		uint8_t length = uint8_t(literalEnd - x);
+		out.write((const char *)&length, 1);
+		out.write((const char *)values + x, length);
+		x = literalEnd;
+	}
+}
+
+static int WriteTiled(const char *input, const char *output, unsigned int tilesX, unsigned int tilesY)
+{
+	stbi_set_flip_vertically_on_load(false);
+	int width, height, numComponents;
+	float *data = stbi_loadf(input, &width, &height, &numComponents, 3);
+	if (!data)
+	{
+		std::cerr << "Failed to load HDR image " << input << "\n";
+		return 1;
+	}
+
+	unsigned int outputWidth = width * tilesX, outputHeight = height * tilesY;
+	std::ofstream out(output, std::ios::binary | std::ios::out | std::ios::trunc);
+	out << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << outputHeight << " +X " << outputWidth << "\n";
+
+	std::vector<uint8_t> channels(4 * outputWidth);
+	for (unsigned int y = 0; y < outputHeight; ++y)
+	{
+		const float *row = data + 3 * size_t(y % height) * width;
+		for (unsigned int x = 0; x < outputWidth; ++x)
+		{
+			uint8_t rgbe[4];
+			FloatToRGBE(row + 3 * (x % width), rgbe);
+			for (unsigned int c = 0; c < 4; ++c)
+				channels[c * outputWidth + x] = rgbe[c];
+		}
+		uint8_t header[4] = { 2, 2, uint8_t(outputWidth >> 8), uint8_t(outputWidth & 0xff) };
+		out.write((const char *)header, 4);
+		for (unsigned int c = 0; c < 4; ++c)
+			WriteRLEChannel(out, channels.data() + c * outputWidth, outputWidth);
+	}
+	stbi_image_free(data);
+
+	if (!out.good())
+	{
+		std::cerr << "Failed to write " << output << "\n";
+		return 1;
+	}
+	std::cout << "Written " << output << " (" << outputWidth << "x" << outputHeight << ")\n";
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 6 && strcmp(argv[1], "-tile") == 0)
+		return WriteTiled(argv[2], argv[3], (unsigned int)atoi(argv[4]), (unsigned int)atoi(argv[5]));
+	if (argc < 2)
+	{
+		std::cerr << "Usage: hdrbench <input.hdr> [threads]\n"
+				  << "       hdrbench -tile <input.hdr> <output.hdr> <tiles x> <tiles y>\n";
+		return 1;
+	}
+	unsigned int threadCount = argc > 2 ? (unsigned int)atoi(argv[2]) : Parallel::ThreadCount();
+
+	// stb_image path: float32 RGB buffer, then the conversion the driver does for GL_RGB16F
+	double stbTime = 1e30;
+	std::vector<uint16_t> stbHalves;
+	int width = 0, height = 0, numComponents;
+	for (unsigned int run = 0; run < BENCHMARK_RUNS; ++run)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		stbi_set_flip_vertically_on_load(true);
+		float *data = stbi_loadf(argv[1], &width, &height, &numComponents, 3);
+		if (!data)
+		{
+			std::cerr << "Failed to load HDR image " << argv[1] << "\n";
+			return 1;
+		}
+		stbHalves.resize(3 * size_t(width) * height);
+		for (size_t i = 0; i < stbHalves.size(); ++i)
+			stbHalves[i] = glm::packHalf1x16(data[i]);
+		stbi_image_free(data);
+		stbTime = std::min(stbTime, MillisecondsSince(start));
+	}
+
+	double singleThreadTime = 1e30, threadedTime = 1e30;
+	HalfImage image;
+	for (unsigned int run = 0; run < BENCHMARK_RUNS; ++run)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!RadianceHDR::Read(argv[1], &image, true, 1))
+			return 1;
+		singleThreadTime = std::min(singleThreadTime, MillisecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		RadianceHDR::Read(argv[1], &image, true, threadCount);
+		threadedTime = std::min(threadedTime, MillisecondsSince(start));
+	}
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < image.texels.size() && i < stbHalves.size(); ++i)
+		mismatches += image.texels[i] != stbHalves[i] ? 1 : 0;
+
+	double megapixels = double(width) * height / 1e6;
+	std::cout << argv[1] << " (" << width << "x" << height << "), best of " << BENCHMARK_RUNS << "\n" << std::fixed << std::setprecision(1)
+			  << "  stbi_loadf + half conversion: " << std::setw(8) << stbTime << " ms, " << 12.0 * megapixels << " MB float32 buffer\n"
+			  << "  RadianceHDR, 1 thread:        " << std::setw(8) << singleThreadTime << " ms (" << stbTime / singleThreadTime << "x)\n"
+			  << "  RadianceHDR, " << std::setw(2) << threadCount << " threads:      " << std::setw(8) << threadedTime << " ms ("
+			  << stbTime / threadedTime << "x), " << 6.0 * megapixels << " MB half buffer\n"
+			  << "  Mismatching halves: " << mismatches << " of " << image.texels.size() << "\n";
+	return mismatches == 0 && image.texels.size() == stbHalves.size() ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// Writes the asset pack the app maps at startup (assets.pack in the build directory, see the assetpack target). Meshes
+// are generated with UtilMesh (spheres with levels of detail from MeshSimplifier) and ordered for the GPU with
+// MeshOptimizer (its ACMR/ATVR are printed), the spheres are split into meshlets for the cluster culling (see
+// MeshletBuilder). Textures are TextureFiles: material textures cooked by cooktex and baked environments from the IBL
+// cache.
+//
+// Usage: packassets <output.pack> [-sphere <name> <subdivisions>] [-quantizedsphere <name> <subdivisions>]
+//                                 [-skybox <name>] [-screenquad <name>] [-texture <name> <file.tex>]...
+//
+// e.g. packassets assets.pack -quantizedsphere uvSphere64Quantized 64 -skybox skyBox -screenquad screenQuad
+//          -texture orm materials/orm.ppm.kaiser_linear_repeat.bc7.tex
+//          -texture skybox0 ../cache/<key>_skybox.tex -texture irradianceMap0 ../cache/<key>_irradianceMap.tex
+//          -texture prefilteredEnvMap0 ../cache/<key>_prefilteredEnvMap.tex -texture irradianceSH0 ../cache/<key>_irradianceSH.tex
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "AssetPack.h"
+#include "TextureFile.h"
+#include "UtilMesh.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: packassets <output.pack> [-sphere <name> <subdivisions>] [-quantizedsphere <name> <subdivisions>]\n"
+			  << "                                [-skybox <name>] [-screenquad <name>] [-texture <name> <file.tex>]...\n";
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<AssetPackSource> assets;
+	std::vector<VertexCacheStats> statsBefore(argc), statsAfter(argc);
+	bool success = true;
+	for (int arg = 2; arg < argc && success; ++arg)
+	{
+		AssetPackSource asset;
+		bool meshlets = false;
+		if ((strcmp(argv[arg], "-sphere") == 0 || strcmp(argv[arg], "-quantizedsphere") == 0) && arg + 2 < argc)
+		{
+			VertexFormat::Type format = strcmp(argv[arg], "-sphere") == 0 ? VertexFormat::Float : VertexFormat::Quantized;
+			asset.name = argv[arg + 1];
+			Mesh sphere = UtilMesh::MakeUVSphere((unsigned int)atoi(argv[arg + 2]), 1.0f, format);
+			asset.mesh = MeshSimplifier::BuildLevels(sphere);
+			UtilMesh::Free(sphere);
+			meshlets = true;
+			arg += 2;
+		}
+		else if (strcmp(argv[arg], "-skybox") == 0 && arg + 1 < argc)
+		{
+			asset.name = argv[++arg];
+			asset.mesh = UtilMesh::MakeSkyBox();
+		}
+		else if (strcmp(argv[arg], "-screenquad") == 0 && arg + 1 < argc)
+		{
+			asset.name = argv[++arg];
+			asset.mesh = UtilMesh::MakeScreenQuad();
+		}
+		else if (strcmp(argv[arg], "-texture") == 0 && arg + 2 < argc)
+		{
+			asset.name = argv[arg + 1];
+			asset.type = AssetType::Texture;
+			success = TextureFile::Read(argv[arg + 2], &asset.texture);
+			if (!success)
+				std::cerr << "Failed to read " << argv[arg + 2] << "\n";
+			arg += 2;
+		}
+		else
+		{
+			PrintUsage();
+			success = false;
+		}
+		if (success && asset.type == AssetType::Mesh)
+			MeshOptimizer::Optimize(&asset.mesh, &statsBefore[assets.size()], &statsAfter[assets.size()]);
+		if (success && meshlets)
+			MeshletBuilder::Build(&asset.mesh);
+		if (success)
+			assets.push_back(asset);
+	}
+
+	success = success && AssetPackControl::Write(argv[1], assets);
+	if (success)
+	{
+		for (unsigned int i = 0; i < assets.size(); ++i)
+		{
+			const AssetPackSource &asset = assets[i];
+			if (asset.type == AssetType::Mesh)
+			{
+				std::cout << "  " << asset.name << ": " << asset.mesh.vertexCount << " vertices, " << asset.mesh.indexCount << " indices, ACMR "
+						  << statsBefore[i].acmr << " -> " << statsAfter[i].acmr << ", ATVR " << statsBefore[i].atvr << " -> " << statsAfter[i].atvr;
+				for (unsigned int l = 1; l < asset.mesh.levels.size(); ++l)
+					std::cout << (l == 1 ? ", levels of detail: " : ", ") << asset.mesh.levels[l].indexCount / 3 << " triangles";
+				if (!asset.mesh.meshlets.empty())
+					std::cout << ", " << asset.mesh.meshlets.size() << " meshlets";
+				std::cout << "\n";
+			}
+			else
+				std::cout << "  " << asset.name << ": " << asset.texture.width << "x" << asset.texture.height << ", "
+						  << asset.texture.mipCount << " mips\n";
+		}
+		std::cout << assets.size() << " assets -> " << argv[1] << "\n";
+	}
+
+	for (unsigned int i = 0; i < assets.size(); ++i)
+	{
+		if (assets[i].type == AssetType::Mesh)
+			UtilMesh::Free(assets[i].mesh);
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+// Packs the occlusion, roughness and metalness maps of a material into the R, G and B channels of one image, which
+// the app samples with a single fetch (see ORM_TEXTURE in PBR.frag). Missing maps get their neutral value.
+// Cook the result like the other material textures afterwards: cooktex -bc7 orm.ppm
+//
+// Usage: packorm [-ao <image>] [-roughness <image>] [-metalness <image>] <output.ppm>
+
+#include <iostream>
+#include <cstring>
+
+#include "Graphics.h"
+#include "MaterialPacking.h"
+
+int main(int argc, char **argv)
+{
+	const char *occlusionFile = nullptr;
+	const char *roughnessFile = nullptr;
+	const char *metalnessFile = nullptr;
+	int arg = 1;
+	for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if (strcmp(argv[arg], "-ao") == 0)
+			occlusionFile = argv[arg + 1];
+		else if (strcmp(argv[arg], "-roughness") == 0)
+			roughnessFile = argv[arg + 1];
+		else if (strcmp(argv[arg], "-metalness") == 0)
+			metalnessFile = argv[arg + 1];
+	}
+	if (arg + 1 != argc)
+	{
+		std::cerr << "Usage: packorm [-ao <image>] [-roughness <image>] [-metalness <image>] <output.ppm>\n";
+		return 1;
+	}
+
+	TextureData packed;
+	if (!MaterialPacking::PackORM(occlusionFile, roughnessFile, metalnessFile, &packed) || !MaterialPacking::WritePPM(argv[arg], packed))
+		return 1;
+	std::cout << argv[arg] << " (" << packed.width << "x" << packed.height << "): AO " << (occlusionFile ? occlusionFile : "-")
+			  << ", roughness " << (roughnessFile ? roughnessFile : "-") << ", metalness " << (metalnessFile ? metalnessFile : "-") << "\n";
+	return 0;
+}
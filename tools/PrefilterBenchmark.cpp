@@ -0,0 +1,87 @@
+// Compares the filtered importance sampling prefilter (per mip sample counts, source mip chosen from the sample pdf)
+// against the 1024 sample reference that samples mip 0 of the environment. Reports bake time and error per roughness level.
+//
+// Usage: prefilterbench <input.hdr> [threads] [samples for mip 0] [samples for mip 1] ...
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+#include "stb_image.h"
+
+#include "IBLBake.h"
+#include "Parallel.h"
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: prefilterbench <input.hdr> [threads] [samples for mip 0] [samples for mip 1] ...\n";
+		return 1;
+	}
+	unsigned int threadCount = argc > 2 ? (unsigned int)atoi(argv[2]) : Parallel::ThreadCount();
+	IBLBakeSettings settings;
+	if (argc > 3)
+	{
+		settings.prefilteredSampleCounts.clear();
+		for (int i = 3; i < argc; ++i)
+			settings.prefilteredSampleCounts.push_back((unsigned int)atoi(argv[i]));
+	}
+
+	stbi_set_flip_vertically_on_load(true);
+	int width, height, numComponents;
+	float *data = stbi_loadf(argv[1], &width, &height, &numComponents, 3);
+	if (!data)
+	{
+		std::cerr << "Failed to load HDR image " << argv[1] << "\n";
+		return 1;
+	}
+
+	CubemapImage environment;
+	IBLBake::CubemapFromEquirect(data, width, height, &environment, settings.environmentSize, threadCount);
+	stbi_image_free(data);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	CubemapImage mippedEnvironment = environment;
+	IBLBake::GenerateMips(&mippedEnvironment, threadCount);
+	double mipTime = MillisecondsSince(start);
+
+	CubemapImage reference, filtered;
+	IBLBake::InitCubemapImage(&reference, settings.prefilteredSize, settings.prefilteredMipLevels);
+	IBLBake::InitCubemapImage(&filtered, settings.prefilteredSize, settings.prefilteredMipLevels);
+
+	std::cout << "Environment " << settings.environmentSize << ", prefiltered " << settings.prefilteredSize << " x "
+			  << settings.prefilteredMipLevels << " mips, " << threadCount << " threads, environment mips " << mipTime << " ms\n\n";
+	std::cout << "mip roughness | reference samples       ms | filtered samples       ms  speedup |     RMSE      max\n";
+
+	double referenceTotal = 0.0, filteredTotal = mipTime;
+	for (unsigned int mip = 0; mip < settings.prefilteredMipLevels; ++mip)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		IBLBake::PrefilterMip(environment, &reference, mip, settings.prefilteredSamples, false, threadCount);
+		double referenceTime = MillisecondsSince(start);
+
+		unsigned int sampleCount = IBLBake::PrefilteredSampleCount(settings, mip);
+		start = std::chrono::high_resolution_clock::now();
+		IBLBake::PrefilterMip(mippedEnvironment, &filtered, mip, sampleCount, true, threadCount);
+		double filteredTime = MillisecondsSince(start);
+
+		referenceTotal += referenceTime;
+		filteredTotal += filteredTime;
+		ImageError error = IBLBake::Compare(reference, filtered, mip);
+		float roughness = float(mip) / float(settings.prefilteredMipLevels - 1);
+		std::cout << std::fixed << std::setw(3) << mip << std::setw(10) << std::setprecision(2) << roughness << " | "
+				  << std::setw(17) << settings.prefilteredSamples << std::setw(9) << std::setprecision(1) << referenceTime << " | "
+				  << std::setw(16) << sampleCount << std::setw(9) << filteredTime << std::setw(8) << referenceTime / filteredTime << "x | "
+				  << std::setw(8) << std::setprecision(5) << error.rmse << std::setw(9) << error.maxError << "\n";
+	}
+	std::cout << std::setprecision(1) << "\nTotal: reference " << referenceTotal << " ms, filtered " << filteredTotal << " ms ("
+			  << referenceTotal / filteredTotal << "x)\n";
+	return 0;
+}
@@ -0,0 +1,194 @@
+// Runs App::Init (and App::Release) several times in a hidden window and writes the median CPU and GPU time of every
+// startup phase (see StartupProfile) as JSON. Every run includes the texture loads and the IBL bakes that App::Init
+// leaves running. Warm runs use the IBL cache (one untimed run fills it first), cold runs disable it so that every
+// environment texture is converted or baked again. Run it from the build directory like pbr,
+// on machines without a display with SDL_VIDEODRIVER=offscreen (SDL 2.0.10+).
+//
+// Usage: startupbench [-runs <n>] [-output <report.json>]
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+
+#include "App.h"
+#include "IOUtil.h"
+
+static const unsigned int SCREEN_WIDTH = 1280;
+static const unsigned int SCREEN_HEIGHT = 720;
+
+// Times of one phase name in one run, phases that occur several times (e.g. CubemapFromTexture) are summed
+struct PhaseSample
+{
+	unsigned int count = 0;
+	double cpuMs = 0.0;
+	double gpuMs = 0.0;
+};
+
+struct PhaseReport
+{
+	std::string name;
+	unsigned int depth = 0;
+	std::vector<PhaseSample> runs;
+};
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static double Median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+static bool InitGL(SDL_Window **window, SDL_GLContext *glContext)
+{
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	{
+		std::cerr << "ERROR: SDL could not initialize: " << SDL_GetError() << "\n";
+		return false;
+	}
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+	*window = SDL_CreateWindow("startupbench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT,
+							   SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (*window == nullptr)
+	{
+		std::cerr << "ERROR: Window could not be created: " << SDL_GetError() << "\n";
+		return false;
+	}
+	*glContext = SDL_GL_CreateContext(*window);
+	if (!*glContext || !gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
+	{
+		std::cerr << "ERROR: Failed to create an OpenGL context: " << SDL_GetError() << "\n";
+		return false;
+	}
+	return true;
+}
+
+// One App::Init, returns the phases of its profile grouped by name in first start order
+static std::map<std::string, PhaseSample> RunInit(bool iblCache, double *wallMs, std::vector<PhaseReport> *order)
+{
+	AppContext *context = new AppContext();
+	context->iblCache.enabled = iblCache;
+	auto start = std::chrono::high_resolution_clock::now();
+	App::Init(context, SCREEN_WIDTH, SCREEN_HEIGHT, ASSET_PACK_FILE);
+	TextureLoaderControl::Flush(&context->textureLoader);
+	// Progressive bakes would otherwise go on in App::Update after the measurement (and only store into the cache
+	// once they complete)
+	IBLBakeSchedulerControl::Flush(&context->iblBakeScheduler);
+	glFinish();
+	*wallMs = MillisecondsSince(start);
+	StartupProfileControl::Resolve(&context->startupProfile, true);
+
+	std::map<std::string, PhaseSample> samples;
+	const std::vector<ProfilePhase> &phases = context->startupProfile.phases;
+	for (unsigned int i = 0; i < phases.size(); ++i)
+	{
+		PhaseSample *sample = &samples[phases[i].name];
+		++sample->count;
+		sample->cpuMs += phases[i].cpuMs;
+		sample->gpuMs += phases[i].gpuMs;
+		bool known = std::find_if(order->begin(), order->end(), [&](const PhaseReport &report) { return report.name == phases[i].name; }) != order->end();
+		if (!known)
+		{
+			PhaseReport report;
+			report.name = phases[i].name;
+			report.depth = phases[i].depth;
+			order->push_back(report);
+		}
+	}
+
+	App::Release(context);
+	delete context;
+	return samples;
+}
+
+static void WriteMode(std::ostream &out, const char *mode, bool iblCache, unsigned int runs)
+{
+	std::vector<PhaseReport> phases;
+	std::vector<std::map<std::string, PhaseSample>> samples;
+	std::vector<double> wallMs(runs);
+	for (unsigned int run = 0; run < runs; ++run)
+	{
+		samples.push_back(RunInit(iblCache, &wallMs[run], &phases));
+		std::cerr << mode << " run " << run + 1 << "/" << runs << ": " << wallMs[run] << " ms\n";
+	}
+
+	out << "    {\n      \"mode\": \"" << mode << "\",\n      \"wallMs\": " << Median(wallMs) << ",\n      \"phases\": [\n";
+	for (unsigned int i = 0; i < phases.size(); ++i)
+	{
+		std::vector<double> counts, cpuMs, gpuMs;
+		for (unsigned int run = 0; run < runs; ++run)
+		{
+			PhaseSample sample = samples[run].count(phases[i].name) ? samples[run][phases[i].name] : PhaseSample();
+			counts.push_back(sample.count);
+			cpuMs.push_back(sample.cpuMs);
+			gpuMs.push_back(sample.gpuMs);
+		}
+		out << "        { \"name\": \"" << phases[i].name << "\", \"depth\": " << phases[i].depth << ", \"count\": " << Median(counts)
+			<< ", \"cpuMs\": " << Median(cpuMs) << ", \"gpuMs\": " << Median(gpuMs) << " }" << (i + 1 < phases.size() ? "," : "") << "\n";
+	}
+	out << "      ]\n    }";
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int runs = 5;
+	const char *output = "startup_benchmark.json";
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (strcmp(argv[arg], "-runs") == 0 && arg + 1 < argc)
+			runs = std::max(atoi(argv[++arg]), 1);
+		else if (strcmp(argv[arg], "-output") == 0 && arg + 1 < argc)
+			output = argv[++arg];
+		else
+		{
+			std::cerr << "Usage: startupbench [-runs <n>] [-output <report.json>]\n";
+			return 1;
+		}
+	}
+
+	SDL_Window *window = nullptr;
+	SDL_GLContext glContext = nullptr;
+	if (!InitGL(&window, &glContext))
+		return 1;
+
+	// Fills the IBL cache for the warm runs
+	double primingMs = 0.0;
+	std::vector<PhaseReport> unused;
+	RunInit(true, &primingMs, &unused);
+
+	std::ofstream out(output);
+	if (!out.is_open())
+	{
+		std::cerr << "ERROR: Unable to open " << output << " for writing\n";
+		return 1;
+	}
+	out << "{\n  \"renderer\": \"" << (const char *)glGetString(GL_RENDERER) << "\",\n  \"runs\": " << runs
+		<< ",\n  \"assetPack\": " << (IOUtil::FileExists(ASSET_PACK_FILE) ? "true" : "false") << ",\n  \"modes\": [\n";
+	WriteMode(out, "warm", true, runs);
+	out << ",\n";
+	WriteMode(out, "cold", false, runs);
+	out << "\n  ]\n}\n";
+	std::cout << "Startup report -> " << output << "\n";
+
+	SDL_GL_DeleteContext(glContext);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	return out.good() ? 0 : 1;
+}